@@ -2,10 +2,1241 @@
 // Estimated Time: 6 hours
 // Difficulty: Hard
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
-// TODO: Implement test cases for atomic operations
 // TODO: Implement test cases for lock-free stack
-// TODO: Implement test cases for lock-free queue
+
+class LockFreeBasicsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+// ============================================================================
+// Lock-Free Callback Dispatch (EventHandler without the mutex)
+// ============================================================================
+
+// Each slot publishes one handler node through a single 64-bit word:
+//   bits  0..47  node pointer (user-space addresses fit in 48 bits on x86-64 / AArch64)
+//   bits 48..63  "external" count of triggers currently holding the node
+// A trigger pins a node with one fetch_add on the word, so it never has to read a
+// pointer and then bump a refcount on memory that might already be freed.
+// When set_callback swaps a node out, it folds the external count into the node's
+// own refcount; whichever side drops that refcount to zero retires the node.
+template<typename Event, std::size_t MaxHandlers = 8>
+class EventDispatcher
+{
+public:
+    using Callback = std::function<void(const Event&)>;
+
+    EventDispatcher()
+    : retired_(nullptr)
+    {
+        for (auto& slot : slots_)
+        {
+            slot.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    EventDispatcher(const EventDispatcher&) = delete;
+    EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+    // Requires: no trigger() is running on another thread.
+    ~EventDispatcher()
+    {
+        for (auto& slot : slots_)
+        {
+            detach(slot.exchange(0, std::memory_order_acq_rel));
+        }
+        drain_retired();
+    }
+
+    // Replaces the handler in `slot`. Safe while other threads are inside trigger():
+    // they finish with the handler they already pinned, the next trigger sees the new one.
+    // An empty callback clears the slot.
+    void set_callback(std::size_t slot, Callback cb)
+    {
+        Node* node = cb ? new Node(std::move(cb)) : nullptr;
+
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        detach(slots_.at(slot).exchange(pack(node), std::memory_order_acq_rel));
+        drain_retired();
+    }
+
+    void clear_callback(std::size_t slot)
+    {
+        set_callback(slot, Callback());
+    }
+
+    // Snapshots every non-empty slot, invokes the snapshot, then unpins it.
+    // No mutex, no heap allocation; the snapshot lives in a fixed-size stack array.
+    std::size_t trigger(const Event& event)
+    {
+        std::array<Node*, MaxHandlers> snapshot;
+        std::array<std::size_t, MaxHandlers> snapshot_slots;
+        std::size_t pinned = 0;
+
+        for (std::size_t i = 0; i < MaxHandlers; ++i)
+        {
+            if (Node* node = pin(slots_[i]))
+            {
+                snapshot[pinned] = node;
+                snapshot_slots[pinned] = i;
+                ++pinned;
+            }
+        }
+
+        for (std::size_t i = 0; i < pinned; ++i)
+        {
+            snapshot[i]->callback(event);
+        }
+
+        for (std::size_t i = 0; i < pinned; ++i)
+        {
+            unpin(slots_[snapshot_slots[i]], snapshot[i]);
+        }
+
+        return pinned;
+    }
+
+    std::size_t handler_count() const
+    {
+        std::size_t count = 0;
+        for (const auto& slot : slots_)
+        {
+            if (unpack(slot.load(std::memory_order_acquire)) != nullptr)
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    static constexpr std::size_t capacity()
+    {
+        return MaxHandlers;
+    }
+
+private:
+    struct Node
+    {
+        explicit Node(Callback cb)
+        : callback(std::move(cb))
+        , refs(1)
+        , next_retired(nullptr)
+        {
+        }
+
+        Callback callback;
+        std::atomic<long> refs;  // 1 for "published" + external counts folded in on detach
+        Node* next_retired;
+    };
+
+    static_assert(sizeof(void*) == 8, "EventDispatcher packs a 48-bit pointer and a 16-bit count into 64 bits");
+
+    static constexpr int kCountShift = 48;
+    static constexpr std::uint64_t kOnePin = std::uint64_t(1) << kCountShift;
+    static constexpr std::uint64_t kPointerMask = kOnePin - 1;
+
+    static std::uint64_t pack(Node* node)
+    {
+        return reinterpret_cast<std::uintptr_t>(node);
+    }
+
+    static Node* unpack(std::uint64_t word)
+    {
+        return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(word & kPointerMask));
+    }
+
+    static long pins(std::uint64_t word)
+    {
+        return static_cast<long>(word >> kCountShift);
+    }
+
+    Node* pin(std::atomic<std::uint64_t>& slot)
+    {
+        if (unpack(slot.load(std::memory_order_relaxed)) == nullptr)
+        {
+            return nullptr;
+        }
+
+        std::uint64_t word = slot.fetch_add(kOnePin, std::memory_order_acquire);
+        Node* node = unpack(word);
+        if (node == nullptr)
+        {
+            // Slot was cleared between the load and the fetch_add: give the pin back if
+            // the slot is still empty. If a new node was published, the writer discarded
+            // the count together with the empty word.
+            std::uint64_t current = word + kOnePin;
+            while (unpack(current) == nullptr && pins(current) > 0 &&
+                   !slot.compare_exchange_weak(current, current - kOnePin, std::memory_order_relaxed))
+            {
+            }
+        }
+        return node;
+    }
+
+    void unpin(std::atomic<std::uint64_t>& slot, Node* node)
+    {
+        std::uint64_t current = slot.load(std::memory_order_relaxed);
+        while (unpack(current) == node)
+        {
+            if (slot.compare_exchange_weak(current, current - kOnePin, std::memory_order_release,
+                                           std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+
+        // The node was swapped out and our pin was folded into node->refs.
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            retire(node);
+        }
+    }
+
+    void detach(std::uint64_t word)
+    {
+        Node* node = unpack(word);
+        if (node == nullptr)
+        {
+            return;
+        }
+
+        // Transfer outstanding pins into the refcount and drop the "published" reference.
+        long delta = pins(word) - 1;
+        if (node->refs.fetch_add(delta, std::memory_order_acq_rel) + delta == 0)
+        {
+            retire(node);
+        }
+    }
+
+    // Nodes are never destroyed on the trigger path: destroying a std::function may
+    // free its captures, so the last trigger only pushes the node onto a Treiber
+    // stack and the next writer (or the destructor) reclaims it.
+    void retire(Node* node)
+    {
+        Node* head = retired_.load(std::memory_order_relaxed);
+        do
+        {
+            node->next_retired = head;
+        } while (!retired_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void drain_retired()
+    {
+        Node* node = retired_.exchange(nullptr, std::memory_order_acquire);
+        while (node != nullptr)
+        {
+            Node* next = node->next_retired;
+            delete node;
+            node = next;
+        }
+    }
+
+    std::array<std::atomic<std::uint64_t>, MaxHandlers> slots_;
+    std::atomic<Node*> retired_;
+    std::mutex writer_mutex_;
+};
+
+TEST_F(LockFreeBasicsTest, DispatcherInvokesEveryPublishedHandler)
+{
+    EventDispatcher<std::shared_ptr<Tracked>> dispatcher;
+    int first_calls = 0;
+    int second_calls = 0;
+
+    dispatcher.set_callback(0, [&first_calls](const std::shared_ptr<Tracked>&) { ++first_calls; });
+    dispatcher.set_callback(3, [&second_calls](const std::shared_ptr<Tracked>&) { ++second_calls; });
+
+    std::shared_ptr<Tracked> event = std::make_shared<Tracked>("Event1");
+    long use_count_in_handler = 0;
+    dispatcher.set_callback(5, [&use_count_in_handler](const std::shared_ptr<Tracked>& e)
+    {
+        use_count_in_handler = e.use_count();
+    });
+
+    // Q: trigger() passes the event by const reference. What use_count does the handler observe, and why
+    //    does that differ from EventHandler::trigger_deadlock, which takes shared_ptr by value?
+    // A:
+    // R:
+
+    EXPECT_EQ(dispatcher.trigger(event), 3u);
+    EXPECT_EQ(first_calls, 1);
+    EXPECT_EQ(second_calls, 1);
+    EXPECT_EQ(use_count_in_handler, 1);
+    EXPECT_EQ(dispatcher.handler_count(), 3u);
+
+    dispatcher.clear_callback(3);
+    EXPECT_EQ(dispatcher.trigger(event), 2u);
+    EXPECT_EQ(second_calls, 1);
+    EXPECT_EQ(EventLog::instance().count_events("copy_ctor"), 0u);
+}
+
+TEST_F(LockFreeBasicsTest, DispatcherReplacementKeepsPinnedHandlerAlive)
+{
+    EventDispatcher<int> dispatcher;
+    std::weak_ptr<Tracked> old_capture;
+    std::vector<std::string> calls;
+
+    {
+        std::shared_ptr<Tracked> capture = std::make_shared<Tracked>("OldCapture");
+        old_capture = capture;
+        dispatcher.set_callback(0, [capture, &dispatcher, &calls](const int&)
+        {
+            // Replace ourselves mid-invocation: the node running this lambda is pinned.
+            dispatcher.set_callback(0, [&calls](const int&) { calls.push_back("new"); });
+            calls.push_back("old:" + capture->name());
+        });
+    }
+
+    // Q: set_callback() runs inside the handler it replaces. Why is the old lambda's capture
+    //    still valid when calls.push_back("old:...") executes?
+    // A:
+    // R:
+
+    dispatcher.trigger(0);
+    EXPECT_FALSE(old_capture.expired());
+
+    dispatcher.trigger(0);
+    EXPECT_FALSE(old_capture.expired());
+
+    // Q: Which call retires the old node, and which call actually destroys it?
+    // A:
+    // R:
+
+    dispatcher.clear_callback(1);
+    EXPECT_TRUE(old_capture.expired());
+
+    ASSERT_EQ(calls.size(), 2u);
+    EXPECT_EQ(calls[0], "old:OldCapture");
+    EXPECT_EQ(calls[1], "new");
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(OldCapture)::dtor"), 1u);
+}
+
+TEST_F(LockFreeBasicsTest, DispatcherCrossTriggerDoesNotDeadlock)
+{
+    // Scenario 2 from test_ownership_transfer_deadlocks.cpp, with no lock held during callbacks.
+    EventDispatcher<int> h1;
+    EventDispatcher<int> h2;
+    std::atomic<int> invocations(0);
+
+    h1.set_callback(0, [&](const int& depth)
+    {
+        ++invocations;
+        if (depth > 0)
+        {
+            h2.trigger(depth - 1);
+        }
+    });
+    h2.set_callback(0, [&](const int& depth)
+    {
+        ++invocations;
+        if (depth > 0)
+        {
+            h1.trigger(depth - 1);
+        }
+    });
+
+    std::thread t1([&]() { h1.trigger(10); });
+    std::thread t2([&]() { h2.trigger(10); });
+    std::thread t3([&]() { h1.trigger(10); });
+
+    t1.join();
+    t2.join();
+    t3.join();
+
+    EXPECT_EQ(invocations.load(), 33);
+}
+
+// Baseline: the "fixed" EventHandler pattern - copy the std::function under the lock, invoke outside.
+template<typename Event>
+class MutexCopyDispatcher
+{
+public:
+    using Callback = std::function<void(const Event&)>;
+
+    void set_callback(Callback cb)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback_ = std::move(cb);
+    }
+
+    std::size_t trigger(const Event& event)
+    {
+        Callback cb;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cb = callback_;
+        }
+        if (!cb)
+        {
+            return 0;
+        }
+        cb(event);
+        return 1;
+    }
+
+private:
+    Callback callback_;
+    std::mutex mutex_;
+};
+
+struct DispatchBenchResult
+{
+    double triggers_per_sec;
+    long handler_calls;
+    long replacements;
+};
+
+template<typename Dispatcher, typename SetCallback>
+DispatchBenchResult run_dispatch_benchmark(Dispatcher& dispatcher, SetCallback set_callback, int trigger_threads,
+                                           std::chrono::milliseconds duration)
+{
+    std::atomic<long> handler_calls(0);
+    std::atomic<long> triggers(0);
+    std::atomic<long> replacements(0);
+    std::atomic<bool> stop(false);
+
+    // The capture is large enough that std::function has to heap-allocate it.
+    struct Payload
+    {
+        std::atomic<long>* counter;
+        char padding[64];
+    };
+    auto make_handler = [&handler_calls]()
+    {
+        Payload payload{&handler_calls, {}};
+        return [payload](const int&) { payload.counter->fetch_add(1, std::memory_order_relaxed); };
+    };
+    set_callback(make_handler());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < trigger_threads; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            long local = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                dispatcher.trigger(t);
+                ++local;
+            }
+            triggers.fetch_add(local);
+        });
+    }
+    threads.emplace_back([&]()
+    {
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            set_callback(make_handler());
+            replacements.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return DispatchBenchResult{triggers.load() / seconds, handler_calls.load(), replacements.load()};
+}
+
+void print_dispatch_benchmark(const char* name, int threads, const DispatchBenchResult& r)
+{
+    std::cout << "[ BENCH    ] " << name << " threads=" << threads << " triggers/s=" << static_cast<long>(r.triggers_per_sec)
+              << " set_callback churn=" << r.replacements << "\n";
+}
+
+TEST_F(LockFreeBasicsTest, DispatcherBenchmarkWithSetCallbackChurn)
+{
+    const int trigger_threads = 2;
+    const std::chrono::milliseconds duration(100);
+
+    EventDispatcher<int> lock_free;
+    DispatchBenchResult lf = run_dispatch_benchmark(
+        lock_free, [&lock_free](EventDispatcher<int>::Callback cb) { lock_free.set_callback(0, std::move(cb)); },
+        trigger_threads, duration);
+
+    MutexCopyDispatcher<int> mutex_copy;
+    DispatchBenchResult mc = run_dispatch_benchmark(
+        mutex_copy, [&mutex_copy](MutexCopyDispatcher<int>::Callback cb) { mutex_copy.set_callback(std::move(cb)); },
+        trigger_threads, duration);
+
+    print_dispatch_benchmark("EventDispatcher   ", trigger_threads, lf);
+    print_dispatch_benchmark("MutexCopyDispatch ", trigger_threads, mc);
+
+    // Q: MutexCopyDispatcher copies a heap-allocated std::function on every trigger. Which two costs does
+    //    EventDispatcher remove, and which shared cache line does it still write on every trigger?
+    // A:
+    // R:
+
+    EXPECT_GT(lf.handler_calls, 0);
+    EXPECT_GT(lf.replacements, 0);
+    EXPECT_GT(mc.handler_calls, 0);
+}
+
+TEST_F(LockFreeBasicsTest, DISABLED_DispatcherBenchmarkThreadSweep)
+{
+    for (int threads : {1, 2, 4, 8})
+    {
+        EventDispatcher<int> lock_free;
+        DispatchBenchResult lf = run_dispatch_benchmark(
+            lock_free, [&lock_free](EventDispatcher<int>::Callback cb) { lock_free.set_callback(0, std::move(cb)); },
+            threads, std::chrono::milliseconds(1000));
+
+        MutexCopyDispatcher<int> mutex_copy;
+        DispatchBenchResult mc = run_dispatch_benchmark(
+            mutex_copy, [&mutex_copy](MutexCopyDispatcher<int>::Callback cb) { mutex_copy.set_callback(std::move(cb)); },
+            threads, std::chrono::milliseconds(1000));
+
+        print_dispatch_benchmark("EventDispatcher   ", threads, lf);
+        print_dispatch_benchmark("MutexCopyDispatch ", threads, mc);
+    }
+}
+
+// ============================================================================
+// Intrusive MPSC Mailbox (Mailbox without shared_ptr and two locks)
+// ============================================================================
+
+// Messages embed the queue link, so send() never allocates a queue node.
+struct MailboxHook
+{
+    std::atomic<MailboxHook*> next{nullptr};
+};
+
+// Vyukov's intrusive multi-producer / single-consumer queue.
+// push() is wait-free: one exchange on head_ plus one store into the previous node.
+// pop() belongs to the single consumer and may return nullptr while a producer is
+// between those two steps; the message becomes visible once the producer finishes.
+class IntrusiveMpscQueue
+{
+public:
+    IntrusiveMpscQueue()
+    : head_(&stub_)
+    , tail_(&stub_)
+    {
+    }
+
+    IntrusiveMpscQueue(const IntrusiveMpscQueue&) = delete;
+    IntrusiveMpscQueue& operator=(const IntrusiveMpscQueue&) = delete;
+
+    void push(MailboxHook* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        MailboxHook* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    MailboxHook* pop()
+    {
+        MailboxHook* tail = tail_;
+        MailboxHook* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &stub_)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr)
+        {
+            tail_ = next;
+            return tail;
+        }
+
+        if (tail != head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        // `tail` is the last node: re-insert the stub behind it so it can be unlinked.
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    std::atomic<MailboxHook*> head_;
+    MailboxHook* tail_;
+    MailboxHook stub_;
+};
+
+// Lets a consumer block on an arbitrary lock-free condition without the producer
+// paying for a mutex when nobody is waiting.
+//   consumer: key = prepare_wait(); if (condition) cancel_wait(); else wait(key);
+//   producer: make condition true; notify();
+// state_ holds the epoch in the high 32 bits and the number of waiters in the low 32.
+class EventCount
+{
+public:
+    using Key = std::uint32_t;
+
+    EventCount()
+    : state_(0)
+    {
+    }
+
+    Key prepare_wait()
+    {
+        std::uint64_t prev = state_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return static_cast<Key>(prev >> kEpochShift);
+    }
+
+    void cancel_wait()
+    {
+        state_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void wait(Key key)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this, key]() { return epoch() != key; });
+        state_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((state_.load(std::memory_order_relaxed) & kWaiterMask) == 0)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_.fetch_add(kOneEpoch, std::memory_order_seq_cst);
+        }
+        cv_.notify_all();
+    }
+
+private:
+    static constexpr int kEpochShift = 32;
+    static constexpr std::uint64_t kOneEpoch = std::uint64_t(1) << kEpochShift;
+    static constexpr std::uint64_t kWaiterMask = kOneEpoch - 1;
+
+    Key epoch() const
+    {
+        return static_cast<Key>(state_.load(std::memory_order_seq_cst) >> kEpochShift);
+    }
+
+    std::atomic<std::uint64_t> state_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// Any thread may send(); only the owning thread may receive or drain.
+// Ownership travels as unique_ptr: release() on send, adopt on receive - no refcounts.
+// Several mailboxes can share one EventCount, e.g. all mailboxes drained by one worker.
+template<typename T>
+class LockFreeMailbox
+{
+    static_assert(std::is_base_of<MailboxHook, T>::value, "LockFreeMailbox messages must derive from MailboxHook");
+
+public:
+    explicit LockFreeMailbox(EventCount* wakeup = nullptr)
+    : wakeup_(wakeup)
+    {
+    }
+
+    LockFreeMailbox(const LockFreeMailbox&) = delete;
+    LockFreeMailbox& operator=(const LockFreeMailbox&) = delete;
+
+    // Requires: no send() is running on another thread.
+    ~LockFreeMailbox()
+    {
+        while (try_receive())
+        {
+        }
+    }
+
+    void send(std::unique_ptr<T> msg)
+    {
+        queue_.push(static_cast<MailboxHook*>(msg.release()));
+        if (wakeup_ != nullptr)
+        {
+            wakeup_->notify();
+        }
+    }
+
+    std::unique_ptr<T> try_receive()
+    {
+        return std::unique_ptr<T>(static_cast<T*>(queue_.pop()));
+    }
+
+    // Blocks on the EventCount if one was supplied, otherwise yields between polls.
+    std::unique_ptr<T> receive()
+    {
+        while (true)
+        {
+            if (std::unique_ptr<T> msg = try_receive())
+            {
+                return msg;
+            }
+            if (wakeup_ == nullptr)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            EventCount::Key key = wakeup_->prepare_wait();
+            if (std::unique_ptr<T> msg = try_receive())
+            {
+                wakeup_->cancel_wait();
+                return msg;
+            }
+            wakeup_->wait(key);
+        }
+    }
+
+    // Hands up to max_batch messages to handler(std::unique_ptr<T>) and returns how many.
+    template<typename Handler>
+    std::size_t drain(Handler&& handler, std::size_t max_batch = std::numeric_limits<std::size_t>::max())
+    {
+        std::size_t drained = 0;
+        while (drained < max_batch)
+        {
+            std::unique_ptr<T> msg = try_receive();
+            if (!msg)
+            {
+                break;
+            }
+            handler(std::move(msg));
+            ++drained;
+        }
+        return drained;
+    }
+
+private:
+    IntrusiveMpscQueue queue_;
+    EventCount* wakeup_;
+};
+
+struct TrackedMessage : MailboxHook
+{
+    explicit TrackedMessage(const std::string& name)
+    : payload(name)
+    {
+    }
+
+    Tracked payload;
+};
+
+struct SequenceMessage : MailboxHook
+{
+    SequenceMessage(int producer_id, long sequence)
+    : producer(producer_id)
+    , seq(sequence)
+    {
+    }
+
+    int producer;
+    long seq;
+};
+
+TEST_F(LockFreeBasicsTest, MailboxTransfersUniquePtrWithoutCopies)
+{
+    LockFreeMailbox<TrackedMessage> mailbox;
+
+    std::unique_ptr<TrackedMessage> msg(new TrackedMessage("Msg1"));
+    TrackedMessage* raw = msg.get();
+    mailbox.send(std::move(msg));
+
+    // Q: After send(), who owns the TrackedMessage, and what holds the pointer to it?
+    // A:
+    // R:
+
+    EXPECT_EQ(msg, nullptr);
+
+    std::unique_ptr<TrackedMessage> received = mailbox.try_receive();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(received.get(), raw);
+    EXPECT_EQ(received->payload.name(), "Msg1");
+    EXPECT_EQ(mailbox.try_receive(), nullptr);
+
+    EXPECT_EQ(EventLog::instance().count_events("copy_ctor"), 0u);
+    EXPECT_EQ(EventLog::instance().count_events("move_ctor"), 0u);
+}
+
+TEST_F(LockFreeBasicsTest, MailboxDrainsInFifoBatches)
+{
+    LockFreeMailbox<SequenceMessage> mailbox;
+    for (long i = 0; i < 10; ++i)
+    {
+        mailbox.send(std::unique_ptr<SequenceMessage>(new SequenceMessage(0, i)));
+    }
+
+    std::vector<long> seen;
+    auto collect = [&seen](std::unique_ptr<SequenceMessage> m) { seen.push_back(m->seq); };
+
+    EXPECT_EQ(mailbox.drain(collect, 4), 4u);
+    EXPECT_EQ(mailbox.drain(collect, 4), 4u);
+    EXPECT_EQ(mailbox.drain(collect), 2u);
+    EXPECT_EQ(mailbox.drain(collect), 0u);
+
+    ASSERT_EQ(seen.size(), 10u);
+    for (long i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(seen[i], i);
+    }
+}
+
+TEST_F(LockFreeBasicsTest, MailboxDestructorDeletesUndeliveredMessages)
+{
+    {
+        LockFreeMailbox<TrackedMessage> mailbox;
+        mailbox.send(std::unique_ptr<TrackedMessage>(new TrackedMessage("Pending1")));
+        mailbox.send(std::unique_ptr<TrackedMessage>(new TrackedMessage("Pending2")));
+    }
+
+    EXPECT_EQ(EventLog::instance().count_events("::dtor"), 2u);
+}
+
+TEST_F(LockFreeBasicsTest, MailboxFanInPreservesPerProducerOrder)
+{
+    const int producers = 4;
+    const long per_producer = 5000;
+    EventCount wakeup;
+    LockFreeMailbox<SequenceMessage> mailbox(&wakeup);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&mailbox, p, per_producer]()
+        {
+            for (long i = 0; i < per_producer; ++i)
+            {
+                mailbox.send(std::unique_ptr<SequenceMessage>(new SequenceMessage(p, i)));
+            }
+        });
+    }
+
+    // Q: The queue is FIFO per producer but not globally. Why can't an MPSC queue built on a single
+    //    exchange promise a global order between two producers?
+    // A:
+    // R:
+
+    std::vector<long> next_expected(producers, 0);
+    bool in_order = true;
+    for (long received = 0; received < producers * per_producer; ++received)
+    {
+        std::unique_ptr<SequenceMessage> msg = mailbox.receive();
+        in_order = in_order && msg->seq == next_expected[msg->producer];
+        next_expected[msg->producer] = msg->seq + 1;
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(mailbox.try_receive(), nullptr);
+}
+
+// Baseline: the original Mailbox shape - shared_ptr messages behind a mutex.
+template<typename T>
+class LockedMailbox
+{
+public:
+    void send(std::shared_ptr<T> msg)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            messages_.push_back(std::move(msg));
+        }
+        cv_.notify_one();
+    }
+
+    std::shared_ptr<T> receive()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return head_ < messages_.size(); });
+        std::shared_ptr<T> msg = std::move(messages_[head_++]);
+        if (head_ == messages_.size())
+        {
+            messages_.clear();
+            head_ = 0;
+        }
+        return msg;
+    }
+
+private:
+    std::vector<std::shared_ptr<T>> messages_;
+    std::size_t head_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+template<typename Mailbox, typename MakeMessage>
+double run_ping_pong_ns(int round_trips, Mailbox& ping, Mailbox& pong, MakeMessage make_message)
+{
+    std::thread echo([&]()
+    {
+        for (int i = 0; i < round_trips; ++i)
+        {
+            pong.send(ping.receive());
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < round_trips; ++i)
+    {
+        ping.send(make_message(i));
+        pong.receive();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    echo.join();
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / round_trips;
+}
+
+template<typename Mailbox, typename MakeMessage>
+double run_fan_in_msgs_per_sec(int producers, long per_producer, Mailbox& mailbox, MakeMessage make_message)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&mailbox, &make_message, p, per_producer]()
+        {
+            for (long i = 0; i < per_producer; ++i)
+            {
+                mailbox.send(make_message(p, i));
+            }
+        });
+    }
+    for (long i = 0; i < producers * per_producer; ++i)
+    {
+        mailbox.receive();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    return producers * per_producer / seconds;
+}
+
+void run_mailbox_benchmarks(int round_trips, int producers, long per_producer)
+{
+    {
+        EventCount ping_wakeup;
+        EventCount pong_wakeup;
+        LockFreeMailbox<SequenceMessage> ping(&ping_wakeup);
+        LockFreeMailbox<SequenceMessage> pong(&pong_wakeup);
+        double ns = run_ping_pong_ns(round_trips, ping, pong, [](int i)
+        {
+            return std::unique_ptr<SequenceMessage>(new SequenceMessage(0, i));
+        });
+        std::cout << "[ BENCH    ] LockFreeMailbox ping-pong round trip ns=" << static_cast<long>(ns) << "\n";
+    }
+    {
+        LockedMailbox<SequenceMessage> ping;
+        LockedMailbox<SequenceMessage> pong;
+        double ns = run_ping_pong_ns(round_trips, ping, pong, [](int i)
+        {
+            return std::make_shared<SequenceMessage>(0, i);
+        });
+        std::cout << "[ BENCH    ] LockedMailbox   ping-pong round trip ns=" << static_cast<long>(ns) << "\n";
+    }
+    {
+        EventCount wakeup;
+        LockFreeMailbox<SequenceMessage> mailbox(&wakeup);
+        double rate = run_fan_in_msgs_per_sec(producers, per_producer, mailbox, [](int p, long i)
+        {
+            return std::unique_ptr<SequenceMessage>(new SequenceMessage(p, i));
+        });
+        std::cout << "[ BENCH    ] LockFreeMailbox fan-in producers=" << producers
+                  << " msgs/s=" << static_cast<long>(rate) << "\n";
+    }
+    {
+        LockedMailbox<SequenceMessage> mailbox;
+        double rate = run_fan_in_msgs_per_sec(producers, per_producer, mailbox, [](int p, long i)
+        {
+            return std::make_shared<SequenceMessage>(p, i);
+        });
+        std::cout << "[ BENCH    ] LockedMailbox   fan-in producers=" << producers
+                  << " msgs/s=" << static_cast<long>(rate) << "\n";
+    }
+}
+
+TEST_F(LockFreeBasicsTest, MailboxBenchmarkPingPongAndFanIn)
+{
+    // Q: In ping-pong, each side blocks almost every time. Which cost dominates the round trip -
+    //    the queue operations or the wake-up - and what would change if the receiver spun briefly first?
+    // A:
+    // R:
+
+    run_mailbox_benchmarks(2000, 4, 20000);
+}
+
+TEST_F(LockFreeBasicsTest, DISABLED_MailboxBenchmarkLarge)
+{
+    run_mailbox_benchmarks(200000, 8, 1000000);
+}
+
+// ============================================================================
+// Sharded Counters (one hot std::atomic split across cache lines)
+// ============================================================================
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// Each thread is assigned a shard the first time it touches any sharded_counter, and
+// tickets are never recycled: only while at most Shards threads have ever been created
+// is every add() an RMW on a line no other thread writes. After that, shards are shared
+// round-robin, so adds stay correct but some lines are written by two threads again.
+// read() sums the shards with relaxed loads: while adds are in flight the result is a
+// value the counter passed through or will pass through, not an atomic snapshot; once
+// the writers are joined (or otherwise synchronized with) it is exact.
+template<typename T = long, std::size_t Shards = 32>
+class sharded_counter
+{
+    static_assert(std::is_integral<T>::value, "sharded_counter requires an integral type");
+
+public:
+    sharded_counter()
+    {
+        for (auto& shard : shards_)
+        {
+            shard.value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    sharded_counter(const sharded_counter&) = delete;
+    sharded_counter& operator=(const sharded_counter&) = delete;
+
+    void add(T delta = 1)
+    {
+        shards_[this_thread_shard()].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    sharded_counter& operator++()
+    {
+        add(1);
+        return *this;
+    }
+
+    T read() const
+    {
+        T sum = 0;
+        for (const auto& shard : shards_)
+        {
+            sum += shard.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    // Requires: no concurrent add().
+    void reset()
+    {
+        for (auto& shard : shards_)
+        {
+            shard.value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr std::size_t shard_count()
+    {
+        return Shards;
+    }
+
+    static std::size_t this_thread_shard()
+    {
+        static std::atomic<std::size_t> next_thread(0);
+        thread_local std::size_t shard = next_thread.fetch_add(1, std::memory_order_relaxed) % Shards;
+        return shard;
+    }
+
+private:
+    struct alignas(kCacheLineSize) Shard
+    {
+        std::atomic<T> value;
+    };
+
+    std::array<Shard, Shards> shards_;
+};
+
+static_assert(sizeof(sharded_counter<long, 4>) == 4 * kCacheLineSize, "each shard owns a full cache line");
+
+TEST_F(LockFreeBasicsTest, ShardedCounterIsExactAfterJoin)
+{
+    const int threads = 8;
+    const long per_thread = 10000;
+    sharded_counter<long, 4> counter;
+
+    // Q: With 8 threads and 4 shards, two threads share every shard. Is the final count still exact?
+    //    What did sharing cost?
+    // A:
+    // R:
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&counter, per_thread]()
+        {
+            for (long i = 0; i < per_thread; ++i)
+            {
+                ++counter;
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    EXPECT_EQ(counter.read(), threads * per_thread);
+
+    counter.reset();
+    counter.add(-5);
+    counter.add(7);
+    EXPECT_EQ(counter.read(), 2);
+}
+
+TEST_F(LockFreeBasicsTest, ShardedCounterReadIsMonotonicWhileIncrementing)
+{
+    sharded_counter<long, 8> counter;
+    std::atomic<bool> stop(false);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 3; ++t)
+    {
+        workers.emplace_back([&counter, &stop]()
+        {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                counter.add(1);
+            }
+        });
+    }
+
+    // Q: read() is not a snapshot. Why can it still never observe the total going backwards when
+    //    every add() is positive?
+    // A:
+    // R:
+
+    long previous = 0;
+    bool monotonic = true;
+    for (int i = 0; i < 1000; ++i)
+    {
+        long current = counter.read();
+        monotonic = monotonic && current >= previous;
+        previous = current;
+    }
+    stop = true;
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    EXPECT_TRUE(monotonic);
+    EXPECT_GE(counter.read(), previous);
+}
+
+template<typename Counter>
+double run_counter_benchmark(Counter& counter, int threads, long adds_per_thread)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (long i = 0; i < adds_per_thread; ++i)
+            {
+                ++counter;
+            }
+        });
+    }
+    while (ready.load() != threads)
+    {
+        std::this_thread::yield();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * adds_per_thread / seconds;
+}
+
+void run_counter_scaling(const std::vector<int>& thread_counts, long adds_per_thread)
+{
+    for (int threads : thread_counts)
+    {
+        std::atomic<long> single(0);
+        sharded_counter<long> sharded;
+
+        double single_rate = run_counter_benchmark(single, threads, adds_per_thread);
+        double sharded_rate = run_counter_benchmark(sharded, threads, adds_per_thread);
+
+        EXPECT_EQ(single.load(), threads * adds_per_thread);
+        EXPECT_EQ(sharded.read(), threads * adds_per_thread);
+
+        std::cout << "[ BENCH    ] threads=" << threads << " std::atomic adds/s=" << static_cast<long>(single_rate)
+                  << " sharded_counter adds/s=" << static_cast<long>(sharded_rate) << "\n";
+    }
+}
+
+TEST_F(LockFreeBasicsTest, ShardedCounterScalingBenchmark)
+{
+    // Q: On one core the two columns are close; on many cores the single atomic flattens or drops.
+    //    What is the cache line doing on every ++single that it is not doing on ++sharded?
+    // A:
+    // R:
+
+    run_counter_scaling({1, 2, 4}, 200000);
+}
+
+TEST_F(LockFreeBasicsTest, DISABLED_ShardedCounterScalingBenchmarkFull)
+{
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    for (unsigned t = 1; t <= hw * 2; t *= 2)
+    {
+        thread_counts.push_back(static_cast<int>(t));
+    }
+    run_counter_scaling(thread_counts, 20000000);
+}
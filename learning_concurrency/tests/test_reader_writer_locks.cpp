@@ -2,9 +2,586 @@
 // Estimated Time: 4 hours
 // Difficulty: Moderate
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
-// TODO: Implement test cases for shared_mutex (C++17)
-// TODO: Implement test cases for shared_lock
-// TODO: Implement test cases for reader-writer patterns
+class ReaderWriterLocksTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// ============================================================================
+// Seqlock: optimistic readers for trivially copyable snapshots
+// ============================================================================
+
+// Readers never write shared memory: they read the sequence, copy the payload, and
+// re-read the sequence; an odd or changed sequence means a writer was active and the
+// copy is retried. The payload is kept in relaxed atomic words so the racy copy is
+// well-defined C++ rather than a data race on plain bytes.
+template<typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock snapshots must be trivially copyable");
+
+public:
+    explicit Seqlock(const T& initial = T())
+    : seq_(0)
+    {
+        store_words(initial);
+    }
+
+    T read() const
+    {
+        std::array<std::uint64_t, kWords> copy;
+        while (true)
+        {
+            std::uint64_t before = seq_.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (std::size_t i = 0; i < kWords; ++i)
+            {
+                copy[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before)
+            {
+                break;
+            }
+        }
+        T result;
+        std::memcpy(&result, copy.data(), sizeof(T));
+        return result;
+    }
+
+    void write(const T& value)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        std::uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words(value);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+private:
+    static constexpr std::size_t kWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    void store_words(const T& value)
+    {
+        std::array<std::uint64_t, kWords> copy{};
+        std::memcpy(copy.data(), &value, sizeof(T));
+        for (std::size_t i = 0; i < kWords; ++i)
+        {
+            words_[i].store(copy[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<std::uint64_t> seq_;
+    std::array<std::atomic<std::uint64_t>, kWords> words_;
+    std::mutex writer_mutex_;
+};
+
+// ============================================================================
+// Writer-preferring ticket rwlock
+// ============================================================================
+
+// Writers queue FIFO on a ticket; the head writer raises kWriter, which stops new
+// readers, then waits for in-flight readers to drain. An unlocking writer that sees
+// another ticket waiting keeps kWriter raised, so a stream of readers cannot slip in
+// between two writers. Satisfies SharedMutex, so std::shared_lock works with it.
+class TicketRwLock
+{
+public:
+    TicketRwLock()
+    : next_ticket_(0)
+    , now_serving_(0)
+    , state_(0)
+    {
+    }
+
+    TicketRwLock(const TicketRwLock&) = delete;
+    TicketRwLock& operator=(const TicketRwLock&) = delete;
+
+    void lock()
+    {
+        std::uint32_t ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+        while (now_serving_.load(std::memory_order_acquire) != ticket)
+        {
+            std::this_thread::yield();
+        }
+        state_.fetch_or(kWriter, std::memory_order_acquire);
+        while ((state_.load(std::memory_order_acquire) & kReaderMask) != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock()
+    {
+        std::uint32_t serving = now_serving_.load(std::memory_order_relaxed);
+        if (next_ticket_.load(std::memory_order_relaxed) == serving + 1)
+        {
+            state_.fetch_and(~kWriter, std::memory_order_release);
+        }
+        now_serving_.store(serving + 1, std::memory_order_release);
+    }
+
+    void lock_shared()
+    {
+        std::uint32_t state = state_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if (state & kWriter)
+            {
+                std::this_thread::yield();
+                state = state_.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+    }
+
+    void unlock_shared()
+    {
+        state_.fetch_sub(1, std::memory_order_release);
+    }
+
+    // True once a writer has raised kWriter: new readers are held off from then on.
+    bool writer_pending() const
+    {
+        return (state_.load(std::memory_order_acquire) & kWriter) != 0;
+    }
+
+private:
+    static constexpr std::uint32_t kWriter = 0x80000000u;
+    static constexpr std::uint32_t kReaderMask = kWriter - 1;
+
+    alignas(kCacheLineSize) std::atomic<std::uint32_t> next_ticket_;
+    alignas(kCacheLineSize) std::atomic<std::uint32_t> now_serving_;
+    alignas(kCacheLineSize) std::atomic<std::uint32_t> state_;
+};
+
+// ============================================================================
+// Distributed (big-reader) rwlock
+// ============================================================================
+
+// Each reader thread announces itself on its own cache line, so concurrent readers
+// never write a shared line. A writer raises the global flag and then waits for every
+// shard to drain: writes cost O(Shards) but reads scale with the number of cores.
+// Reader and writer use seq_cst so that at least one of them sees the other's store.
+template<std::size_t Shards = 32>
+class DistributedRwLock
+{
+public:
+    DistributedRwLock()
+    : writer_active_(false)
+    {
+        for (auto& shard : shards_)
+        {
+            shard.readers.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    DistributedRwLock(const DistributedRwLock&) = delete;
+    DistributedRwLock& operator=(const DistributedRwLock&) = delete;
+
+    void lock()
+    {
+        writer_mutex_.lock();
+        writer_active_.store(true, std::memory_order_seq_cst);
+        for (auto& shard : shards_)
+        {
+            while (shard.readers.load(std::memory_order_seq_cst) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock()
+    {
+        writer_active_.store(false, std::memory_order_release);
+        writer_mutex_.unlock();
+    }
+
+    void lock_shared()
+    {
+        Shard& shard = shards_[this_thread_shard()];
+        while (true)
+        {
+            shard.readers.fetch_add(1, std::memory_order_seq_cst);
+            if (!writer_active_.load(std::memory_order_seq_cst))
+            {
+                return;
+            }
+            shard.readers.fetch_sub(1, std::memory_order_relaxed);
+            while (writer_active_.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock_shared()
+    {
+        shards_[this_thread_shard()].readers.fetch_sub(1, std::memory_order_release);
+    }
+
+    // True once a writer has raised the global flag and is waiting for (or holds) the lock.
+    bool writer_pending() const
+    {
+        return writer_active_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct alignas(kCacheLineSize) Shard
+    {
+        std::atomic<int> readers;
+    };
+
+    static std::size_t this_thread_shard()
+    {
+        static std::atomic<std::size_t> next_thread(0);
+        thread_local std::size_t shard = next_thread.fetch_add(1, std::memory_order_relaxed) % Shards;
+        return shard;
+    }
+
+    std::array<Shard, Shards> shards_;
+    alignas(kCacheLineSize) std::atomic<bool> writer_active_;
+    std::mutex writer_mutex_;
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+// A config snapshot is consistent when every field carries the same version.
+struct ServiceConfig
+{
+    std::uint64_t version;
+    std::uint32_t timeout_ms;
+    std::uint32_t max_connections;
+    std::uint64_t checksum;
+
+    static ServiceConfig make(std::uint64_t version)
+    {
+        return ServiceConfig{version, static_cast<std::uint32_t>(version * 3), static_cast<std::uint32_t>(version * 7),
+                             version ^ 0xA5A5A5A5u};
+    }
+
+    bool consistent() const
+    {
+        return timeout_ms == static_cast<std::uint32_t>(version * 3) &&
+               max_connections == static_cast<std::uint32_t>(version * 7) && checksum == (version ^ 0xA5A5A5A5u);
+    }
+};
+
+// Uniform read()/write() over a SharedMutex-style lock guarding a plain ServiceConfig.
+template<typename Lock>
+class LockedConfig
+{
+public:
+    LockedConfig()
+    : config_(ServiceConfig::make(0))
+    {
+    }
+
+    ServiceConfig read()
+    {
+        std::shared_lock<Lock> lock(lock_);
+        return config_;
+    }
+
+    void write(const ServiceConfig& config)
+    {
+        std::lock_guard<Lock> lock(lock_);
+        config_ = config;
+    }
+
+private:
+    Lock lock_;
+    ServiceConfig config_;
+};
+
+class SeqlockConfig
+{
+public:
+    SeqlockConfig()
+    : seqlock_(ServiceConfig::make(0))
+    {
+    }
+
+    ServiceConfig read()
+    {
+        return seqlock_.read();
+    }
+
+    void write(const ServiceConfig& config)
+    {
+        seqlock_.write(config);
+    }
+
+private:
+    Seqlock<ServiceConfig> seqlock_;
+};
+
+struct RwBenchResult
+{
+    double ops_per_sec;
+    long reads;
+    long writes;
+    long torn_reads;
+};
+
+// Every thread does `reads_per_write` reads for each write; readers validate each snapshot.
+template<typename Config>
+RwBenchResult run_rw_workload(int threads, int reads_per_write, std::chrono::milliseconds duration)
+{
+    Config config;
+    std::atomic<bool> stop(false);
+    std::atomic<std::uint64_t> next_version(1);
+    std::atomic<long> reads(0);
+    std::atomic<long> writes(0);
+    std::atomic<long> torn(0);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            long local_reads = 0;
+            long local_writes = 0;
+            long local_torn = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (int r = 0; r < reads_per_write; ++r)
+                {
+                    local_torn += !config.read().consistent();
+                    ++local_reads;
+                }
+                config.write(ServiceConfig::make(next_version.fetch_add(1, std::memory_order_relaxed)));
+                ++local_writes;
+            }
+            reads += local_reads;
+            writes += local_writes;
+            torn += local_torn;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return RwBenchResult{(reads.load() + writes.load()) / seconds, reads.load(), writes.load(), torn.load()};
+}
+
+TEST_F(ReaderWriterLocksTest, SeqlockReadsLatestSnapshot)
+{
+    Seqlock<ServiceConfig> seqlock(ServiceConfig::make(1));
+    EXPECT_EQ(seqlock.read().version, 1u);
+
+    seqlock.write(ServiceConfig::make(42));
+    ServiceConfig snapshot = seqlock.read();
+
+    // Q: A seqlock reader may copy a half-written struct. Why does the caller never see it?
+    // A:
+    // R:
+
+    EXPECT_EQ(snapshot.version, 42u);
+    EXPECT_TRUE(snapshot.consistent());
+}
+
+// Orders the tests without sleeping: returns once the writer thread has announced itself,
+// so what the test checks next no longer depends on how the threads were scheduled.
+template<typename Lock>
+void wait_for_pending_writer(const Lock& lock)
+{
+    while (!lock.writer_pending())
+    {
+        std::this_thread::yield();
+    }
+}
+
+TEST_F(ReaderWriterLocksTest, TicketRwLockAllowsConcurrentReaders)
+{
+    TicketRwLock lock;
+    lock.lock_shared();
+
+    std::atomic<bool> second_reader_in(false);
+    std::thread reader([&]()
+    {
+        std::shared_lock<TicketRwLock> shared(lock);
+        second_reader_in = true;
+    });
+    reader.join();
+    EXPECT_TRUE(second_reader_in.load());
+
+    std::atomic<bool> writer_in(false);
+    std::thread writer([&]()
+    {
+        std::lock_guard<TicketRwLock> exclusive(lock);
+        writer_in = true;
+    });
+    wait_for_pending_writer(lock);
+    EXPECT_FALSE(writer_in.load());
+
+    lock.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(writer_in.load());
+}
+
+TEST_F(ReaderWriterLocksTest, TicketRwLockBlocksNewReadersWhileWriterWaits)
+{
+    TicketRwLock lock;
+    lock.lock_shared();
+
+    std::atomic<bool> writer_in(false);
+    std::thread writer([&]()
+    {
+        std::lock_guard<TicketRwLock> exclusive(lock);
+        writer_in = true;
+    });
+    wait_for_pending_writer(lock);
+
+    std::atomic<bool> late_reader_locking(false);
+    std::atomic<bool> late_reader_in(false);
+    std::atomic<bool> late_reader_saw_writer(false);
+    std::thread late_reader([&]()
+    {
+        late_reader_locking = true;
+        std::shared_lock<TicketRwLock> shared(lock);
+        late_reader_saw_writer = writer_in.load();
+        late_reader_in = true;
+    });
+
+    // Give the reader a bounded window to get through lock_shared(): a lock that let it
+    // past the pending writer would almost surely do so here. The order itself is still
+    // checked deterministically by late_reader_saw_writer below.
+    while (!late_reader_locking.load())
+    {
+        std::this_thread::yield();
+    }
+    for (int spin = 0; spin < 10000 && !late_reader_in.load(); ++spin)
+    {
+        std::this_thread::yield();
+    }
+
+    // Q: std::shared_mutex does not specify who wins here. What starvation does writer preference
+    //    prevent, and what does it risk for readers?
+    // A:
+    // R:
+
+    EXPECT_FALSE(late_reader_in.load());
+
+    lock.unlock_shared();
+    writer.join();
+    late_reader.join();
+    EXPECT_TRUE(late_reader_saw_writer.load());
+}
+
+TEST_F(ReaderWriterLocksTest, DistributedRwLockExcludesWriterFromReaders)
+{
+    DistributedRwLock<4> lock;
+    lock.lock_shared();
+
+    std::atomic<bool> writer_in(false);
+    std::thread writer([&]()
+    {
+        std::lock_guard<DistributedRwLock<4>> exclusive(lock);
+        writer_in = true;
+    });
+    wait_for_pending_writer(lock);
+    EXPECT_FALSE(writer_in.load());
+
+    lock.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(writer_in.load());
+}
+
+TEST_F(ReaderWriterLocksTest, AllImplementationsNeverReturnTornSnapshots)
+{
+    const int threads = 4;
+    const std::chrono::milliseconds duration(30);
+
+    RwBenchResult seq = run_rw_workload<SeqlockConfig>(threads, 10, duration);
+    RwBenchResult ticket = run_rw_workload<LockedConfig<TicketRwLock>>(threads, 10, duration);
+    RwBenchResult distributed = run_rw_workload<LockedConfig<DistributedRwLock<>>>(threads, 10, duration);
+    RwBenchResult shared = run_rw_workload<LockedConfig<std::shared_mutex>>(threads, 10, duration);
+
+    EXPECT_EQ(seq.torn_reads, 0);
+    EXPECT_EQ(ticket.torn_reads, 0);
+    EXPECT_EQ(distributed.torn_reads, 0);
+    EXPECT_EQ(shared.torn_reads, 0);
+    EXPECT_GT(seq.writes, 0);
+    EXPECT_GT(ticket.writes, 0);
+    EXPECT_GT(distributed.writes, 0);
+    EXPECT_GT(shared.writes, 0);
+}
+
+void run_rw_comparison(int threads, const std::vector<int>& ratios, std::chrono::milliseconds duration)
+{
+    for (int ratio : ratios)
+    {
+        RwBenchResult shared = run_rw_workload<LockedConfig<std::shared_mutex>>(threads, ratio, duration);
+        RwBenchResult seq = run_rw_workload<SeqlockConfig>(threads, ratio, duration);
+        RwBenchResult ticket = run_rw_workload<LockedConfig<TicketRwLock>>(threads, ratio, duration);
+        RwBenchResult distributed = run_rw_workload<LockedConfig<DistributedRwLock<>>>(threads, ratio, duration);
+
+        std::cout << "[ BENCH    ] threads=" << threads << " read:write=" << ratio << ":1"
+                  << " shared_mutex=" << static_cast<long>(shared.ops_per_sec)
+                  << " seqlock=" << static_cast<long>(seq.ops_per_sec)
+                  << " ticket=" << static_cast<long>(ticket.ops_per_sec)
+                  << " distributed=" << static_cast<long>(distributed.ops_per_sec) << " ops/s\n";
+    }
+}
+
+TEST_F(ReaderWriterLocksTest, ReaderWriterComparisonBenchmark)
+{
+    // Q: At 100:1 the seqlock and distributed lock should pull ahead as cores are added. Which write to
+    //    shared memory does every std::shared_mutex reader perform that theirs avoid?
+    // A:
+    // R:
+
+    // Q: At 1:1, which implementation do you expect to fall behind, and why?
+    // A:
+    // R:
+
+    run_rw_comparison(4, {100, 10, 1}, std::chrono::milliseconds(30));
+}
+
+TEST_F(ReaderWriterLocksTest, DISABLED_ReaderWriterComparisonBenchmarkFull)
+{
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= hw; threads *= 2)
+    {
+        run_rw_comparison(static_cast<int>(threads), {1000, 100, 30, 10, 3, 1}, std::chrono::milliseconds(500));
+    }
+}
@@ -2,10 +2,514 @@
 // Estimated Time: 3 hours
 // Difficulty: Moderate
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Phased singleton lifecycle with a thread-local access cache
+// ============================================================================
+
+// Owns construction and destruction of every registered singleton. initialize() builds
+// them in ascending phase order (registration order within a phase); shutdown() destroys
+// them in exactly the reverse order. Nothing is left to static destruction order.
+class SingletonLifecycle
+{
+public:
+    static SingletonLifecycle& instance()
+    {
+        static SingletonLifecycle lifecycle;
+        return lifecycle;
+    }
+
+    template<typename T>
+    void add(int phase, const std::string& name);
+
+    void initialize()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (initialized_)
+        {
+            throw std::logic_error("SingletonLifecycle already initialized");
+        }
+        std::stable_sort(entries_.begin(), entries_.end(),
+                         [](const Entry& a, const Entry& b) { return a.phase < b.phase; });
+
+        created_ = 0;
+        try
+        {
+            for (; created_ < entries_.size(); ++created_)
+            {
+                EventLog::instance().record("SingletonLifecycle::create " + entries_[created_].name);
+                entries_[created_].create();
+            }
+        }
+        catch (...)
+        {
+            destroy_created();
+            throw;
+        }
+        initialized_ = true;
+    }
+
+    // Requires: no other thread is still using a singleton reference.
+    void shutdown()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!initialized_)
+        {
+            return;
+        }
+        destroy_created();
+        initialized_ = false;
+    }
+
+    // Drops all registrations; used between independent test cases.
+    void clear()
+    {
+        shutdown();
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+    static std::uint64_t generation()
+    {
+        return generation_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry
+    {
+        int phase;
+        std::string name;
+        std::function<void()> create;
+        std::function<void()> destroy;
+    };
+
+    SingletonLifecycle() = default;
+
+    void destroy_created()
+    {
+        // Invalidate every thread-local cache before any object goes away.
+        generation_.fetch_add(1, std::memory_order_release);
+        while (created_ > 0)
+        {
+            --created_;
+            EventLog::instance().record("SingletonLifecycle::destroy " + entries_[created_].name);
+            entries_[created_].destroy();
+        }
+    }
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    std::size_t created_ = 0;
+    bool initialized_ = false;
+    static inline std::atomic<std::uint64_t> generation_{1};
+};
+
+// Singleton<T>::instance() fast path: two thread-local loads, one relaxed load of a
+// read-mostly global and a compare - no guard variable, no lock, no refcount.
+// The first access on each thread (and the first after a shutdown) takes the slow
+// path and re-reads the published pointer.
+template<typename T>
+class Singleton
+{
+public:
+    static T& instance()
+    {
+        thread_local Cache cache;
+        std::uint64_t generation = SingletonLifecycle::generation();
+        if (cache.ptr != nullptr && cache.generation == generation)
+        {
+            return *cache.ptr;
+        }
+        return refresh(cache, generation);
+    }
+
+    static bool alive()
+    {
+        return published_.load(std::memory_order_acquire) != nullptr;
+    }
+
+private:
+    friend class SingletonLifecycle;
+
+    struct Cache
+    {
+        T* ptr = nullptr;
+        std::uint64_t generation = 0;
+    };
+
+    static T& refresh(Cache& cache, std::uint64_t generation)
+    {
+        T* ptr = published_.load(std::memory_order_acquire);
+        if (ptr == nullptr)
+        {
+            throw std::logic_error("Singleton accessed outside SingletonLifecycle::initialize()/shutdown()");
+        }
+        cache.ptr = ptr;
+        cache.generation = generation;
+        return *ptr;
+    }
+
+    static inline std::atomic<T*> published_{nullptr};
+};
+
+template<typename T>
+void SingletonLifecycle::add(int phase, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (initialized_)
+    {
+        throw std::logic_error("SingletonLifecycle::add after initialize()");
+    }
+    entries_.push_back(Entry{phase, name,
+                             []() { Singleton<T>::published_.store(new T(), std::memory_order_release); },
+                             []() { delete Singleton<T>::published_.exchange(nullptr, std::memory_order_acq_rel); }});
+}
+
+class ThreadSafeSingletonTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+
+    void TearDown() override
+    {
+        SingletonLifecycle::instance().clear();
+    }
+};
+
+class LoggerService
+{
+public:
+    LoggerService()
+    : tracked_("Logger")
+    {
+    }
+
+    int level() const
+    {
+        return 2;
+    }
+
+private:
+    Tracked tracked_;
+};
+
+class MetricsService
+{
+public:
+    MetricsService()
+    : tracked_("Metrics")
+    , log_level_(Singleton<LoggerService>::instance().level())
+    {
+    }
+
+    int log_level() const
+    {
+        return log_level_;
+    }
+
+private:
+    Tracked tracked_;
+    int log_level_;
+};
+
+class ConfigService
+{
+public:
+    ConfigService()
+    : tracked_("Config")
+    {
+    }
+
+    long value() const
+    {
+        return 7;
+    }
+
+private:
+    Tracked tracked_;
+};
+
+TEST_F(ThreadSafeSingletonTest, PhasedInitAndReverseTeardown)
+{
+    SingletonLifecycle& lifecycle = SingletonLifecycle::instance();
+    lifecycle.add<MetricsService>(1, "Metrics");
+    lifecycle.add<ConfigService>(1, "Config");
+    lifecycle.add<LoggerService>(0, "Logger");
+
+    lifecycle.initialize();
+    EXPECT_EQ(Singleton<MetricsService>::instance().log_level(), 2);
+
+    lifecycle.shutdown();
+
+    // Q: Metrics reads the Logger in its constructor. Which guarantee makes that safe here, and what
+    //    guarantees does a function-local static give you for the same dependency at program exit?
+    // A:
+    // R:
+
+    std::vector<std::string> events = EventLog::instance().events();
+    std::vector<std::string> lifecycle_events;
+    for (const auto& e : events)
+    {
+        if (e.find("SingletonLifecycle::") != std::string::npos)
+        {
+            lifecycle_events.push_back(e);
+        }
+    }
+    EXPECT_EQ(lifecycle_events, (std::vector<std::string>{
+                                    "SingletonLifecycle::create Logger",
+                                    "SingletonLifecycle::create Metrics",
+                                    "SingletonLifecycle::create Config",
+                                    "SingletonLifecycle::destroy Config",
+                                    "SingletonLifecycle::destroy Metrics",
+                                    "SingletonLifecycle::destroy Logger",
+                                }));
+    EXPECT_EQ(EventLog::instance().count_events("::dtor"), 3u);
+}
+
+TEST_F(ThreadSafeSingletonTest, AccessOutsideLifecycleThrows)
+{
+    SingletonLifecycle& lifecycle = SingletonLifecycle::instance();
+    lifecycle.add<ConfigService>(0, "Config");
+
+    EXPECT_THROW(Singleton<ConfigService>::instance(), std::logic_error);
+
+    lifecycle.initialize();
+    ConfigService* first = &Singleton<ConfigService>::instance();
+    EXPECT_EQ(first->value(), 7);
+
+    lifecycle.shutdown();
+
+    // Q: This thread cached `first` in a thread_local. What stops the next call from returning it?
+    // A:
+    // R:
+
+    EXPECT_FALSE(Singleton<ConfigService>::alive());
+    EXPECT_THROW(Singleton<ConfigService>::instance(), std::logic_error);
+
+    lifecycle.initialize();
+    EXPECT_TRUE(Singleton<ConfigService>::alive());
+    EXPECT_EQ(Singleton<ConfigService>::instance().value(), 7);
+}
+
+TEST_F(ThreadSafeSingletonTest, DependencyOnLaterPhaseFailsInitialization)
+{
+    SingletonLifecycle& lifecycle = SingletonLifecycle::instance();
+    lifecycle.add<MetricsService>(0, "Metrics");
+    lifecycle.add<LoggerService>(1, "Logger");
+
+    EXPECT_THROW(lifecycle.initialize(), std::logic_error);
+    EXPECT_FALSE(Singleton<MetricsService>::alive());
+    EXPECT_FALSE(Singleton<LoggerService>::alive());
+}
+
+TEST_F(ThreadSafeSingletonTest, AllThreadsSeeTheSameInstance)
+{
+    SingletonLifecycle& lifecycle = SingletonLifecycle::instance();
+    lifecycle.add<ConfigService>(0, "Config");
+    lifecycle.initialize();
+
+    std::vector<ConfigService*> seen(8, nullptr);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < seen.size(); ++i)
+    {
+        threads.emplace_back([&seen, i]()
+        {
+            for (int n = 0; n < 1000; ++n)
+            {
+                seen[i] = &Singleton<ConfigService>::instance();
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    for (ConfigService* p : seen)
+    {
+        EXPECT_EQ(p, &Singleton<ConfigService>::instance());
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Baselines for the access-path benchmark
+// ----------------------------------------------------------------------------
+
+class MeyersConfig
+{
+public:
+    static MeyersConfig& instance()
+    {
+        static MeyersConfig config;
+        return config;
+    }
+
+    long value() const
+    {
+        return 7;
+    }
+};
+
+class CallOnceConfig
+{
+public:
+    static CallOnceConfig& instance()
+    {
+        std::call_once(flag_, []() { instance_ = new CallOnceConfig(); });
+        return *instance_;
+    }
+
+    long value() const
+    {
+        return 7;
+    }
+
+private:
+    static inline std::once_flag flag_;
+    static inline CallOnceConfig* instance_ = nullptr;
+};
+
+class DoubleCheckedConfig
+{
+public:
+    static DoubleCheckedConfig& instance()
+    {
+        DoubleCheckedConfig* p = instance_.load(std::memory_order_acquire);
+        if (p == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            p = instance_.load(std::memory_order_relaxed);
+            if (p == nullptr)
+            {
+                p = new DoubleCheckedConfig();
+                instance_.store(p, std::memory_order_release);
+            }
+        }
+        return *p;
+    }
+
+    long value() const
+    {
+        return 7;
+    }
+
+private:
+    static inline std::atomic<DoubleCheckedConfig*> instance_{nullptr};
+    static inline std::mutex mutex_;
+};
+
+// The shape of ThreadSafeSingleton in test_multi_threaded_patterns.cpp: call_once plus a
+// shared_ptr copy (two atomic RMWs on the control block) per access.
+class SharedPtrConfig
+{
+public:
+    static std::shared_ptr<SharedPtrConfig> instance()
+    {
+        std::call_once(flag_, []() { instance_ = std::make_shared<SharedPtrConfig>(); });
+        return instance_;
+    }
+
+    long value() const
+    {
+        return 7;
+    }
+
+private:
+    static inline std::once_flag flag_;
+    static inline std::shared_ptr<SharedPtrConfig> instance_;
+};
+
+template<typename Access>
+double run_singleton_benchmark(int threads, long accesses_per_thread, Access access)
+{
+    std::atomic<long> sink(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&sink, &access, accesses_per_thread]()
+        {
+            long sum = 0;
+            for (long i = 0; i < accesses_per_thread; ++i)
+            {
+                sum += access();
+            }
+            sink += sum;
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(sink.load(), 7 * threads * accesses_per_thread);
+    return ns / (static_cast<double>(threads) * accesses_per_thread);
+}
+
+void run_singleton_benchmarks(int threads, long accesses_per_thread)
+{
+    struct Row
+    {
+        const char* name;
+        double ns;
+    };
+    std::vector<Row> rows = {
+        {"Singleton<T> (tls cache) ",
+         run_singleton_benchmark(threads, accesses_per_thread, []() { return Singleton<ConfigService>::instance().value(); })},
+        {"Meyers static            ",
+         run_singleton_benchmark(threads, accesses_per_thread, []() { return MeyersConfig::instance().value(); })},
+        {"call_once                ",
+         run_singleton_benchmark(threads, accesses_per_thread, []() { return CallOnceConfig::instance().value(); })},
+        {"double-checked locking   ",
+         run_singleton_benchmark(threads, accesses_per_thread, []() { return DoubleCheckedConfig::instance().value(); })},
+        {"call_once + shared_ptr   ",
+         run_singleton_benchmark(threads, accesses_per_thread, []() { return SharedPtrConfig::instance()->value(); })},
+    };
+    for (const Row& row : rows)
+    {
+        std::cout << "[ BENCH    ] threads=" << threads << " " << row.name << " ns/access=" << row.ns << "\n";
+    }
+}
+
+TEST_F(ThreadSafeSingletonTest, AccessPathBenchmark)
+{
+    SingletonLifecycle::instance().add<ConfigService>(0, "Config");
+    SingletonLifecycle::instance().initialize();
+
+    // Q: Meyers, call_once and DCLP all read a shared "initialized" flag with acquire semantics on every
+    //    access. Why is that nearly free on x86 but still more than the thread-local path, and why is the
+    //    shared_ptr row in a different league once several threads run?
+    // A:
+    // R:
+
+    run_singleton_benchmarks(4, 200000);
+}
+
+TEST_F(ThreadSafeSingletonTest, DISABLED_AccessPathBenchmarkThreadSweep)
+{
+    SingletonLifecycle::instance().add<ConfigService>(0, "Config");
+    SingletonLifecycle::instance().initialize();
 
-// TODO: Implement test cases for Meyers singleton
-// TODO: Implement test cases for double-checked locking
-// TODO: Implement test cases for call_once singleton
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= hw; threads *= 2)
+    {
+        run_singleton_benchmarks(static_cast<int>(threads), 50000000);
+    }
+}
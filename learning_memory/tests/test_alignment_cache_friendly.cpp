@@ -2,8 +2,1121 @@
 // Estimated Time: 4 hours
 // Difficulty: Hard
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // TODO: Implement test cases for memory alignment
-// TODO: Implement test cases for cache line optimization
-// TODO: Implement test cases for structure of arrays vs array of structures
+
+class AlignmentCacheFriendlyTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+// ============================================================================
+// False Sharing: cache_padded<T> and Layout Checks
+// ============================================================================
+
+// 64 bytes on x86-64 and most AArch64 cores. Apple M-series use 128-byte lines and
+// Intel's adjacent-line prefetcher pulls pairs of lines, so pass 128 when that matters.
+constexpr std::size_t kCacheLineSize = 64;
+
+// Gives T a cache line (or several) to itself: alignas rounds both the alignment
+// and sizeof up to a multiple of Align, so neighbours in an array never share a line.
+template<typename T, std::size_t Align = kCacheLineSize>
+struct alignas(Align) cache_padded
+{
+    static_assert(Align != 0 && (Align & (Align - 1)) == 0, "cache_padded alignment must be a power of two");
+
+private:
+    template<typename... Args>
+    struct is_self : std::false_type
+    {
+    };
+
+    template<typename Arg>
+    struct is_self<Arg> : std::is_same<std::decay_t<Arg>, cache_padded>
+    {
+    };
+
+public:
+
+    cache_padded()
+    : value()
+    {
+    }
+
+    // Disabled for a single cache_padded argument so copies of a non-const cache_padded
+    // pick the copy constructor instead of trying to build T from the wrapper.
+    template<typename... Args, typename = std::enable_if_t<!is_self<Args...>::value>>
+    explicit cache_padded(Args&&... args)
+    : value(std::forward<Args>(args)...)
+    {
+    }
+
+    T& get()
+    {
+        return value;
+    }
+
+    const T& get() const
+    {
+        return value;
+    }
+
+    T* operator->()
+    {
+        return &value;
+    }
+
+    const T* operator->() const
+    {
+        return &value;
+    }
+
+    T& operator*()
+    {
+        return value;
+    }
+
+    const T& operator*() const
+    {
+        return value;
+    }
+
+    T value;
+};
+
+// True if bytes [a_offset, a_offset + a_size) and [b_offset, b_offset + b_size) of an
+// object with alignment `object_align` can never land on the same cache line.
+// When the object is line-aligned the line index is fixed by the offset; otherwise the
+// base can sit anywhere in a line, so only a gap of at least Line - 1 bytes is safe.
+constexpr bool separate_cache_lines(std::size_t object_align, std::size_t a_offset, std::size_t a_size,
+                                    std::size_t b_offset, std::size_t b_size, std::size_t line = kCacheLineSize)
+{
+    return (a_offset > b_offset) ? separate_cache_lines(object_align, b_offset, b_size, a_offset, a_size, line)
+           : (object_align >= line && object_align % line == 0)
+               ? (a_offset + a_size - 1) / line < b_offset / line
+               : b_offset >= a_offset + a_size && b_offset - (a_offset + a_size) >= line - 1;
+}
+
+// Rejects at compile time a layout where two hot fields written by different threads
+// may share a line:  STATIC_ASSERT_SEPARATE_CACHE_LINES(Stats, hits, misses);
+#define STATIC_ASSERT_SEPARATE_CACHE_LINES(Type, field_a, field_b)                                                    \
+    static_assert(separate_cache_lines(alignof(Type), offsetof(Type, field_a), sizeof(Type::field_a),                 \
+                                       offsetof(Type, field_b), sizeof(Type::field_b)),                               \
+                  #Type "::" #field_a " and " #Type "::" #field_b " may share a cache line")
+
+// RaceConditionDemo keeps its counter next to the mutex that guards it - good, they are
+// always used together. Per-thread statistics written without a lock are the opposite case.
+struct AdjacentWorkerStats
+{
+    std::atomic<long> produced{0};
+    std::atomic<long> consumed{0};
+};
+
+struct PaddedWorkerStats
+{
+    cache_padded<std::atomic<long>> produced{0};
+    cache_padded<std::atomic<long>> consumed{0};
+};
+
+STATIC_ASSERT_SEPARATE_CACHE_LINES(PaddedWorkerStats, produced, consumed);
+static_assert(!separate_cache_lines(alignof(AdjacentWorkerStats), offsetof(AdjacentWorkerStats, produced),
+                                    sizeof(AdjacentWorkerStats::produced), offsetof(AdjacentWorkerStats, consumed),
+                                    sizeof(AdjacentWorkerStats::consumed)),
+              "adjacent atomics are expected to share a line");
+
+TEST_F(AlignmentCacheFriendlyTest, CachePaddedOccupiesWholeLines)
+{
+    static_assert(alignof(cache_padded<char>) == kCacheLineSize, "");
+    static_assert(sizeof(cache_padded<char>) == kCacheLineSize, "");
+    static_assert(sizeof(cache_padded<std::array<char, 65>>) == 2 * kCacheLineSize, "");
+    static_assert(sizeof(cache_padded<int, 128>) == 128, "");
+    static_assert(std::is_constructible<cache_padded<std::pair<int, int>>, int, int>::value, "");
+
+    std::array<cache_padded<std::atomic<int>>, 4> slots;
+
+    // Q: sizeof(cache_padded<char>) is 64 although it holds one byte. Where do the other 63 bytes come
+    //    from, and why does an array of them need no extra padding member?
+    // A:
+    // R:
+
+    for (std::size_t i = 0; i < slots.size(); ++i)
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(&slots[i].get());
+        EXPECT_EQ(address % kCacheLineSize, 0u);
+        if (i > 0)
+        {
+            EXPECT_EQ(address - reinterpret_cast<std::uintptr_t>(&slots[i - 1].get()), kCacheLineSize);
+        }
+    }
+
+    cache_padded<Tracked> padded("Padded");
+    EXPECT_EQ(padded->name(), "Padded");
+    EXPECT_EQ((*padded).id(), padded.get().id());
+
+    cache_padded<Tracked> copy(padded);
+    EXPECT_EQ(copy->name(), "Padded");
+    EXPECT_EQ(EventLog::instance().count_events("::copy_ctor"), 1u);
+}
+
+TEST_F(AlignmentCacheFriendlyTest, SeparateCacheLinesRules)
+{
+    // Line-aligned object: line index follows from the offset.
+    EXPECT_TRUE(separate_cache_lines(64, 0, 8, 64, 8));
+    EXPECT_FALSE(separate_cache_lines(64, 0, 8, 56, 8));
+    EXPECT_FALSE(separate_cache_lines(64, 0, 72, 64, 8));
+    EXPECT_TRUE(separate_cache_lines(64, 128, 8, 0, 8));
+
+    // 8-byte aligned object: the base can sit anywhere in a line.
+    EXPECT_FALSE(separate_cache_lines(8, 0, 8, 64, 8));
+    EXPECT_TRUE(separate_cache_lines(8, 0, 8, 71, 8));
+
+    // Q: Why is [0, 8) and [64, 72) safe for a 64-aligned struct but unsafe for an 8-aligned one?
+    //    Which base address makes them share a line?
+    // A:
+    // R:
+}
+
+struct FalseSharingReport
+{
+    double adjacent_ms;
+    double padded_ms;
+
+    double slowdown() const
+    {
+        return padded_ms > 0.0 ? adjacent_ms / padded_ms : 0.0;
+    }
+};
+
+// Runs `touch(layout, thread_index, iterations)` on `threads` threads against one shared
+// instance of Layout and returns the wall time of the slowest thread's completion.
+template<typename Layout, typename Touch>
+double time_layout_ms(int threads, long iterations, Touch touch)
+{
+    Layout layout;
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            touch(layout, t, iterations);
+        });
+    }
+    while (ready.load() != threads)
+    {
+        std::this_thread::yield();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the same workload against an adjacent and a padded variant of a struct.
+// A slowdown well above 1.0 on a multi-core machine is false sharing; near 1.0 means the
+// fields are not contended (or the threads never ran in parallel).
+template<typename Adjacent, typename Padded, typename Touch>
+FalseSharingReport measure_false_sharing(int threads, long iterations, Touch touch)
+{
+    FalseSharingReport report;
+    report.adjacent_ms = time_layout_ms<Adjacent>(threads, iterations, touch);
+    report.padded_ms = time_layout_ms<Padded>(threads, iterations, touch);
+    return report;
+}
+
+void print_false_sharing(const char* name, int threads, const FalseSharingReport& report)
+{
+    std::cout << "[ BENCH    ] " << name << " threads=" << threads << " adjacent_ms=" << report.adjacent_ms
+              << " padded_ms=" << report.padded_ms << " slowdown=" << report.slowdown() << "x\n";
+}
+
+// Works with both layouts: get_field() unwraps cache_padded and passes plain atomics through.
+inline std::atomic<long>& get_field(std::atomic<long>& field)
+{
+    return field;
+}
+
+inline std::atomic<long>& get_field(cache_padded<std::atomic<long>>& field)
+{
+    return field.get();
+}
+
+struct WorkerStatsTouch
+{
+    template<typename Stats>
+    void operator()(Stats& stats, int thread_index, long iterations) const
+    {
+        std::atomic<long>& field = get_field(thread_index % 2 == 0 ? stats.produced : stats.consumed);
+        for (long i = 0; i < iterations; ++i)
+        {
+            field.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
+
+template<std::size_t N>
+struct AdjacentSlots
+{
+    std::array<std::atomic<long>, N> slots{};
+};
+
+template<std::size_t N>
+struct PaddedSlots
+{
+    std::array<cache_padded<std::atomic<long>>, N> slots{};
+};
+
+struct SlotTouch
+{
+    template<typename Layout>
+    void operator()(Layout& layout, int thread_index, long iterations) const
+    {
+        std::atomic<long>& slot = get_field(layout.slots[thread_index % layout.slots.size()]);
+        for (long i = 0; i < iterations; ++i)
+        {
+            slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+TEST_F(AlignmentCacheFriendlyTest, FalseSharingHarnessComparesLayouts)
+{
+    const int threads = 2;
+    const long iterations = 200000;
+
+    FalseSharingReport stats = measure_false_sharing<AdjacentWorkerStats, PaddedWorkerStats>(
+        threads, iterations, WorkerStatsTouch());
+    print_false_sharing("WorkerStats", threads, stats);
+
+    FalseSharingReport slots = measure_false_sharing<AdjacentSlots<4>, PaddedSlots<4>>(threads, iterations, SlotTouch());
+    print_false_sharing("Slots<4>   ", threads, slots);
+
+    // Q: The two threads never touch the same variable. What does the coherence protocol transfer
+    //    between cores on every write in the adjacent layout?
+    // A:
+    // R:
+
+    // Q: On a single-core machine the slowdown stays near 1.0. Why is that evidence about the
+    //    machine and not about the struct?
+    // A:
+    // R:
+
+    EXPECT_GT(stats.adjacent_ms, 0.0);
+    EXPECT_GT(stats.padded_ms, 0.0);
+    EXPECT_GT(slots.slowdown(), 0.0);
+}
+
+TEST_F(AlignmentCacheFriendlyTest, DISABLED_FalseSharingHarnessThreadSweep)
+{
+    unsigned hw = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned threads = 2; threads <= hw; threads *= 2)
+    {
+        FalseSharingReport stats = measure_false_sharing<AdjacentWorkerStats, PaddedWorkerStats>(
+            static_cast<int>(threads), 50000000, WorkerStatsTouch());
+        print_false_sharing("WorkerStats", static_cast<int>(threads), stats);
+
+        FalseSharingReport slots = measure_false_sharing<AdjacentSlots<8>, PaddedSlots<8>>(
+            static_cast<int>(threads), 50000000, SlotTouch());
+        print_false_sharing("Slots<8>   ", static_cast<int>(threads), slots);
+    }
+}
+
+// ============================================================================
+// Structure of Arrays: soa_vector<Ts...> with Zip Iterators
+// ============================================================================
+
+// One row of a soa_vector seen through references into every column. Assignment writes
+// through (it never rebinds), swap() exchanges the referenced fields, and the conversions
+// produce the row by value - the three things std::sort and friends do with *it.
+template<typename... Ts>
+struct soa_reference : std::tuple<Ts&...>
+{
+    using base = std::tuple<Ts&...>;
+    using value_type = std::tuple<std::remove_const_t<Ts>...>;
+
+    explicit soa_reference(Ts&... fields)
+    : base(fields...)
+    {
+    }
+
+    soa_reference(const soa_reference&) = default;
+
+    soa_reference& operator=(const soa_reference& other)
+    {
+        base::operator=(static_cast<const base&>(other));
+        return *this;
+    }
+
+    soa_reference& operator=(soa_reference&& other)
+    {
+        move_from(other, std::index_sequence_for<Ts...>());
+        return *this;
+    }
+
+    soa_reference& operator=(const value_type& row)
+    {
+        base::operator=(row);
+        return *this;
+    }
+
+    soa_reference& operator=(value_type&& row)
+    {
+        base::operator=(std::move(row));
+        return *this;
+    }
+
+    operator value_type() const&
+    {
+        return value_type(static_cast<const base&>(*this));
+    }
+
+    operator value_type() &&
+    {
+        return std::apply([](Ts&... fields) { return value_type(std::move(fields)...); }, static_cast<base&>(*this));
+    }
+
+    friend void swap(soa_reference a, soa_reference b)
+    {
+        a.swap_with(b, std::index_sequence_for<Ts...>());
+    }
+
+private:
+    template<std::size_t... Is>
+    void move_from(soa_reference& other, std::index_sequence<Is...>)
+    {
+        ((std::get<Is>(*this) = std::move(std::get<Is>(other))), ...);
+    }
+
+    template<std::size_t... Is>
+    void swap_with(soa_reference& other, std::index_sequence<Is...>)
+    {
+        using std::swap;
+        (swap(std::get<Is>(*this), std::get<Is>(other)), ...);
+    }
+};
+
+// Random-access iterator over parallel column arrays. Strictly a proxy iterator (C++17
+// wants reference to be value_type&), which libstdc++'s algorithms accept as long as
+// swap and the conversions above exist.
+template<typename... Ts>
+class zip_iterator
+{
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::tuple<std::remove_const_t<Ts>...>;
+    using reference = soa_reference<Ts...>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+
+    zip_iterator() = default;
+
+    zip_iterator(std::tuple<Ts*...> columns, difference_type index)
+    : columns_(columns)
+    , index_(index)
+    {
+    }
+
+    reference operator*() const
+    {
+        return deref(std::index_sequence_for<Ts...>());
+    }
+
+    reference operator[](difference_type n) const
+    {
+        return *(*this + n);
+    }
+
+    zip_iterator& operator++()
+    {
+        ++index_;
+        return *this;
+    }
+
+    zip_iterator operator++(int)
+    {
+        zip_iterator old = *this;
+        ++index_;
+        return old;
+    }
+
+    zip_iterator& operator--()
+    {
+        --index_;
+        return *this;
+    }
+
+    zip_iterator operator--(int)
+    {
+        zip_iterator old = *this;
+        --index_;
+        return old;
+    }
+
+    zip_iterator& operator+=(difference_type n)
+    {
+        index_ += n;
+        return *this;
+    }
+
+    zip_iterator& operator-=(difference_type n)
+    {
+        index_ -= n;
+        return *this;
+    }
+
+    friend zip_iterator operator+(zip_iterator it, difference_type n)
+    {
+        return it += n;
+    }
+
+    friend zip_iterator operator+(difference_type n, zip_iterator it)
+    {
+        return it += n;
+    }
+
+    friend zip_iterator operator-(zip_iterator it, difference_type n)
+    {
+        return it -= n;
+    }
+
+    friend difference_type operator-(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ - b.index_;
+    }
+
+    friend bool operator==(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ == b.index_;
+    }
+
+    friend bool operator!=(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ != b.index_;
+    }
+
+    friend bool operator<(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ < b.index_;
+    }
+
+    friend bool operator>(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ > b.index_;
+    }
+
+    friend bool operator<=(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ <= b.index_;
+    }
+
+    friend bool operator>=(const zip_iterator& a, const zip_iterator& b)
+    {
+        return a.index_ >= b.index_;
+    }
+
+private:
+    template<std::size_t... Is>
+    reference deref(std::index_sequence<Is...>) const
+    {
+        return reference(std::get<Is>(columns_)[index_]...);
+    }
+
+    std::tuple<Ts*...> columns_{};
+    difference_type index_ = 0;
+};
+
+// A subset of a soa_vector's columns, iterated as narrower rows. Only the chosen arrays
+// are ever touched, which is the point of storing them apart.
+template<typename... Ts>
+class soa_view
+{
+public:
+    using iterator = zip_iterator<Ts...>;
+
+    soa_view(std::tuple<Ts*...> columns, std::size_t size)
+    : columns_(columns)
+    , size_(size)
+    {
+    }
+
+    iterator begin() const
+    {
+        return iterator(columns_, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(columns_, static_cast<std::ptrdiff_t>(size_));
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    typename iterator::reference operator[](std::size_t i) const
+    {
+        return begin()[static_cast<std::ptrdiff_t>(i)];
+    }
+
+    template<std::size_t I>
+    auto* column() const
+    {
+        return std::get<I>(columns_);
+    }
+
+private:
+    std::tuple<Ts*...> columns_;
+    std::size_t size_;
+};
+
+// Every field lives in its own cache-line-aligned array; rows exist only as proxies.
+// Growth moves column by column, so columns must be nothrow move constructible.
+template<typename... Ts>
+class soa_vector
+{
+    static_assert(sizeof...(Ts) > 0, "soa_vector needs at least one column");
+    static_assert((std::is_nothrow_move_constructible<Ts>::value && ...),
+                  "soa_vector columns must be nothrow move constructible");
+
+public:
+    static constexpr std::size_t kColumnAlign = kCacheLineSize;
+
+    using value_type = std::tuple<Ts...>;
+    using reference = soa_reference<Ts...>;
+    using const_reference = soa_reference<const Ts...>;
+    using iterator = zip_iterator<Ts...>;
+    using const_iterator = zip_iterator<const Ts...>;
+
+    template<std::size_t I>
+    using column_type = std::tuple_element_t<I, value_type>;
+
+    soa_vector() = default;
+
+    // No destructor runs for a half-built object: copy_columns() destroys the rows it
+    // built, and the columns are freed here before rethrowing.
+    soa_vector(const soa_vector& other)
+    {
+        reserve(other.size_);
+        try
+        {
+            copy_columns(other, std::index_sequence_for<Ts...>());
+        }
+        catch (...)
+        {
+            deallocate(columns_, std::index_sequence_for<Ts...>());
+            throw;
+        }
+        size_ = other.size_;
+    }
+
+    soa_vector(soa_vector&& other) noexcept
+    : columns_(std::exchange(other.columns_, std::tuple<Ts*...>()))
+    , size_(std::exchange(other.size_, 0))
+    , capacity_(std::exchange(other.capacity_, 0))
+    {
+    }
+
+    soa_vector& operator=(soa_vector other) noexcept
+    {
+        std::swap(columns_, other.columns_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+        return *this;
+    }
+
+    ~soa_vector()
+    {
+        clear();
+        deallocate(columns_, std::index_sequence_for<Ts...>());
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    void reserve(std::size_t new_capacity)
+    {
+        if (new_capacity <= capacity_)
+        {
+            return;
+        }
+        std::tuple<Ts*...> grown = allocate(new_capacity, std::index_sequence_for<Ts...>());
+        relocate_into(grown, std::index_sequence_for<Ts...>());
+        deallocate(columns_, std::index_sequence_for<Ts...>());
+        columns_ = grown;
+        capacity_ = new_capacity;
+    }
+
+    // Arguments are taken by value so that any throwing copy happens before storage is touched.
+    void push_back(Ts... fields)
+    {
+        if (size_ == capacity_)
+        {
+            reserve(capacity_ == 0 ? 16 : capacity_ * 2);
+        }
+        construct_row(size_, std::index_sequence_for<Ts...>(), std::move(fields)...);
+        ++size_;
+    }
+
+    void pop_back()
+    {
+        --size_;
+        destroy_rows(size_, size_ + 1, std::index_sequence_for<Ts...>());
+    }
+
+    void clear()
+    {
+        destroy_rows(0, size_, std::index_sequence_for<Ts...>());
+        size_ = 0;
+    }
+
+    reference operator[](std::size_t i)
+    {
+        return begin()[static_cast<std::ptrdiff_t>(i)];
+    }
+
+    const_reference operator[](std::size_t i) const
+    {
+        return begin()[static_cast<std::ptrdiff_t>(i)];
+    }
+
+    iterator begin()
+    {
+        return iterator(columns_, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(columns_, static_cast<std::ptrdiff_t>(size_));
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(const_columns(std::index_sequence_for<Ts...>()), 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(const_columns(std::index_sequence_for<Ts...>()), static_cast<std::ptrdiff_t>(size_));
+    }
+
+    template<std::size_t I>
+    column_type<I>* column()
+    {
+        return std::get<I>(columns_);
+    }
+
+    template<std::size_t I>
+    const column_type<I>* column() const
+    {
+        return std::get<I>(columns_);
+    }
+
+    template<std::size_t... Is>
+    soa_view<column_type<Is>...> columns()
+    {
+        return soa_view<column_type<Is>...>(std::make_tuple(column<Is>()...), size_);
+    }
+
+    template<std::size_t... Is>
+    soa_view<const column_type<Is>...> columns() const
+    {
+        return soa_view<const column_type<Is>...>(std::make_tuple(column<Is>()...), size_);
+    }
+
+private:
+    template<typename T>
+    static T* allocate_column(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kColumnAlign)));
+    }
+
+    template<std::size_t... Is>
+    static std::tuple<Ts*...> allocate(std::size_t n, std::index_sequence<Is...>)
+    {
+        std::tuple<Ts*...> result;
+        try
+        {
+            ((std::get<Is>(result) = allocate_column<Ts>(n)), ...);
+        }
+        catch (...)
+        {
+            deallocate(result, std::index_sequence<Is...>());
+            throw;
+        }
+        return result;
+    }
+
+    template<std::size_t... Is>
+    static void deallocate(std::tuple<Ts*...>& columns, std::index_sequence<Is...>)
+    {
+        ((::operator delete(std::get<Is>(columns), std::align_val_t(kColumnAlign)), std::get<Is>(columns) = nullptr),
+         ...);
+    }
+
+    template<std::size_t... Is>
+    void relocate_into(std::tuple<Ts*...>& target, std::index_sequence<Is...>)
+    {
+        ((std::uninitialized_move_n(std::get<Is>(columns_), size_, std::get<Is>(target)),
+          std::destroy_n(std::get<Is>(columns_), size_)),
+         ...);
+    }
+
+    template<std::size_t... Is>
+    void copy_columns(const soa_vector& other, std::index_sequence<Is...>)
+    {
+        std::size_t copied = 0;
+        try
+        {
+            ((std::uninitialized_copy_n(other.column<Is>(), other.size_, column<Is>()), ++copied), ...);
+        }
+        catch (...)
+        {
+            ((Is < copied ? static_cast<void>(std::destroy_n(column<Is>(), other.size_)) : void()), ...);
+            throw;
+        }
+    }
+
+    template<std::size_t... Is>
+    void construct_row(std::size_t row, std::index_sequence<Is...>, Ts&&... fields)
+    {
+        (::new (static_cast<void*>(std::get<Is>(columns_) + row)) Ts(std::move(fields)), ...);
+    }
+
+    template<std::size_t... Is>
+    void destroy_rows(std::size_t from, std::size_t to, std::index_sequence<Is...>)
+    {
+        (std::destroy(std::get<Is>(columns_) + from, std::get<Is>(columns_) + to), ...);
+    }
+
+    template<std::size_t... Is>
+    std::tuple<const Ts*...> const_columns(std::index_sequence<Is...>) const
+    {
+        return std::tuple<const Ts*...>(std::get<Is>(columns_)...);
+    }
+
+    std::tuple<Ts*...> columns_{};
+    std::size_t size_ = 0;
+    std::size_t capacity_ = 0;
+};
+
+TEST_F(AlignmentCacheFriendlyTest, SoaVectorStoresColumnsApart)
+{
+    soa_vector<int, double, char> rows;
+    for (int i = 0; i < 100; ++i)
+    {
+        rows.push_back(i, i * 0.5, static_cast<char>('a' + i % 26));
+    }
+
+    ASSERT_EQ(rows.size(), 100u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(rows.column<0>()) % kCacheLineSize, 0u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(rows.column<1>()) % kCacheLineSize, 0u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(rows.column<2>()) % kCacheLineSize, 0u);
+    EXPECT_EQ(rows.column<1>()[10], 5.0);
+
+    std::get<1>(rows[3]) = 42.0;
+    EXPECT_EQ(rows.column<1>()[3], 42.0);
+
+    std::tuple<int, double, char> row = rows[27];
+    EXPECT_EQ(row, std::make_tuple(27, 13.5, 'b'));
+
+    rows[0] = std::make_tuple(-1, -1.0, 'z');
+    EXPECT_EQ(rows.column<0>()[0], -1);
+    EXPECT_EQ(rows.column<2>()[0], 'z');
+
+    // Q: rows[3] returns a temporary, yet writing through it changes the container. What does the
+    //    temporary hold, and why would `auto r = rows[3]; std::get<1>(r) = 0;` also write through?
+    // A:
+    // R:
+}
+
+TEST_F(AlignmentCacheFriendlyTest, SoaVectorZipIteratorsWorkWithAlgorithms)
+{
+    soa_vector<int, std::string> rows;
+    std::mt19937 rng(4);
+    for (int i = 0; i < 500; ++i)
+    {
+        int key = static_cast<int>(rng() % 1000);
+        rows.push_back(key, "row" + std::to_string(key));
+    }
+
+    std::sort(rows.begin(), rows.end(),
+              [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+
+    EXPECT_TRUE(std::is_sorted(rows.column<0>(), rows.column<0>() + rows.size()));
+    for (std::size_t i = 0; i < rows.size(); ++i)
+    {
+        ASSERT_EQ(rows.column<1>()[i], "row" + std::to_string(rows.column<0>()[i]));
+    }
+
+    auto found = std::find_if(rows.begin(), rows.end(), [](const auto& r) { return std::get<0>(r) >= 500; });
+    ASSERT_NE(found, rows.end());
+    EXPECT_GE(std::get<0>(*found), 500);
+
+    const soa_vector<int, std::string>& view = rows;
+    long evens = std::count_if(view.begin(), view.end(), [](const auto& r) { return std::get<0>(r) % 2 == 0; });
+    EXPECT_EQ(evens, std::count_if(rows.column<0>(), rows.column<0>() + rows.size(), [](int k) { return k % 2 == 0; }));
+}
+
+TEST_F(AlignmentCacheFriendlyTest, SoaVectorColumnSubsetViews)
+{
+    soa_vector<float, float, float, int> particles;
+    for (int i = 0; i < 64; ++i)
+    {
+        particles.push_back(static_cast<float>(i), 0.0f, 1.0f, i);
+    }
+
+    // Integrate x += vz touching only two of the four arrays.
+    auto motion = particles.columns<0, 2>();
+    for (auto p : motion)
+    {
+        std::get<0>(p) += std::get<1>(p);
+    }
+    EXPECT_EQ(particles.column<0>()[10], 11.0f);
+
+    const auto& frozen = particles;
+    auto ids = frozen.columns<3>();
+    int sum = std::accumulate(ids.begin(), ids.end(), 0, [](int acc, const auto& r) { return acc + std::get<0>(r); });
+    EXPECT_EQ(sum, 63 * 64 / 2);
+}
+
+TEST_F(AlignmentCacheFriendlyTest, SoaVectorGrowthMovesEveryColumn)
+{
+    {
+        soa_vector<int, Tracked> rows;
+        rows.push_back(1, Tracked("A"));
+        rows.push_back(2, Tracked("B"));
+        EventLog::instance().clear();
+
+        rows.reserve(1000);
+        EXPECT_EQ(rows.capacity(), 1000u);
+        EXPECT_EQ(std::get<1>(rows[1]).name(), "B");
+        EXPECT_EQ(EventLog::instance().count_events("::move_ctor"), 2u);
+
+        soa_vector<int, Tracked> copy = rows;
+        EXPECT_EQ(copy.size(), 2u);
+        EXPECT_EQ(EventLog::instance().count_events("::copy_ctor"), 2u);
+        EventLog::instance().clear();
+    }
+    EXPECT_EQ(EventLog::instance().count_events("::dtor"), 4u);
+}
+
+// Copying throws once `copies_left` reaches zero; `live` counts constructed instances.
+struct FlakyCopy
+{
+    static int live;
+    static int copies_left;
+
+    FlakyCopy()
+    {
+        ++live;
+    }
+
+    FlakyCopy(const FlakyCopy&)
+    {
+        if (copies_left-- == 0)
+        {
+            throw std::runtime_error("FlakyCopy");
+        }
+        ++live;
+    }
+
+    FlakyCopy(FlakyCopy&&) noexcept
+    {
+        ++live;
+    }
+
+    ~FlakyCopy()
+    {
+        --live;
+    }
+};
+
+int FlakyCopy::live = 0;
+int FlakyCopy::copies_left = 0;
+
+TEST_F(AlignmentCacheFriendlyTest, SoaVectorCopyRollsBackWhenARowThrows)
+{
+    {
+        soa_vector<Tracked, FlakyCopy> rows;
+        for (int i = 0; i < 8; ++i)
+        {
+            rows.push_back(Tracked("Row"), FlakyCopy());
+        }
+        ASSERT_EQ(FlakyCopy::live, 8);
+        EventLog::instance().clear();
+
+        FlakyCopy::copies_left = 5;
+        EXPECT_THROW((soa_vector<Tracked, FlakyCopy>(rows)), std::runtime_error);
+
+        // The Tracked column was copied in full, the FlakyCopy column up to the throw;
+        // every one of those rows has been destroyed again.
+        EXPECT_EQ(EventLog::instance().count_events("::copy_ctor"), 8u);
+        EXPECT_EQ(EventLog::instance().count_events("::dtor"), 8u);
+        EXPECT_EQ(FlakyCopy::live, 8);
+        EXPECT_EQ(rows.size(), 8u);
+    }
+    EXPECT_EQ(FlakyCopy::live, 0);
+}
+
+// Eight doubles per row: one row per cache line.
+struct BodyAos
+{
+    double px;
+    double py;
+    double pz;
+    double vx;
+    double vy;
+    double vz;
+    double mass;
+    double charge;
+};
+
+static_assert(sizeof(BodyAos) == kCacheLineSize, "BodyAos is meant to fill exactly one line");
+
+using BodySoa = soa_vector<double, double, double, double, double, double, double, double>;
+
+struct LayoutScanReport
+{
+    double aos_ms;
+    double soa_ms;
+    double soa_view_ms;
+};
+
+LayoutScanReport measure_single_field_scan(std::size_t rows, int repetitions)
+{
+    std::vector<BodyAos> aos(rows);
+    BodySoa soa;
+    soa.reserve(rows);
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        double m = static_cast<double>(i % 100);
+        aos[i] = BodyAos{0, 0, 0, 0, 0, 0, m, 1};
+        soa.push_back(0, 0, 0, 0, 0, 0, m, 1);
+    }
+
+    auto time = [repetitions](auto scan)
+    {
+        double total = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; ++r)
+        {
+            total += scan();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_GT(total, 0.0);
+        return ms / repetitions;
+    };
+
+    LayoutScanReport report;
+    report.aos_ms = time([&aos]()
+    {
+        double sum = 0.0;
+        for (const BodyAos& b : aos)
+        {
+            sum += b.mass;
+        }
+        return sum;
+    });
+    report.soa_ms = time([&soa]()
+    {
+        const double* mass = soa.column<6>();
+        double sum = 0.0;
+        for (std::size_t i = 0; i < soa.size(); ++i)
+        {
+            sum += mass[i];
+        }
+        return sum;
+    });
+    report.soa_view_ms = time([&soa]()
+    {
+        auto mass = soa.columns<6>();
+        return std::accumulate(mass.begin(), mass.end(), 0.0,
+                               [](double acc, const auto& r) { return acc + std::get<0>(r); });
+    });
+    return report;
+}
+
+void print_layout_scan(std::size_t rows, const LayoutScanReport& report)
+{
+    std::cout << "[ BENCH    ] rows=" << rows << " scan 1 of 8 fields: aos_ms=" << report.aos_ms
+              << " soa_ms=" << report.soa_ms << " soa_view_ms=" << report.soa_view_ms
+              << " aos/soa=" << (report.soa_ms > 0.0 ? report.aos_ms / report.soa_ms : 0.0) << "x\n";
+}
+
+TEST_F(AlignmentCacheFriendlyTest, SingleFieldScanAosVsSoa)
+{
+    const std::size_t rows = std::size_t(1) << 17;
+    LayoutScanReport report = measure_single_field_scan(rows, 4);
+    print_layout_scan(rows, report);
+
+    // Q: The AoS loop reads 8 bytes out of every 64-byte line it pulls in. Once the array no longer
+    //    fits in cache, how much of the memory bandwidth is wasted, and why does the gap shrink for
+    //    arrays that fit in L1?
+    // A:
+    // R:
+
+    // Q: soa_view_ms goes through zip_iterator and soa_reference. What must the optimizer remove for
+    //    it to match soa_ms, and what does it look like in an unoptimized build?
+    // A:
+    // R:
+
+    EXPECT_GT(report.aos_ms, 0.0);
+    EXPECT_GT(report.soa_ms, 0.0);
+}
+
+TEST_F(AlignmentCacheFriendlyTest, DISABLED_SingleFieldScanAosVsSoaSweep)
+{
+    for (std::size_t rows = std::size_t(1) << 10; rows <= (std::size_t(1) << 24); rows <<= 2)
+    {
+        print_layout_scan(rows, measure_single_field_scan(rows, 8));
+    }
+}
@@ -2,9 +2,896 @@
 // Estimated Time: 4 hours
 // Difficulty: Hard
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // TODO: Implement test cases for std::allocator interface
-// TODO: Implement test cases for custom allocators
 // TODO: Implement test cases for allocator traits
+
+class CustomAllocatorsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// counting_resource: Every Upstream Call in EventLog
+// ============================================================================
+
+// Forwards to `upstream` and records each call as
+// "CountingResource(name)::allocate bytes=N align=A" or "...::deallocate ...".
+// EventLog is not thread-safe, so wrap a resource that one thread uses at a time.
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    explicit counting_resource(std::string name, std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : name_(std::move(name))
+    , upstream_(upstream)
+    {
+    }
+
+    std::size_t allocations() const
+    {
+        return allocations_;
+    }
+
+    std::size_t deallocations() const
+    {
+        return deallocations_;
+    }
+
+    std::size_t bytes_in_use() const
+    {
+        return bytes_in_use_;
+    }
+
+    std::size_t peak_bytes() const
+    {
+        return peak_bytes_;
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        void* p = upstream_->allocate(bytes, alignment);
+        ++allocations_;
+        bytes_in_use_ += bytes;
+        peak_bytes_ = std::max(peak_bytes_, bytes_in_use_);
+        record("allocate", bytes, alignment);
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        upstream_->deallocate(p, bytes, alignment);
+        ++deallocations_;
+        bytes_in_use_ -= bytes;
+        record("deallocate", bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void record(const char* op, std::size_t bytes, std::size_t alignment) const
+    {
+        std::ostringstream oss;
+        oss << "CountingResource(" << name_ << ")::" << op << " bytes=" << bytes << " align=" << alignment;
+        EventLog::instance().record(oss.str());
+    }
+
+    std::string name_;
+    std::pmr::memory_resource* upstream_;
+    std::size_t allocations_ = 0;
+    std::size_t deallocations_ = 0;
+    std::size_t bytes_in_use_ = 0;
+    std::size_t peak_bytes_ = 0;
+};
+
+// ============================================================================
+// monotonic_arena: Bump Allocation with a Growth Policy
+// ============================================================================
+
+// Chunk sizes after the initial buffer: `initial_bytes`, then multiplied by `factor` up to
+// `max_bytes`. A request larger than the current chunk gets a chunk of its own size.
+struct growth_policy
+{
+    std::size_t initial_bytes = 1024;
+    std::size_t factor = 2;
+    std::size_t max_bytes = 64 * 1024;
+
+    std::size_t next(std::size_t current) const
+    {
+        return std::min(max_bytes, current * factor);
+    }
+};
+
+// deallocate() is a no-op; memory comes back all at once from release() or the destructor.
+// An optional caller buffer (typically on the stack) is used before the upstream is asked.
+class monotonic_arena : public std::pmr::memory_resource
+{
+public:
+    explicit monotonic_arena(growth_policy policy = growth_policy(),
+                             std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : monotonic_arena(nullptr, 0, policy, upstream)
+    {
+    }
+
+    monotonic_arena(void* buffer, std::size_t size, growth_policy policy = growth_policy(),
+                    std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : policy_(policy)
+    , upstream_(upstream)
+    , buffer_(static_cast<char*>(buffer))
+    , buffer_size_(size)
+    {
+        rewind();
+    }
+
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+    ~monotonic_arena() override
+    {
+        release();
+    }
+
+    // Returns every upstream chunk and starts over from the caller's buffer.
+    void release()
+    {
+        while (chunks_ != nullptr)
+        {
+            chunk_header* prev = chunks_->prev;
+            upstream_->deallocate(chunks_, chunks_->bytes, alignof(std::max_align_t));
+            chunks_ = prev;
+        }
+        chunk_count_ = 0;
+        rewind();
+    }
+
+    std::size_t chunk_count() const
+    {
+        return chunk_count_;
+    }
+
+private:
+    struct alignas(std::max_align_t) chunk_header
+    {
+        chunk_header* prev;
+        std::size_t bytes;
+    };
+
+    void rewind()
+    {
+        cursor_ = buffer_;
+        end_ = buffer_ + buffer_size_;
+        next_chunk_ = policy_.initial_bytes;
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (void* p = bump(bytes, alignment))
+        {
+            return p;
+        }
+        grow(bytes, alignment);
+        return bump(bytes, alignment);
+    }
+
+    void do_deallocate(void*, std::size_t, std::size_t) override
+    {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void* bump(std::size_t bytes, std::size_t alignment)
+    {
+        void* p = cursor_;
+        std::size_t space = static_cast<std::size_t>(end_ - cursor_);
+        if (cursor_ == nullptr || std::align(alignment, bytes, p, space) == nullptr)
+        {
+            return nullptr;
+        }
+        cursor_ = static_cast<char*>(p) + bytes;
+        return p;
+    }
+
+    void grow(std::size_t bytes, std::size_t alignment)
+    {
+        std::size_t needed = sizeof(chunk_header) + bytes + alignment;
+        std::size_t size = std::max(next_chunk_, needed);
+        next_chunk_ = policy_.next(next_chunk_);
+
+        chunk_header* chunk = static_cast<chunk_header*>(upstream_->allocate(size, alignof(std::max_align_t)));
+        chunk->prev = chunks_;
+        chunk->bytes = size;
+        chunks_ = chunk;
+        ++chunk_count_;
+        cursor_ = reinterpret_cast<char*>(chunk + 1);
+        end_ = reinterpret_cast<char*>(chunk) + size;
+    }
+
+    growth_policy policy_;
+    std::pmr::memory_resource* upstream_;
+    char* buffer_;
+    std::size_t buffer_size_;
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+    std::size_t next_chunk_ = 0;
+    chunk_header* chunks_ = nullptr;
+    std::size_t chunk_count_ = 0;
+};
+
+// ============================================================================
+// unsynchronized_bucket_pool: Power-of-Two Buckets over Upstream Chunks
+// ============================================================================
+
+// Requests up to kMaxBucket bytes (and no more than max_align_t alignment) are rounded to
+// a power of two no smaller than their alignment and served from that bucket's free list;
+// chunks grow from 16 to 256 blocks. Each chunk is aligned to a power of two covering the
+// bucket's largest chunk, so owner_of() finds the pool behind a block without a search.
+// Anything else goes to the upstream. Like std::pmr::unsynchronized_pool_resource, it
+// expects one thread at a time.
+class unsynchronized_bucket_pool : public std::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t kMinBucket = 8;
+    static constexpr std::size_t kMaxBucket = 4096;
+    static constexpr std::size_t kBuckets = 10;
+
+    explicit unsynchronized_bucket_pool(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : upstream_(upstream)
+    {
+    }
+
+    unsynchronized_bucket_pool(const unsynchronized_bucket_pool&) = delete;
+    unsynchronized_bucket_pool& operator=(const unsynchronized_bucket_pool&) = delete;
+
+    ~unsynchronized_bucket_pool() override
+    {
+        release();
+    }
+
+    // Returns every chunk, including blocks that were never deallocated.
+    void release()
+    {
+        while (chunks_ != nullptr)
+        {
+            chunk_header* prev = chunks_->prev;
+            upstream_->deallocate(chunks_, chunks_->bytes, chunks_->alignment);
+            chunks_ = prev;
+        }
+        buckets_ = std::array<bucket, kBuckets>();
+    }
+
+    std::size_t oversize_allocations() const
+    {
+        return oversize_;
+    }
+
+    // The pool whose chunk holds a block of this size, or nullptr for oversize blocks, which
+    // come straight from upstream. Every chunk of a bucket starts at a multiple of that
+    // bucket's chunk_alignment() and is never longer, so masking the address finds its header.
+    static const unsynchronized_bucket_pool* owner_of(const void* p, std::size_t bytes, std::size_t alignment)
+    {
+        if (oversize(bytes, alignment))
+        {
+            return nullptr;
+        }
+        std::uintptr_t mask = chunk_alignment(bucket_of(std::max(bytes, alignment))) - 1;
+        const chunk_header* chunk = reinterpret_cast<const chunk_header*>(reinterpret_cast<std::uintptr_t>(p) & ~mask);
+        return chunk->owner;
+    }
+
+    // True if p points anywhere into one of this pool's chunks. Chunks stop growing at
+    // kMaxChunkBlocks, so this walk is linear in live memory; use owner_of() when the
+    // block's size is known.
+    bool owns(const void* p) const
+    {
+        const char* address = static_cast<const char*>(p);
+        for (const chunk_header* chunk = chunks_; chunk != nullptr; chunk = chunk->prev)
+        {
+            const char* first = reinterpret_cast<const char*>(chunk + 1);
+            const char* last = reinterpret_cast<const char*>(chunk) + chunk->bytes;
+            if (std::less_equal<const char*>()(first, address) && std::less<const char*>()(address, last))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static std::size_t bucket_of(std::size_t bytes)
+    {
+        std::size_t index = 0;
+        for (std::size_t size = kMinBucket; size < bytes; size *= 2)
+        {
+            ++index;
+        }
+        return index;
+    }
+
+private:
+    struct free_node
+    {
+        free_node* next;
+    };
+
+    struct alignas(std::max_align_t) chunk_header
+    {
+        chunk_header* prev;
+        const unsynchronized_bucket_pool* owner;
+        std::size_t bytes;
+        std::size_t alignment;
+    };
+
+    static constexpr std::size_t kMaxChunkBlocks = 256;
+
+    // A power of two at least as large as the bucket's biggest chunk.
+    static std::size_t chunk_alignment(std::size_t index)
+    {
+        std::size_t largest = sizeof(chunk_header) + kMaxChunkBlocks * (kMinBucket << index);
+        std::size_t alignment = alignof(std::max_align_t);
+        while (alignment < largest)
+        {
+            alignment *= 2;
+        }
+        return alignment;
+    }
+
+    struct bucket
+    {
+        free_node* free = nullptr;
+        std::size_t next_chunk_blocks = 16;
+    };
+
+    static bool oversize(std::size_t bytes, std::size_t alignment)
+    {
+        return bytes > kMaxBucket || alignment > alignof(std::max_align_t);
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (oversize(bytes, alignment))
+        {
+            ++oversize_;
+            return upstream_->allocate(bytes, alignment);
+        }
+        // A power-of-two block at a multiple of its size inside a max_align_t-aligned chunk
+        // is aligned to min(block, max_align_t), so sizing by alignment too is enough.
+        std::size_t index = bucket_of(std::max(bytes, alignment));
+        bucket& b = buckets_[index];
+        if (b.free == nullptr)
+        {
+            refill(b, index);
+        }
+        free_node* node = b.free;
+        b.free = node->next;
+        return node;
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        if (oversize(bytes, alignment))
+        {
+            upstream_->deallocate(p, bytes, alignment);
+            return;
+        }
+        bucket& b = buckets_[bucket_of(std::max(bytes, alignment))];
+        free_node* node = static_cast<free_node*>(p);
+        node->next = b.free;
+        b.free = node;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void refill(bucket& b, std::size_t index)
+    {
+        std::size_t block_size = kMinBucket << index;
+        std::size_t blocks = b.next_chunk_blocks;
+        std::size_t bytes = sizeof(chunk_header) + blocks * block_size;
+        std::size_t alignment = chunk_alignment(index);
+        chunk_header* chunk = static_cast<chunk_header*>(upstream_->allocate(bytes, alignment));
+        chunk->prev = chunks_;
+        chunk->owner = this;
+        chunk->bytes = bytes;
+        chunk->alignment = alignment;
+        chunks_ = chunk;
+
+        char* first = reinterpret_cast<char*>(chunk + 1);
+        for (std::size_t i = blocks; i-- > 0;)
+        {
+            free_node* node = reinterpret_cast<free_node*>(first + i * block_size);
+            node->next = b.free;
+            b.free = node;
+        }
+        b.next_chunk_blocks = std::min<std::size_t>(blocks * 2, kMaxChunkBlocks);
+    }
+
+    std::pmr::memory_resource* upstream_;
+    std::array<bucket, kBuckets> buckets_;
+    chunk_header* chunks_ = nullptr;
+    std::size_t oversize_ = 0;
+};
+
+// ============================================================================
+// sharded_pool: A Synchronized Pool with Per-Thread Shards
+// ============================================================================
+
+// A handful of unsynchronized_bucket_pools, each behind its own mutex on its own cache
+// line. Threads are dealt shards round-robin on first use, so with shards >= threads no two
+// threads ever contend. A block freed on another thread goes back to the shard that owns its
+// chunk, so the owner reuses it and shards don't drift apart under producer/consumer traffic.
+// The owner comes from the chunk header in O(1), and only a cross-thread free touches
+// another shard's mutex. Oversize blocks belong to no
+// shard and go straight back upstream, which must therefore be thread-safe.
+class sharded_pool : public std::pmr::memory_resource
+{
+public:
+    explicit sharded_pool(std::size_t shards = std::max(1u, std::thread::hardware_concurrency()),
+                          std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    {
+        for (std::size_t i = 0; i < shards; ++i)
+        {
+            shards_.push_back(std::make_unique<shard>(upstream));
+        }
+    }
+
+    std::size_t shard_count() const
+    {
+        return shards_.size();
+    }
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Index of the shard whose chunks hold p (any address inside a block), or npos for
+    // oversize and foreign blocks. Walks every shard's chunk list: meant for tests and
+    // diagnostics, not for the deallocation path.
+    std::size_t shard_of(const void* p) const
+    {
+        for (std::size_t i = 0; i < shards_.size(); ++i)
+        {
+            std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+            if (shards_[i]->pool.owns(p))
+            {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+private:
+    struct alignas(64) shard
+    {
+        explicit shard(std::pmr::memory_resource* upstream)
+        : pool(upstream)
+        {
+        }
+
+        mutable std::mutex mutex;
+        unsynchronized_bucket_pool pool;
+    };
+
+    static std::size_t thread_ticket()
+    {
+        static std::atomic<std::size_t> next{0};
+        thread_local std::size_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+        return ticket;
+    }
+
+    shard& local_shard()
+    {
+        return *shards_[thread_ticket() % shards_.size()];
+    }
+
+    // One pointer compare per shard, independent of how much memory is live.
+    shard& shard_owning(const unsynchronized_bucket_pool* owner, shard& local)
+    {
+        if (&local.pool == owner)
+        {
+            return local;
+        }
+        for (const std::unique_ptr<shard>& s : shards_)
+        {
+            if (&s->pool == owner)
+            {
+                return *s;
+            }
+        }
+        return local;
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        shard& s = local_shard();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.pool.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        // The chunk header names the owning pool; an oversize block has none, and any
+        // shard's pool hands it straight back upstream.
+        shard& local = local_shard();
+        const unsynchronized_bucket_pool* owner = unsynchronized_bucket_pool::owner_of(p, bytes, alignment);
+        shard& s = owner == nullptr ? local : shard_owning(owner, local);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.pool.deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::vector<std::unique_ptr<shard>> shards_;
+};
+
+TEST_F(CustomAllocatorsTest, MonotonicArenaGrowsByPolicyAndReleasesAtOnce)
+{
+    counting_resource upstream("Upstream");
+    growth_policy policy;
+    policy.initial_bytes = 1024;
+    policy.factor = 2;
+    policy.max_bytes = 4096;
+
+    {
+        std::array<std::byte, 512> buffer;
+        monotonic_arena arena(buffer.data(), buffer.size(), policy, &upstream);
+
+        void* first = arena.allocate(100, 8);
+        EXPECT_GE(static_cast<std::byte*>(first), buffer.data());
+        EXPECT_LT(static_cast<std::byte*>(first), buffer.data() + buffer.size());
+        EXPECT_EQ(upstream.allocations(), 0u);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            void* p = arena.allocate(64, 16);
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % 16, 0u);
+            arena.deallocate(p, 64, 16);
+        }
+        EXPECT_EQ(upstream.deallocations(), 0u);
+        EXPECT_EQ(EventLog::instance().count_events("CountingResource(Upstream)::allocate bytes=1024"), 1u);
+        EXPECT_EQ(EventLog::instance().count_events("CountingResource(Upstream)::allocate bytes=2048"), 1u);
+        EXPECT_GE(EventLog::instance().count_events("CountingResource(Upstream)::allocate bytes=4096"), 1u);
+
+        // Larger than any policy chunk: it gets a chunk of its own.
+        EXPECT_NE(arena.allocate(10000, 8), nullptr);
+        EXPECT_GE(upstream.bytes_in_use(), 10000u);
+
+        std::size_t chunks = arena.chunk_count();
+        arena.release();
+        EXPECT_EQ(upstream.deallocations(), chunks);
+        EXPECT_EQ(upstream.bytes_in_use(), 0u);
+
+        // After release() the caller's buffer serves requests again.
+        void* again = arena.allocate(100, 8);
+        EXPECT_EQ(again, first);
+    }
+    EXPECT_EQ(upstream.bytes_in_use(), 0u);
+
+    // Q: monotonic_arena::deallocate does nothing. Which containers make that a memory
+    //    leak for the lifetime of the arena, and which make it free?
+    // A:
+    // R:
+}
+
+TEST_F(CustomAllocatorsTest, BucketPoolReusesBlocksAndPassesLargeRequestsThrough)
+{
+    counting_resource upstream("Upstream");
+    unsynchronized_bucket_pool pool(&upstream);
+
+    void* a = pool.allocate(100, 8);
+    EXPECT_EQ(upstream.allocations(), 1u);
+    pool.deallocate(a, 100, 8);
+    EXPECT_EQ(pool.allocate(80, 8), a);
+
+    // The first chunk of a bucket holds 16 blocks; the 17th request asks for 32 more.
+    std::vector<void*> blocks;
+    for (int i = 0; i < 16; ++i)
+    {
+        blocks.push_back(pool.allocate(32, 8));
+    }
+    EXPECT_EQ(upstream.allocations(), 2u);
+    blocks.push_back(pool.allocate(32, 8));
+    EXPECT_EQ(upstream.allocations(), 3u);
+    EXPECT_EQ(EventLog::instance().count_events("CountingResource(Upstream)::allocate bytes=" +
+                                                std::to_string(32 + 32 * 32)),
+              1u);
+
+    // An 8-byte request with 16-byte alignment comes from the 16-byte bucket.
+    void* small = pool.allocate(8, 8);
+    void* aligned = pool.allocate(8, 16);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 16, 0u);
+    pool.deallocate(aligned, 8, 16);
+    EXPECT_EQ(pool.allocate(16, 8), aligned);
+    pool.deallocate(small, 8, 8);
+
+    void* big = pool.allocate(10000, 8);
+    EXPECT_EQ(pool.oversize_allocations(), 1u);
+    EXPECT_EQ(EventLog::instance().count_events("CountingResource(Upstream)::allocate bytes=10000"), 1u);
+    pool.deallocate(big, 10000, 8);
+
+    pool.release();
+    EXPECT_EQ(upstream.bytes_in_use(), 0u);
+}
+
+TEST_F(CustomAllocatorsTest, SharedPtrScenariosWithPolymorphicAllocator)
+{
+    counting_resource upstream("Upstream");
+    std::pmr::polymorphic_allocator<Tracked> alloc(&upstream);
+
+    // MakeSharedVsNew, through a resource: allocate_shared makes one allocation holding
+    // the control block and the object.
+    {
+        std::shared_ptr<Tracked> combined = std::allocate_shared<Tracked>(alloc, "Combined");
+        EXPECT_EQ(upstream.allocations(), 1u);
+        EXPECT_GE(upstream.bytes_in_use(), sizeof(Tracked));
+    }
+    EXPECT_EQ(upstream.deallocations(), 1u);
+
+    // With `new` plus an allocator argument, only the control block (holding the deleter)
+    // comes from the resource; the object itself still comes from operator new.
+    {
+        std::shared_ptr<Tracked> separate(new Tracked("Separate"), std::default_delete<Tracked>(), alloc);
+        EXPECT_EQ(upstream.allocations(), 2u);
+        EXPECT_LT(upstream.bytes_in_use(), sizeof(Tracked) + 2 * sizeof(void*));
+    }
+
+    // The combined block outlives the object while a weak_ptr remains.
+    std::weak_ptr<Tracked> watcher;
+    {
+        std::shared_ptr<Tracked> owner = std::allocate_shared<Tracked>(alloc, "Watched");
+        watcher = owner;
+    }
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Watched)::dtor"), 1u);
+    EXPECT_TRUE(watcher.expired());
+    EXPECT_EQ(upstream.deallocations(), 2u);
+    watcher.reset();
+    EXPECT_EQ(upstream.deallocations(), 3u);
+
+    // Aliasing and pmr containers of shared_ptrs draw from the same resource.
+    {
+        std::pmr::vector<std::shared_ptr<Tracked>> owners(&upstream);
+        for (int i = 0; i < 4; ++i)
+        {
+            owners.push_back(std::allocate_shared<Tracked>(alloc, "Pooled"));
+        }
+        std::shared_ptr<int> id(owners.front(), nullptr);
+        EXPECT_EQ(id.use_count(), 2);
+    }
+    EXPECT_EQ(upstream.bytes_in_use(), 0u);
+    EXPECT_EQ(upstream.allocations(), upstream.deallocations());
+
+    // Q: The weak_ptr case freed the Tracked object long before its memory. Why is that the
+    //    opposite trade-off from the `new` + allocator case?
+    // A:
+    // R:
+}
+
+// A request that allocates the way our handlers do: headers in a map of strings, a list of
+// ids, and a few shared session objects.
+struct Session
+{
+    std::uint64_t id;
+    std::array<char, 48> scratch;
+};
+
+std::size_t handle_request(std::pmr::memory_resource* resource, std::uint64_t request_id)
+{
+    std::pmr::map<std::pmr::string, std::pmr::string> headers(resource);
+    for (int h = 0; h < 8; ++h)
+    {
+        std::pmr::string key("x-request-header-", resource);
+        key += static_cast<char>('a' + h);
+        headers.emplace(std::move(key), std::pmr::string("a value long enough to leave SSO", resource));
+    }
+    std::pmr::vector<std::uint64_t> ids(resource);
+    for (std::uint64_t i = 0; i < 32; ++i)
+    {
+        ids.push_back(request_id * 31 + i);
+    }
+    std::pmr::vector<std::shared_ptr<Session>> sessions(resource);
+    for (int s = 0; s < 4; ++s)
+    {
+        sessions.push_back(std::allocate_shared<Session>(std::pmr::polymorphic_allocator<Session>(resource),
+                                                         Session{request_id, {}}));
+    }
+    return headers.size() + ids.size() + sessions.size();
+}
+
+TEST_F(CustomAllocatorsTest, PerRequestArenaKeepsMallocOffTheRequestPath)
+{
+    // null_memory_resource throws on any upstream call, so finishing the request proves
+    // every allocation came from the stack buffer.
+    std::array<std::byte, 16 * 1024> buffer;
+    monotonic_arena arena(buffer.data(), buffer.size(), growth_policy(), std::pmr::null_memory_resource());
+    counting_resource counted("Request", &arena);
+
+    for (std::uint64_t request = 0; request < 3; ++request)
+    {
+        EXPECT_EQ(handle_request(&counted, request), 44u);
+        arena.release();
+    }
+    EXPECT_EQ(arena.chunk_count(), 0u);
+    EXPECT_GT(counted.allocations(), 3 * 40u);
+    EXPECT_EQ(counted.allocations(), counted.deallocations());
+
+    monotonic_arena tiny(buffer.data(), 256, growth_policy(), std::pmr::null_memory_resource());
+    EXPECT_THROW(handle_request(&tiny, 0), std::bad_alloc);
+
+    // Q: How would you pick the buffer size, and what should happen on the request that
+    //    outgrows it: a heap fallback, or a failure you can see?
+    // A:
+    // R:
+}
+
+TEST_F(CustomAllocatorsTest, ShardedPoolServesThreadsAndCrossThreadFrees)
+{
+    sharded_pool pool(4);
+    std::pmr::polymorphic_allocator<Session> alloc(&pool);
+    const int per_thread = 2000;
+
+    // Each thread keeps half of what it makes and hands the rest to its neighbour to free.
+    std::vector<std::vector<std::shared_ptr<Session>>> handed(4);
+    std::vector<std::size_t> home_shard(4, sharded_pool::npos);
+    std::vector<std::thread> threads;
+    std::mutex handed_mutex;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            std::vector<std::shared_ptr<Session>> kept;
+            std::vector<std::shared_ptr<Session>> outgoing;
+            for (int i = 0; i < per_thread; ++i)
+            {
+                auto session = std::allocate_shared<Session>(alloc, Session{static_cast<std::uint64_t>(t), {}});
+                (i % 2 == 0 ? kept : outgoing).push_back(std::move(session));
+            }
+            std::size_t home = pool.shard_of(kept.front().get());
+            for (const auto& s : kept)
+            {
+                EXPECT_EQ(s->id, static_cast<std::uint64_t>(t));
+                EXPECT_EQ(pool.shard_of(s.get()), home);
+            }
+            std::lock_guard<std::mutex> lock(handed_mutex);
+            home_shard[static_cast<std::size_t>(t)] = home;
+            handed[static_cast<std::size_t>((t + 1) % 4)] = std::move(outgoing);
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+
+    // Four fresh threads are dealt four consecutive tickets: one shard each.
+    std::vector<std::size_t> homes = home_shard;
+    std::sort(homes.begin(), homes.end());
+    EXPECT_EQ(std::unique(homes.begin(), homes.end()) - homes.begin(), 4);
+    EXPECT_EQ(homes.back(), 3u);
+
+    threads.clear();
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]() { handed[static_cast<std::size_t>(t)].clear(); });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+
+    // A block freed on another thread goes back to its owner's shard, and the owner's
+    // free list is LIFO, so the owner's next allocation of that size gets it back.
+    void* mine = pool.allocate(64, alignof(std::max_align_t));
+    std::size_t my_shard = pool.shard_of(mine);
+    ASSERT_NE(my_shard, sharded_pool::npos);
+    std::thread([&]() { pool.deallocate(mine, 64, alignof(std::max_align_t)); }).join();
+    void* again = pool.allocate(64, alignof(std::max_align_t));
+    EXPECT_EQ(again, mine);
+    EXPECT_EQ(pool.shard_of(again), my_shard);
+    pool.deallocate(again, 64, alignof(std::max_align_t));
+
+    // Q: Returning the block to its owner costs the freeing thread a second mutex. What goes
+    //    wrong over time if it kept the block instead?
+    // A:
+    // R:
+}
+
+// ============================================================================
+// Request Path Benchmark
+// ============================================================================
+
+template<typename MakeResource>
+double request_ns(int requests, MakeResource make, std::size_t& checksum)
+{
+    double ms = time_ms([&]() {
+        for (int r = 0; r < requests; ++r)
+        {
+            checksum += make(static_cast<std::uint64_t>(r));
+        }
+    });
+    return ms * 1e6 / requests;
+}
+
+void run_request_benchmark(int requests)
+{
+    std::size_t checksum = 0;
+
+    double heap = request_ns(requests, [](std::uint64_t r) {
+        return handle_request(std::pmr::new_delete_resource(), r);
+    }, checksum);
+
+    double arena = request_ns(requests, [](std::uint64_t r) {
+        std::array<std::byte, 16 * 1024> buffer;
+        monotonic_arena per_request(buffer.data(), buffer.size());
+        return handle_request(&per_request, r);
+    }, checksum);
+
+    unsynchronized_bucket_pool buckets;
+    double bucket = request_ns(requests, [&](std::uint64_t r) { return handle_request(&buckets, r); }, checksum);
+
+    sharded_pool sharded;
+    double shards = request_ns(requests, [&](std::uint64_t r) { return handle_request(&sharded, r); }, checksum);
+
+    std::pmr::unsynchronized_pool_resource standard;
+    double std_pool = request_ns(requests, [&](std::uint64_t r) { return handle_request(&standard, r); }, checksum);
+
+    std::cout << "[ BENCH    ] ns/request: new_delete=" << heap << " monotonic_arena(stack)=" << arena
+              << " bucket_pool=" << bucket << " sharded_pool=" << shards
+              << " std::pmr::unsynchronized_pool=" << std_pool << "\n";
+    EXPECT_EQ(checksum, static_cast<std::size_t>(requests) * 5 * 44);
+}
+
+TEST_F(CustomAllocatorsTest, RequestPathResourceBenchmark)
+{
+    run_request_benchmark(20000);
+
+    // Q: The arena wins even though it never reuses memory within a request. What work do
+    //    the pools still do per allocation that the arena skips?
+    // A:
+    // R:
+
+    // Q: sharded_pool takes an uncontended mutex on every call. Roughly what does that add
+    //    over bucket_pool here, and when would a per-thread unsynchronized pool be better?
+    // A:
+    // R:
+}
+
+TEST_F(CustomAllocatorsTest, DISABLED_RequestPathResourceBenchmarkLarge)
+{
+    run_request_benchmark(1000000);
+}
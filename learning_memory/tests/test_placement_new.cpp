@@ -2,8 +2,409 @@
 // Estimated Time: 3 hours
 // Difficulty: Moderate
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-// TODO: Implement test cases for placement new
 // TODO: Implement test cases for aligned_storage
-// TODO: Implement test cases for manual object construction/destruction
+
+class PlacementNewTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// slab<T>: Raw Storage, Placement New, Bulk Construct and Destroy
+// ============================================================================
+
+// A fixed-capacity run of T in one allocation aligned for T. Objects are built in place with
+// placement new and never move, so pointers and references stay valid until destroy_all().
+// emplace_n() either constructs all n objects or, if one constructor throws, destroys the
+// ones it built (newest first) and rethrows with size() unchanged. Destruction is skipped
+// entirely for trivially destructible T.
+template<typename T>
+class slab
+{
+public:
+    static constexpr bool kRunsDestructors = !std::is_trivially_destructible<T>::value;
+
+    explicit slab(std::size_t capacity)
+    : data_(static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(alignof(T)))))
+    , capacity_(capacity)
+    {
+    }
+
+    slab(const slab&) = delete;
+    slab& operator=(const slab&) = delete;
+
+    slab(slab&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , capacity_(std::exchange(other.capacity_, 0))
+    {
+    }
+
+    slab& operator=(slab&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+        }
+        return *this;
+    }
+
+    ~slab()
+    {
+        release();
+    }
+
+    template<typename... Args>
+    T& emplace(Args&&... args)
+    {
+        if (size_ == capacity_)
+        {
+            throw std::length_error("slab is full");
+        }
+        T* object = ::new (static_cast<void*>(data_ + size_)) T(std::forward<Args>(args)...);
+        ++size_;
+        return *object;
+    }
+
+    // Constructs n objects from the same arguments (copied, never moved from) and returns the
+    // first. Strong guarantee: on a throw, everything this call built is destroyed again.
+    template<typename... Args>
+    T* emplace_n(std::size_t n, const Args&... args)
+    {
+        if (n > capacity_ - size_)
+        {
+            throw std::length_error("slab is full");
+        }
+        T* first = data_ + size_;
+        std::size_t built = 0;
+        try
+        {
+            for (; built < n; ++built)
+            {
+                ::new (static_cast<void*>(first + built)) T(args...);
+            }
+        }
+        catch (...)
+        {
+            destroy_range(first, built);
+            throw;
+        }
+        size_ += n;
+        return first;
+    }
+
+    // Destroys every object, newest first, and keeps the storage for reuse.
+    void destroy_all() noexcept
+    {
+        destroy_range(data_, size_);
+        size_ = 0;
+    }
+
+    void pop_back() noexcept
+    {
+        --size_;
+        if constexpr (kRunsDestructors)
+        {
+            data_[size_].~T();
+        }
+    }
+
+    T& operator[](std::size_t i)
+    {
+        return data_[i];
+    }
+
+    const T& operator[](std::size_t i) const
+    {
+        return data_[i];
+    }
+
+    T* begin()
+    {
+        return data_;
+    }
+
+    T* end()
+    {
+        return data_ + size_;
+    }
+
+    const T* begin() const
+    {
+        return data_;
+    }
+
+    const T* end() const
+    {
+        return data_ + size_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    static void destroy_range(T* first, std::size_t count) noexcept
+    {
+        if constexpr (kRunsDestructors)
+        {
+            while (count != 0)
+            {
+                first[--count].~T();
+            }
+        }
+    }
+
+    void release() noexcept
+    {
+        if (data_ != nullptr)
+        {
+            destroy_all();
+            ::operator delete(data_, std::align_val_t(alignof(T)));
+            data_ = nullptr;
+        }
+    }
+
+    T* data_;
+    std::size_t size_ = 0;
+    std::size_t capacity_;
+};
+
+struct Particle
+{
+    double position[3];
+    double velocity[3];
+    double mass;
+};
+
+struct alignas(64) CacheLineBody
+{
+    double state[4];
+};
+
+static_assert(!slab<Particle>::kRunsDestructors, "Particle is trivially destructible");
+static_assert(slab<Tracked>::kRunsDestructors, "Tracked logs from its destructor");
+
+TEST_F(PlacementNewTest, SlabConstructsInPlaceAndDestroysNewestFirst)
+{
+    slab<Tracked> agents(4);
+    Tracked& first = agents.emplace("SlabA");
+    Tracked* run = agents.emplace_n(2, std::string("SlabB"));
+    EXPECT_EQ(&first, &agents[0]);
+    EXPECT_EQ(run, &agents[1]);
+    EXPECT_EQ(agents.size(), 3u);
+    EXPECT_EQ(EventLog::instance().count_events("::ctor"), 3u);
+    EXPECT_EQ(EventLog::instance().count_events("::copy_ctor"), 0u);
+
+    EventLog::instance().clear();
+    agents.destroy_all();
+    std::vector<std::string> events = EventLog::instance().events();
+    ASSERT_EQ(events.size(), 3u);
+    EXPECT_NE(events[0].find("Tracked(SlabB)::dtor"), std::string::npos);
+    EXPECT_NE(events[2].find("Tracked(SlabA)::dtor"), std::string::npos);
+
+    // The storage stays: the next object lands where the first one was.
+    EXPECT_EQ(&agents.emplace("SlabC"), &first);
+
+    slab<CacheLineBody> bodies(8);
+    bodies.emplace_n(8, CacheLineBody{});
+    for (const CacheLineBody& body : bodies)
+    {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&body) % 64, 0u);
+    }
+    EXPECT_THROW(bodies.emplace(), std::length_error);
+
+    // Q: destroy_all() runs destructors newest first. Which objects in a simulation could
+    //    depend on that order, and what does std::vector promise about it?
+    // A:
+    // R:
+}
+
+// Throws from its constructor once `budget` reaches zero. The Tracked member is already built
+// by then, so its destructor runs as part of the failed construction.
+struct FragileAgent
+{
+    Tracked tracked;
+
+    FragileAgent(const std::string& name, int* budget)
+    : tracked(name)
+    {
+        if ((*budget)-- == 0)
+        {
+            throw std::runtime_error("agent construction failed");
+        }
+    }
+};
+
+TEST_F(PlacementNewTest, SlabEmplaceNRollsBackAPartialConstruction)
+{
+    slab<FragileAgent> agents(8);
+    int budget = 10;
+    agents.emplace("Keeper", &budget);
+
+    budget = 3;
+    EventLog::instance().clear();
+    EXPECT_THROW(agents.emplace_n(5, std::string("Batch"), &budget), std::runtime_error);
+
+    // Three agents were built, the fourth threw mid-construction: four ctors, four dtors, and
+    // the rollback destroyed the finished ones newest first.
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Batch)::ctor"), 4u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Batch)::dtor"), 4u);
+    std::vector<std::string> events = EventLog::instance().events();
+    ASSERT_EQ(events.size(), 8u);
+    EXPECT_NE(events[4].find("[id=" + std::to_string(agents[0].tracked.id() + 4) + "]"), std::string::npos);
+    EXPECT_NE(events[7].find("[id=" + std::to_string(agents[0].tracked.id() + 1) + "]"), std::string::npos);
+
+    EXPECT_EQ(agents.size(), 1u);
+    EXPECT_EQ(agents[0].tracked.name(), "Keeper");
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Keeper)::dtor"), 0u);
+
+    // Q: The fourth agent's Tracked member was destroyed, but FragileAgent's destructor never
+    //    ran for it. Why is that the right thing for the language to do?
+    // A:
+    // R:
+}
+
+// ============================================================================
+// Simulation Benchmark: slab<T> vs vector<unique_ptr<T>>
+// ============================================================================
+
+struct SimulationReport
+{
+    double create_ms;
+    double step_ms;
+    double destroy_ms;
+    double energy;
+};
+
+void step_particle(Particle& p, double dt)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        p.velocity[axis] -= 9.81 * dt * (axis == 2);
+        p.position[axis] += p.velocity[axis] * dt;
+    }
+}
+
+double kinetic_energy(const Particle& p)
+{
+    return 0.5 * p.mass * (p.velocity[0] * p.velocity[0] + p.velocity[1] * p.velocity[1] + p.velocity[2] * p.velocity[2]);
+}
+
+const Particle kSpawn = {{0.0, 0.0, 100.0}, {1.0, 0.5, 0.0}, 2.0};
+
+SimulationReport simulate_unique_ptrs(std::size_t count, int steps)
+{
+    SimulationReport report{};
+    std::vector<std::unique_ptr<Particle>> particles;
+    report.create_ms = time_ms([&]() {
+        particles.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            particles.push_back(std::make_unique<Particle>(kSpawn));
+        }
+    });
+    report.step_ms = time_ms([&]() {
+        for (int s = 0; s < steps; ++s)
+        {
+            for (auto& p : particles)
+            {
+                step_particle(*p, 0.01);
+            }
+        }
+    });
+    for (const auto& p : particles)
+    {
+        report.energy += kinetic_energy(*p);
+    }
+    report.destroy_ms = time_ms([&]() { particles.clear(); });
+    return report;
+}
+
+SimulationReport simulate_slab(std::size_t count, int steps)
+{
+    SimulationReport report{};
+    slab<Particle> particles(count);
+    report.create_ms = time_ms([&]() { particles.emplace_n(count, kSpawn); });
+    report.step_ms = time_ms([&]() {
+        for (int s = 0; s < steps; ++s)
+        {
+            for (Particle& p : particles)
+            {
+                step_particle(p, 0.01);
+            }
+        }
+    });
+    for (const Particle& p : particles)
+    {
+        report.energy += kinetic_energy(p);
+    }
+    report.destroy_ms = time_ms([&]() { particles.destroy_all(); });
+    return report;
+}
+
+void run_simulation_benchmark(std::size_t count, int steps)
+{
+    SimulationReport boxed = simulate_unique_ptrs(count, steps);
+    SimulationReport slabbed = simulate_slab(count, steps);
+    std::cout << "[ BENCH    ] particles=" << count << " steps=" << steps << " vector<unique_ptr>: create_ms="
+              << boxed.create_ms << " step_ms=" << boxed.step_ms << " destroy_ms=" << boxed.destroy_ms << "\n";
+    std::cout << "[ BENCH    ] particles=" << count << " steps=" << steps << " slab:               create_ms="
+              << slabbed.create_ms << " step_ms=" << slabbed.step_ms << " destroy_ms=" << slabbed.destroy_ms << "\n";
+    EXPECT_DOUBLE_EQ(boxed.energy, slabbed.energy);
+}
+
+TEST_F(PlacementNewTest, SlabVsUniquePtrSimulationBenchmark)
+{
+    run_simulation_benchmark(100000, 10);
+
+    // Q: Freshly allocated unique_ptr targets often sit in address order anyway. What does
+    //    the step loop cost once the heap is fragmented and they do not?
+    // A:
+    // R:
+
+    // Q: slab<Particle>::destroy_all() compiles to almost nothing. Which property of Particle
+    //    allows that, and what single member would take it away?
+    // A:
+    // R:
+}
+
+TEST_F(PlacementNewTest, DISABLED_SlabVsUniquePtrSimulationBenchmarkLarge)
+{
+    run_simulation_benchmark(10000000, 20);
+}
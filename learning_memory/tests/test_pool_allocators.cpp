@@ -2,8 +2,2020 @@
 // Estimated Time: 5 hours
 // Difficulty: Hard
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-// TODO: Implement test cases for fixed-size pool allocator
-// TODO: Implement test cases for variable-size pool allocator
-// TODO: Implement test cases for memory pool performance
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define POOL_ALLOCATORS_HAVE_MMAP 1
+#else
+#define POOL_ALLOCATORS_HAVE_MMAP 0
+#endif
+
+class PoolAllocatorsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// OS Pages
+// ============================================================================
+
+namespace detail
+{
+
+constexpr std::size_t round_up(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+constexpr std::size_t next_power_of_two(std::size_t value)
+{
+    std::size_t power = 1;
+    while (power < value)
+    {
+        power *= 2;
+    }
+    return power;
+}
+
+// `bytes` of fresh memory straight from the OS whose address is a multiple of `alignment`.
+// mmap only promises OS-page alignment, so over-map by `alignment` and unmap the slack.
+inline void* map_pages(std::size_t bytes, std::size_t alignment)
+{
+#if POOL_ALLOCATORS_HAVE_MMAP
+    std::size_t span = bytes + alignment;
+    void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(raw);
+    std::uintptr_t aligned = round_up(base, alignment);
+    if (aligned != base)
+    {
+        munmap(raw, aligned - base);
+    }
+    std::size_t tail = base + span - (aligned + bytes);
+    if (tail != 0)
+    {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+#else
+    return ::operator new(bytes, std::align_val_t(alignment));
+#endif
+}
+
+inline void unmap_pages(void* pages, std::size_t bytes, std::size_t alignment)
+{
+#if POOL_ALLOCATORS_HAVE_MMAP
+    (void)alignment;
+    munmap(pages, bytes);
+#else
+    ::operator delete(pages, std::align_val_t(alignment));
+    (void)bytes;
+#endif
+}
+
+// Hands the physical pages back but keeps the address range, so the pool's page record
+// stays valid and reuse costs page faults rather than a new mapping. Contents read as zero.
+inline void purge_pages(void* pages, std::size_t bytes)
+{
+#if POOL_ALLOCATORS_HAVE_MMAP
+    madvise(pages, bytes, MADV_DONTNEED);
+#else
+    (void)pages;
+    (void)bytes;
+#endif
+}
+
+} // namespace detail
+
+// ============================================================================
+// fixed_pool<Size, Align>: Thread Magazines, Lock-Free Depot, Page Return
+// ============================================================================
+
+namespace detail
+{
+
+// The intrusive free list: a free block's first word points at the next free block.
+struct free_block
+{
+    free_block* next;
+};
+
+// A chain of free blocks with its length. A thread owns at most two of these per pool.
+struct magazine
+{
+    free_block* head = nullptr;
+    std::uint32_t count = 0;
+
+    void push(free_block* block)
+    {
+        block->next = head;
+        head = block;
+        ++count;
+    }
+
+    free_block* pop()
+    {
+        free_block* block = head;
+        head = block->next;
+        --count;
+        return block;
+    }
+
+    // Detaches the first `n` blocks (n <= count) as a magazine of their own.
+    magazine split(std::uint32_t n)
+    {
+        magazine front{head, n};
+        free_block* last = head;
+        for (std::uint32_t i = 1; i < n; ++i)
+        {
+            last = last->next;
+        }
+        head = last->next;
+        last->next = nullptr;
+        count -= n;
+        return front;
+    }
+
+    void append(magazine other)
+    {
+        if (other.count == 0)
+        {
+            return;
+        }
+        free_block* last = other.head;
+        while (last->next != nullptr)
+        {
+            last = last->next;
+        }
+        last->next = head;
+        head = other.head;
+        count += other.count;
+    }
+};
+
+// A Treiber stack of indices into an array of links. With 32-bit indices the other half of
+// the 64-bit head is a tag that changes on every push and pop, which defeats ABA without a
+// double-width CAS. The links belong to the depot and are never handed to users, so a pop
+// that loses the race has read an atomic the pool still owns.
+class index_stack
+{
+public:
+    static constexpr std::uint32_t kEmpty = 0xffffffffu;
+
+    explicit index_stack(std::atomic<std::uint32_t>* links)
+    : links_(links)
+    , head_(pack(kEmpty, 0))
+    {
+    }
+
+    void push(std::uint32_t index)
+    {
+        std::uint64_t old_head = head_.load(std::memory_order_relaxed);
+        std::uint64_t new_head;
+        do
+        {
+            links_[index].store(index_of(old_head), std::memory_order_relaxed);
+            new_head = pack(index, tag_of(old_head) + 1);
+        } while (!head_.compare_exchange_weak(old_head, new_head, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    std::uint32_t pop()
+    {
+        std::uint64_t old_head = head_.load(std::memory_order_acquire);
+        for (;;)
+        {
+            std::uint32_t index = index_of(old_head);
+            if (index == kEmpty)
+            {
+                return kEmpty;
+            }
+            std::uint64_t new_head = pack(links_[index].load(std::memory_order_relaxed), tag_of(old_head) + 1);
+            if (head_.compare_exchange_weak(old_head, new_head, std::memory_order_acquire,
+                                            std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+    }
+
+private:
+    static std::uint64_t pack(std::uint32_t index, std::uint32_t tag)
+    {
+        return (static_cast<std::uint64_t>(tag) << 32) | index;
+    }
+
+    static std::uint32_t index_of(std::uint64_t head)
+    {
+        return static_cast<std::uint32_t>(head);
+    }
+
+    static std::uint32_t tag_of(std::uint64_t head)
+    {
+        return static_cast<std::uint32_t>(head >> 32);
+    }
+
+    std::atomic<std::uint32_t>* links_;
+    std::atomic<std::uint64_t> head_;
+};
+
+// Full magazines parked between threads. Each slot holds one chain; `full_` lists the
+// occupied slots and `empty_` the vacant ones. A slot sits in exactly one of the two, so
+// they share one link array, and push/pop never allocate or lock.
+class magazine_depot
+{
+public:
+    explicit magazine_depot(std::uint32_t slots)
+    : chains_(new free_block*[slots])
+    , links_(new std::atomic<std::uint32_t>[slots])
+    , full_(links_.get())
+    , empty_(links_.get())
+    {
+        for (std::uint32_t i = slots; i-- > 0;)
+        {
+            empty_.push(i);
+        }
+    }
+
+    // False when every slot is taken; the caller keeps the chain.
+    bool push(free_block* chain)
+    {
+        std::uint32_t slot = empty_.pop();
+        if (slot == index_stack::kEmpty)
+        {
+            return false;
+        }
+        chains_[slot] = chain;
+        full_.push(slot);
+        return true;
+    }
+
+    free_block* pop()
+    {
+        std::uint32_t slot = full_.pop();
+        if (slot == index_stack::kEmpty)
+        {
+            return nullptr;
+        }
+        free_block* chain = chains_[slot];
+        empty_.push(slot);
+        return chain;
+    }
+
+private:
+    std::unique_ptr<free_block*[]> chains_;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> links_;
+    index_stack full_;
+    index_stack empty_;
+};
+
+// The calling thread's Cache for a process-wide allocator. A constant-initialized pointer
+// keeps the hot path to one TLS load; the Cache itself is a guarded thread_local so that its
+// destructor can flush on thread exit. From then on get() returns nullptr, and thread_local
+// destructors that run later fall back to the allocator's locked path.
+template<typename Cache>
+class thread_cache_slot
+{
+public:
+    static Cache* get()
+    {
+        Cache* cache = pointer();
+        return cache != nullptr ? cache : attach();
+    }
+
+private:
+    struct holder
+    {
+        Cache cache;
+
+        ~holder()
+        {
+            pointer() = nullptr;
+            gone() = true;
+        }
+    };
+
+    static Cache*& pointer()
+    {
+        thread_local Cache* cache = nullptr;
+        return cache;
+    }
+
+    static bool& gone()
+    {
+        thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    static Cache* attach()
+    {
+        if (gone())
+        {
+            return nullptr;
+        }
+        thread_local holder local;
+        pointer() = &local.cache;
+        return &local.cache;
+    }
+};
+
+} // namespace detail
+
+struct fixed_pool_stats
+{
+    std::size_t pages_mapped = 0;   // address ranges taken from the OS, purged or not
+    std::size_t pages_resident = 0; // mapped pages that have not been purged
+    std::size_t pages_purged = 0;   // purges over the pool's lifetime
+    std::size_t depot_refills = 0;  // thread cache refills served lock-free by the depot
+    std::size_t locked_refills = 0; // refills that had to take the pool mutex
+};
+
+// One pool per (Size, Align) per process. allocate() and deallocate() touch only the calling
+// thread's two magazines; every kMagazine operations a whole magazine moves to or from the
+// depot with two CASes. The mutex guards the slow path: spare blocks, carving fresh pages,
+// and trim(), which returns pages whose blocks are all back in the pool to the OS.
+template<std::size_t Size, std::size_t Align = alignof(std::max_align_t)>
+class fixed_pool
+{
+public:
+    static constexpr std::size_t kBlockSize = detail::round_up(Size < sizeof(void*) ? sizeof(void*) : Size, Align);
+    static constexpr std::uint32_t kMagazine = 64;
+    static constexpr std::uint32_t kDepotSlots = 1024;
+    // 64 KiB unless a block is over 1 KiB; then the smallest power of two that still fills a
+    // magazine, because page_index() finds a block's page by masking its address.
+    static constexpr std::size_t kPageBytes =
+        detail::next_power_of_two(std::max<std::size_t>(64 * 1024, kMagazine * kBlockSize));
+    static constexpr std::size_t kBlocksPerPage = kPageBytes / kBlockSize;
+
+    static_assert(Align != 0 && (Align & (Align - 1)) == 0, "fixed_pool alignment must be a power of two");
+    static_assert(Align <= 4096, "fixed_pool alignment above the OS page size is not supported");
+    static_assert(kBlocksPerPage >= kMagazine, "fixed_pool block size must let a page fill a magazine");
+
+    static fixed_pool& instance()
+    {
+        static fixed_pool pool;
+        return pool;
+    }
+
+    fixed_pool(const fixed_pool&) = delete;
+    fixed_pool& operator=(const fixed_pool&) = delete;
+
+    ~fixed_pool()
+    {
+        for (const page_record& page : pages_)
+        {
+            detail::unmap_pages(page.base, kPageBytes, kPageBytes);
+        }
+    }
+
+    void* allocate()
+    {
+        thread_cache* cache = local_cache();
+        if (cache == nullptr)
+        {
+            return take_locked(1).pop();
+        }
+        if (cache->loaded.count == 0)
+        {
+            cache->reload(*this);
+        }
+        return cache->loaded.pop();
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (p == nullptr)
+        {
+            return;
+        }
+        detail::free_block* block = static_cast<detail::free_block*>(p);
+        thread_cache* cache = local_cache();
+        if (cache == nullptr)
+        {
+            detail::magazine single;
+            single.push(block);
+            give_back(single);
+            return;
+        }
+        if (cache->loaded.count == kMagazine)
+        {
+            cache->spill(*this);
+        }
+        cache->loaded.push(block);
+    }
+
+    // Moves this thread's cached blocks back into the shared pool, e.g. before trim().
+    void flush_thread_cache()
+    {
+        if (thread_cache* cache = local_cache())
+        {
+            cache->flush(*this);
+        }
+    }
+
+    // Purges every page whose blocks are all parked in the depot or the spare list and
+    // returns how many were released. Blocks held in other threads' magazines keep their
+    // pages resident, so call it at idle points after the workers flushed or exited.
+    std::size_t trim()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (detail::free_block* chain = depot_.pop())
+        {
+            spare_.append(detail::magazine{chain, count_chain(chain)});
+        }
+
+        std::vector<std::size_t> free_in_page(pages_.size(), 0);
+        for (detail::free_block* b = spare_.head; b != nullptr; b = b->next)
+        {
+            ++free_in_page[page_index(b)];
+        }
+        if (bump_ != bump_end_)
+        {
+            free_in_page[page_index(bump_)] += static_cast<std::size_t>(bump_end_ - bump_) / kBlockSize;
+        }
+
+        std::size_t released = 0;
+        for (std::size_t i = 0; i < pages_.size(); ++i)
+        {
+            if (pages_[i].resident && free_in_page[i] == kBlocksPerPage)
+            {
+                pages_[i].resident = false;
+                ++released;
+            }
+        }
+        if (released == 0)
+        {
+            return 0;
+        }
+
+        // Unlink the doomed blocks before purging: their `next` words are about to read zero.
+        detail::magazine kept;
+        while (spare_.count != 0)
+        {
+            detail::free_block* b = spare_.pop();
+            if (pages_[page_index(b)].resident)
+            {
+                kept.push(b);
+            }
+        }
+        spare_ = kept;
+        if (bump_ != bump_end_ && !pages_[page_index(bump_)].resident)
+        {
+            bump_ = bump_end_ = nullptr;
+        }
+        for (std::size_t i = 0; i < pages_.size(); ++i)
+        {
+            if (!pages_[i].resident && free_in_page[i] == kBlocksPerPage)
+            {
+                detail::purge_pages(pages_[i].base, kPageBytes);
+            }
+        }
+        resident_pages_ -= released;
+        purged_pages_ += released;
+
+        // Full magazines go back to the depot so the next refills stay lock-free.
+        while (spare_.count >= kMagazine)
+        {
+            detail::magazine full = spare_.split(kMagazine);
+            if (!depot_.push(full.head))
+            {
+                spare_.append(full);
+                break;
+            }
+        }
+        return released;
+    }
+
+    fixed_pool_stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fixed_pool_stats s;
+        s.pages_mapped = pages_.size();
+        s.pages_resident = resident_pages_;
+        s.pages_purged = purged_pages_;
+        s.depot_refills = depot_refills_.load(std::memory_order_relaxed);
+        s.locked_refills = locked_refills_;
+        return s;
+    }
+
+private:
+    struct page_record
+    {
+        char* base;
+        bool resident;
+    };
+
+    // Bonwick's two-magazine cache: `loaded` serves both directions and `previous` is
+    // always empty or full, so a thread that alternates at a magazine boundary swaps the
+    // two instead of hitting the depot each time.
+    struct thread_cache
+    {
+        detail::magazine loaded;
+        detail::magazine previous;
+
+        ~thread_cache()
+        {
+            flush(instance());
+        }
+
+        void reload(fixed_pool& pool)
+        {
+            if (previous.count != 0)
+            {
+                std::swap(loaded, previous);
+            }
+            else
+            {
+                loaded = pool.refill();
+            }
+        }
+
+        void spill(fixed_pool& pool)
+        {
+            if (previous.count != 0)
+            {
+                pool.park(previous);
+            }
+            previous = loaded;
+            loaded = detail::magazine();
+        }
+
+        void flush(fixed_pool& pool)
+        {
+            if (previous.count != 0)
+            {
+                pool.park(previous);
+            }
+            pool.give_back(loaded);
+            loaded = previous = detail::magazine();
+        }
+    };
+
+    fixed_pool()
+    : depot_(kDepotSlots)
+    {
+    }
+
+    static thread_cache* local_cache()
+    {
+        return detail::thread_cache_slot<thread_cache>::get();
+    }
+
+    detail::magazine refill()
+    {
+        if (detail::free_block* chain = depot_.pop())
+        {
+            depot_refills_.fetch_add(1, std::memory_order_relaxed);
+            return detail::magazine{chain, kMagazine};
+        }
+        return take_locked(kMagazine);
+    }
+
+    // Only full magazines enter the depot, which is what lets refill() skip counting.
+    void park(detail::magazine full)
+    {
+        if (!depot_.push(full.head))
+        {
+            give_back(full);
+        }
+    }
+
+    void give_back(detail::magazine blocks)
+    {
+        if (blocks.count == 0)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        spare_.append(blocks);
+    }
+
+    detail::magazine take_locked(std::uint32_t wanted)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++locked_refills_;
+        if (spare_.count != 0)
+        {
+            return spare_.split(std::min(wanted, spare_.count));
+        }
+        if (bump_ == bump_end_)
+        {
+            open_page();
+        }
+        // Carving a magazine at a time touches only the lines about to be used.
+        detail::magazine carved;
+        while (carved.count < wanted && bump_ != bump_end_)
+        {
+            bump_end_ -= kBlockSize;
+            carved.push(reinterpret_cast<detail::free_block*>(bump_end_));
+        }
+        return carved;
+    }
+
+    void open_page()
+    {
+        auto purged = std::find_if(pages_.begin(), pages_.end(), [](const page_record& p) { return !p.resident; });
+        if (purged != pages_.end())
+        {
+            purged->resident = true;
+            bump_ = purged->base;
+        }
+        else
+        {
+            char* base = static_cast<char*>(detail::map_pages(kPageBytes, kPageBytes));
+            auto at = std::upper_bound(pages_.begin(), pages_.end(), base,
+                                       [](char* b, const page_record& p) { return b < p.base; });
+            pages_.insert(at, page_record{base, true});
+            bump_ = base;
+        }
+        ++resident_pages_;
+        bump_end_ = bump_ + kBlocksPerPage * kBlockSize;
+    }
+
+    std::size_t page_index(const void* p) const
+    {
+        char* base = reinterpret_cast<char*>(reinterpret_cast<std::uintptr_t>(p) & ~(kPageBytes - 1));
+        auto at = std::lower_bound(pages_.begin(), pages_.end(), base,
+                                   [](const page_record& page, char* b) { return page.base < b; });
+        return static_cast<std::size_t>(at - pages_.begin());
+    }
+
+    static std::uint32_t count_chain(detail::free_block* chain)
+    {
+        std::uint32_t n = 0;
+        for (; chain != nullptr; chain = chain->next)
+        {
+            ++n;
+        }
+        return n;
+    }
+
+    detail::magazine_depot depot_;
+    std::atomic<std::size_t> depot_refills_{0};
+
+    mutable std::mutex mutex_;
+    detail::magazine spare_;
+    std::vector<page_record> pages_;
+    char* bump_ = nullptr;
+    char* bump_end_ = nullptr;
+    std::size_t resident_pages_ = 0;
+    std::size_t purged_pages_ = 0;
+    std::size_t locked_refills_ = 0;
+};
+
+// Single-object requests (list, map and set nodes) go to the pool for sizeof(T) and
+// alignof(T); array requests such as vector growth fall through to operator new.
+template<typename T>
+class fixed_pool_allocator
+{
+public:
+    using value_type = T;
+    using pool_type = fixed_pool<sizeof(T), alignof(T)>;
+
+    fixed_pool_allocator() noexcept = default;
+
+    template<typename U>
+    fixed_pool_allocator(const fixed_pool_allocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (n == 1)
+        {
+            return static_cast<T*>(pool_type::instance().allocate());
+        }
+        if (n > static_cast<std::size_t>(-1) / sizeof(T))
+        {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n == 1)
+        {
+            pool_type::instance().deallocate(p);
+        }
+        else
+        {
+            ::operator delete(p, std::align_val_t(alignof(T)));
+        }
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const fixed_pool_allocator<T>&, const fixed_pool_allocator<U>&) noexcept
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const fixed_pool_allocator<T>&, const fixed_pool_allocator<U>&) noexcept
+{
+    return false;
+}
+
+TEST_F(PoolAllocatorsTest, FixedPoolRecyclesBlocksThroughTheThreadCache)
+{
+    using pool_type = fixed_pool<24, 8>;
+    static_assert(pool_type::kBlockSize == 24, "");
+
+    pool_type& pool = pool_type::instance();
+    void* a = pool.allocate();
+    void* b = pool.allocate();
+    EXPECT_NE(a, b);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(a) % 8, 0u);
+
+    // LIFO: the block freed last is the next one handed out, still warm in cache.
+    pool.deallocate(b);
+    EXPECT_EQ(pool.allocate(), b);
+    pool.deallocate(b);
+    pool.deallocate(a);
+
+    using aligned_pool = fixed_pool<40, 64>;
+    static_assert(aligned_pool::kBlockSize == 64, "");
+    std::vector<void*> blocks;
+    for (int i = 0; i < 200; ++i)
+    {
+        blocks.push_back(aligned_pool::instance().allocate());
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(blocks.back()) % 64, 0u);
+    }
+    EXPECT_EQ(std::set<void*>(blocks.begin(), blocks.end()).size(), blocks.size());
+    for (void* p : blocks)
+    {
+        aligned_pool::instance().deallocate(p);
+    }
+
+    // Q: A free block stores its `next` pointer in its own first bytes. Why does that put a
+    //    lower bound on kBlockSize, and what would a debug build write there instead?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, FixedPoolMovesMagazinesBetweenThreadsThroughTheDepot)
+{
+    using pool_type = fixed_pool<56, 8>;
+    pool_type& pool = pool_type::instance();
+    const int blocks = 20 * static_cast<int>(pool_type::kMagazine);
+
+    std::vector<void*> handed_over;
+    std::thread producer([&]() {
+        for (int i = 0; i < blocks; ++i)
+        {
+            handed_over.push_back(pool.allocate());
+        }
+    });
+    producer.join();
+    std::size_t mapped_before = pool.stats().pages_mapped;
+
+    // Cross-thread frees land in the freeing thread's magazines; full ones go to the depot
+    // and the rest is flushed when the thread exits.
+    std::thread consumer([&]() {
+        for (void* p : handed_over)
+        {
+            pool.deallocate(p);
+        }
+    });
+    consumer.join();
+
+    std::size_t depot_before = pool.stats().depot_refills;
+    std::vector<void*> again;
+    for (int i = 0; i < blocks / 2; ++i)
+    {
+        again.push_back(pool.allocate());
+    }
+    fixed_pool_stats after = pool.stats();
+    EXPECT_GT(after.depot_refills, depot_before);
+    EXPECT_EQ(after.pages_mapped, mapped_before);
+
+    for (void* p : again)
+    {
+        pool.deallocate(p);
+    }
+
+    // Q: The consumer never calls allocate(). What would happen to its blocks if thread
+    //    exit did not flush the thread cache?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, FixedPoolReturnsIdlePagesToTheOs)
+{
+    using pool_type = fixed_pool<120, 8>;
+    pool_type& pool = pool_type::instance();
+    const std::size_t count = 4 * pool_type::kBlocksPerPage;
+
+    std::vector<void*> blocks;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        blocks.push_back(pool.allocate());
+        static_cast<char*>(blocks.back())[0] = 1;
+    }
+    fixed_pool_stats busy = pool.stats();
+    EXPECT_GE(busy.pages_resident, 4u);
+
+    // One live block pins its page; everything else is idle.
+    void* survivor = blocks.front();
+    for (std::size_t i = 1; i < blocks.size(); ++i)
+    {
+        pool.deallocate(blocks[i]);
+    }
+    pool.flush_thread_cache();
+    std::size_t released = pool.trim();
+
+    fixed_pool_stats idle = pool.stats();
+    EXPECT_EQ(released, busy.pages_resident - 1);
+    EXPECT_EQ(idle.pages_resident, 1u);
+    EXPECT_EQ(idle.pages_mapped, busy.pages_mapped);
+    EXPECT_EQ(static_cast<char*>(survivor)[0], 1);
+
+    // Purged pages keep their address range and are reused before anything new is mapped.
+    blocks.assign(1, survivor);
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        blocks.push_back(pool.allocate());
+    }
+    EXPECT_EQ(pool.stats().pages_mapped, busy.pages_mapped);
+    for (void* p : blocks)
+    {
+        pool.deallocate(p);
+    }
+    pool.flush_thread_cache();
+    pool.trim();
+    EXPECT_EQ(pool.stats().pages_resident, 0u);
+
+    // Q: trim() purges with madvise(MADV_DONTNEED) instead of munmap. What does keeping the
+    //    address range save on reuse, and why must the spare list be filtered before the purge?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, FixedPoolAllocatorWorksWithContainers)
+{
+    {
+        std::list<Tracked, fixed_pool_allocator<Tracked>> tracked;
+        tracked.emplace_back("PoolA");
+        tracked.emplace_back("PoolB");
+        tracked.pop_front();
+        EXPECT_EQ(tracked.front().name(), "PoolB");
+
+        std::map<int, int, std::less<int>, fixed_pool_allocator<std::pair<const int, int>>> squares;
+        for (int i = 0; i < 1000; ++i)
+        {
+            squares.emplace(i, i * i);
+        }
+        EXPECT_EQ(squares.at(31), 961);
+
+        std::vector<int, fixed_pool_allocator<int>> grown;
+        for (int i = 0; i < 100; ++i)
+        {
+            grown.push_back(i);
+        }
+        EXPECT_EQ(grown[99], 99);
+    }
+
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(PoolA)::dtor"), 1u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(PoolB)::dtor"), 1u);
+    EXPECT_TRUE(fixed_pool_allocator<int>() == fixed_pool_allocator<double>());
+}
+
+TEST_F(PoolAllocatorsTest, FixedPoolGrowsPagesForLargeBlocks)
+{
+    using Frame = std::array<char, 3000>;
+    using pool_type = fixed_pool_allocator<Frame>::pool_type;
+    static_assert(pool_type::kPageBytes == 256 * 1024, "64 blocks of 3000 bytes round up to 256 KiB");
+    static_assert(pool_type::kBlocksPerPage >= pool_type::kMagazine, "");
+
+    std::list<Frame, fixed_pool_allocator<Frame>> frames;
+    for (int i = 0; i < 200; ++i)
+    {
+        frames.emplace_back();
+        frames.back()[2999] = static_cast<char>(i);
+    }
+    EXPECT_EQ(frames.back()[2999], static_cast<char>(199));
+}
+
+// ============================================================================
+// Fixed-Size Pool Benchmarks: Storms, Churn, Cross-Thread Frees
+// ============================================================================
+
+constexpr std::size_t kBenchBlockSize = 64;
+
+struct malloc_source
+{
+    static void* allocate()
+    {
+        return std::malloc(kBenchBlockSize);
+    }
+
+    static void deallocate(void* p)
+    {
+        std::free(p);
+    }
+};
+
+struct new_source
+{
+    static void* allocate()
+    {
+        return ::operator new(kBenchBlockSize);
+    }
+
+    static void deallocate(void* p)
+    {
+        ::operator delete(p);
+    }
+};
+
+struct pool_source
+{
+    static void* allocate()
+    {
+        return fixed_pool<kBenchBlockSize>::instance().allocate();
+    }
+
+    static void deallocate(void* p)
+    {
+        fixed_pool<kBenchBlockSize>::instance().deallocate(p);
+    }
+};
+
+// Allocates `batch` blocks, writes one byte to each, frees them all; ns per alloc+free pair.
+template<typename Source>
+double storm_ns(std::size_t batch, int rounds, std::uint64_t& checksum)
+{
+    std::vector<void*> live(batch);
+    double ms = time_ms([&]() {
+        for (int r = 0; r < rounds; ++r)
+        {
+            for (std::size_t i = 0; i < batch; ++i)
+            {
+                live[i] = Source::allocate();
+                static_cast<unsigned char*>(live[i])[0] = static_cast<unsigned char>(i);
+            }
+            for (std::size_t i = 0; i < batch; ++i)
+            {
+                checksum += static_cast<unsigned char*>(live[i])[0];
+                Source::deallocate(live[i]);
+            }
+        }
+    });
+    return ms * 1e6 / (static_cast<double>(batch) * rounds);
+}
+
+// Keeps `working_set` blocks alive and replaces a random one per step, so frees arrive in
+// no particular order; ns per replacement.
+template<typename Source>
+double churn_ns(std::size_t working_set, long steps, std::uint64_t& checksum)
+{
+    std::vector<void*> live(working_set);
+    for (void*& p : live)
+    {
+        p = Source::allocate();
+        static_cast<unsigned char*>(p)[0] = 0;
+    }
+    std::mt19937 rng(7);
+    std::vector<std::uint32_t> victims(static_cast<std::size_t>(steps));
+    for (std::uint32_t& v : victims)
+    {
+        v = static_cast<std::uint32_t>(rng() % working_set);
+    }
+    double ms = time_ms([&]() {
+        for (long s = 0; s < steps; ++s)
+        {
+            void*& slot = live[victims[static_cast<std::size_t>(s)]];
+            checksum += static_cast<unsigned char*>(slot)[0];
+            Source::deallocate(slot);
+            slot = Source::allocate();
+            static_cast<unsigned char*>(slot)[0] = static_cast<unsigned char>(s);
+        }
+    });
+    for (void* p : live)
+    {
+        Source::deallocate(p);
+    }
+    return ms * 1e6 / static_cast<double>(steps);
+}
+
+struct CrossThreadReport
+{
+    double ns_per_block;
+    std::size_t corrupted;
+};
+
+// Producers allocate and stamp blocks, consumers verify the stamp and free them, so every
+// block is freed on a thread that did not allocate it. A block handed out twice shows up
+// as a stamp that changed in flight.
+template<typename Source>
+CrossThreadReport cross_thread_free(int pairs, std::size_t blocks_per_producer, std::size_t batch)
+{
+    struct handoff
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::vector<void*>> batches;
+        int producers_left;
+    };
+    handoff queue;
+    queue.producers_left = pairs;
+    std::atomic<std::size_t> corrupted(0);
+
+    double ms = time_ms([&]() {
+        std::vector<std::thread> threads;
+        for (int p = 0; p < pairs; ++p)
+        {
+            threads.emplace_back([&, p]() {
+                std::uint64_t stamp = static_cast<std::uint64_t>(p) << 32;
+                for (std::size_t done = 0; done < blocks_per_producer; done += batch)
+                {
+                    std::vector<void*> out(batch);
+                    for (void*& block : out)
+                    {
+                        block = Source::allocate();
+                        *static_cast<std::uint64_t*>(block) = stamp;
+                        static_cast<std::uint64_t*>(block)[1] = ~stamp;
+                        ++stamp;
+                    }
+                    std::lock_guard<std::mutex> lock(queue.mutex);
+                    queue.batches.push_back(std::move(out));
+                    queue.ready.notify_one();
+                }
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                --queue.producers_left;
+                queue.ready.notify_all();
+            });
+        }
+        for (int c = 0; c < pairs; ++c)
+        {
+            threads.emplace_back([&]() {
+                for (;;)
+                {
+                    std::vector<void*> in;
+                    {
+                        std::unique_lock<std::mutex> lock(queue.mutex);
+                        queue.ready.wait(lock, [&]() { return !queue.batches.empty() || queue.producers_left == 0; });
+                        if (queue.batches.empty())
+                        {
+                            return;
+                        }
+                        in = std::move(queue.batches.front());
+                        queue.batches.pop_front();
+                    }
+                    for (void* block : in)
+                    {
+                        const std::uint64_t* words = static_cast<const std::uint64_t*>(block);
+                        if (words[1] != ~words[0])
+                        {
+                            corrupted.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        Source::deallocate(block);
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads)
+        {
+            t.join();
+        }
+    });
+    CrossThreadReport report;
+    report.ns_per_block = ms * 1e6 / (static_cast<double>(pairs) * static_cast<double>(blocks_per_producer));
+    report.corrupted = corrupted.load();
+    return report;
+}
+
+void run_fixed_pool_benchmark(std::size_t batch, int rounds, long steps, std::size_t cross_blocks)
+{
+    std::uint64_t checksum = 0;
+    double storm_malloc = storm_ns<malloc_source>(batch, rounds, checksum);
+    double storm_new = storm_ns<new_source>(batch, rounds, checksum);
+    double storm_pool = storm_ns<pool_source>(batch, rounds, checksum);
+    std::cout << "[ BENCH    ] alloc/free storm ns/pair (batch=" << batch << "): malloc=" << storm_malloc
+              << " new=" << storm_new << " fixed_pool=" << storm_pool << "\n";
+
+    double churn_malloc = churn_ns<malloc_source>(4096, steps, checksum);
+    double churn_new = churn_ns<new_source>(4096, steps, checksum);
+    double churn_pool = churn_ns<pool_source>(4096, steps, checksum);
+    std::cout << "[ BENCH    ] random churn ns/replacement (4096 live): malloc=" << churn_malloc
+              << " new=" << churn_new << " fixed_pool=" << churn_pool << "\n";
+
+    CrossThreadReport cross_malloc = cross_thread_free<malloc_source>(2, cross_blocks, 256);
+    CrossThreadReport cross_new = cross_thread_free<new_source>(2, cross_blocks, 256);
+    CrossThreadReport cross_pool = cross_thread_free<pool_source>(2, cross_blocks, 256);
+    std::cout << "[ BENCH    ] cross-thread free ns/block (2 producers, 2 consumers): malloc="
+              << cross_malloc.ns_per_block << " new=" << cross_new.ns_per_block
+              << " fixed_pool=" << cross_pool.ns_per_block << "\n";
+
+    EXPECT_GT(checksum, 0u);
+    EXPECT_EQ(cross_malloc.corrupted, 0u);
+    EXPECT_EQ(cross_new.corrupted, 0u);
+    EXPECT_EQ(cross_pool.corrupted, 0u);
+}
+
+TEST_F(PoolAllocatorsTest, FixedPoolBenchmark)
+{
+    run_fixed_pool_benchmark(10000, 20, 200000, 1 << 16);
+
+    // Q: glibc malloc also keeps per-thread caches (tcache) of small chunks. What does the
+    //    pool still save on each call, and where does that saving disappear?
+    // A:
+    // R:
+
+    // Q: In the cross-thread run, which thread's magazines end up holding the blocks, and
+    //    what does the depot do that a per-thread free list alone could not?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, DISABLED_FixedPoolBenchmarkLarge)
+{
+    run_fixed_pool_benchmark(1000000, 10, 20000000, 1 << 22);
+}
+
+// ============================================================================
+// Size-Class Allocator: Classes, Thread Caches, Spans, Direct Large Mappings
+// ============================================================================
+
+namespace detail
+{
+
+constexpr std::size_t kQuantum = 16;
+constexpr std::size_t kSmallMax = 16 * 1024;
+constexpr std::size_t kSizeClasses = 8 + 4 * 7;
+
+// jemalloc's spacing: every 16 bytes up to 128, then four classes per doubling, so rounding
+// a request up to its class wastes at most 20% once past the first few tiny classes.
+struct size_class_table
+{
+    std::array<std::uint32_t, kSizeClasses> size{};
+    std::array<std::uint8_t, kSmallMax / kQuantum + 1> by_quantum{};
+};
+
+constexpr size_class_table make_size_class_table()
+{
+    size_class_table table{};
+    std::size_t n = 0;
+    for (std::size_t s = kQuantum; s <= 128; s += kQuantum)
+    {
+        table.size[n++] = static_cast<std::uint32_t>(s);
+    }
+    for (std::size_t base = 128; base < kSmallMax; base *= 2)
+    {
+        for (std::size_t step = 1; step <= 4; ++step)
+        {
+            table.size[n++] = static_cast<std::uint32_t>(base + step * base / 4);
+        }
+    }
+    std::size_t cls = 0;
+    for (std::size_t q = 0; q <= kSmallMax / kQuantum; ++q)
+    {
+        while (table.size[cls] < q * kQuantum)
+        {
+            ++cls;
+        }
+        table.by_quantum[q] = static_cast<std::uint8_t>(cls);
+    }
+    return table;
+}
+
+constexpr size_class_table kSizeClassTable = make_size_class_table();
+
+constexpr std::size_t size_class_of(std::size_t bytes)
+{
+    return kSizeClassTable.by_quantum[(bytes + kQuantum - 1) / kQuantum];
+}
+
+constexpr std::size_t class_size(std::size_t cls)
+{
+    return kSizeClassTable.size[cls];
+}
+
+// A thread caches fewer large objects than small ones, so each class holds about as many
+// bytes in a thread's cache.
+constexpr std::uint32_t class_cache_limit(std::size_t cls)
+{
+    return static_cast<std::uint32_t>(std::max<std::size_t>(4, std::min<std::size_t>(64, 32 * 1024 / class_size(cls))));
+}
+
+constexpr std::size_t kSpanBytes = 256 * 1024;
+constexpr std::uint32_t kLargeClass = 0xffffffffu;
+
+// Sits at the start of every span and every large mapping. Both are kSpanBytes-aligned, so
+// masking an object's address finds its header, and deallocate() needs no size.
+struct span
+{
+    std::uint32_t size_class;
+    std::uint32_t capacity;
+    std::uint32_t in_use; // objects out of the span: with users or in thread caches
+    std::size_t mapped_bytes;
+    free_block* free;
+    char* bump;
+    span* prev;
+    span* next;
+};
+
+constexpr std::size_t kSpanHeader = round_up(sizeof(span), 64);
+
+inline span* span_of(const void* p)
+{
+    return reinterpret_cast<span*>(reinterpret_cast<std::uintptr_t>(p) & ~(kSpanBytes - 1));
+}
+
+} // namespace detail
+
+static_assert(detail::class_size(detail::kSizeClasses - 1) == detail::kSmallMax, "last class is the small limit");
+static_assert(detail::class_size(detail::size_class_of(1)) == 16, "");
+static_assert(detail::class_size(detail::size_class_of(129)) == 160, "");
+static_assert(detail::class_size(detail::size_class_of(5000)) == 5120, "");
+
+struct size_class_stats
+{
+    std::size_t mapped_bytes = 0;       // spans plus large mappings
+    std::size_t touched_bytes = 0;      // span headers, carved objects, large mappings
+    std::size_t peak_touched_bytes = 0; // since the last reset_peak()
+    std::size_t spans = 0;
+    std::size_t large_allocations = 0;
+    std::size_t large_bytes = 0;
+};
+
+struct size_class_bin_stats
+{
+    std::size_t spans = 0;  // spans owned by the class's bin, empty ones included
+    std::size_t in_use = 0; // objects handed out of the bin, thread caches included
+};
+
+// Requests up to 16 KiB are rounded to a size class and served from the calling thread's
+// per-class cache; a cache refills and drains half its limit at a time against the class's
+// bin, which carves objects from 256 KiB spans. An emptied span goes back to the OS unless it
+// is the bin's last. Anything larger is mapped on its own and unmapped on free.
+class size_class_allocator
+{
+public:
+    static size_class_allocator& instance()
+    {
+        static size_class_allocator allocator;
+        return allocator;
+    }
+
+    size_class_allocator(const size_class_allocator&) = delete;
+    size_class_allocator& operator=(const size_class_allocator&) = delete;
+
+    void* allocate(std::size_t bytes)
+    {
+        if (bytes > detail::kSmallMax)
+        {
+            return allocate_large(bytes);
+        }
+        std::size_t cls = detail::size_class_of(bytes);
+        thread_cache* cache = local_cache();
+        if (cache == nullptr)
+        {
+            return fill(cls, 1).pop();
+        }
+        detail::magazine& bin = cache->bins[cls];
+        if (bin.count == 0)
+        {
+            bin = fill(cls, detail::class_cache_limit(cls) / 2);
+        }
+        return bin.pop();
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (p == nullptr)
+        {
+            return;
+        }
+        detail::span* s = detail::span_of(p);
+        if (s->size_class == detail::kLargeClass)
+        {
+            deallocate_large(s);
+            return;
+        }
+        std::size_t cls = s->size_class;
+        detail::free_block* block = static_cast<detail::free_block*>(p);
+        thread_cache* cache = local_cache();
+        if (cache == nullptr)
+        {
+            detail::magazine single;
+            single.push(block);
+            drain(cls, single);
+            return;
+        }
+        detail::magazine& bin = cache->bins[cls];
+        std::uint32_t limit = detail::class_cache_limit(cls);
+        if (bin.count == limit)
+        {
+            drain(cls, bin.split(limit / 2));
+        }
+        bin.push(block);
+    }
+
+    static std::size_t usable_size(const void* p)
+    {
+        const detail::span* s = detail::span_of(p);
+        return s->size_class == detail::kLargeClass ? s->mapped_bytes - detail::kSpanHeader
+                                                    : detail::class_size(s->size_class);
+    }
+
+    void flush_thread_cache()
+    {
+        if (thread_cache* cache = local_cache())
+        {
+            cache->flush(*this);
+        }
+    }
+
+    size_class_stats stats() const
+    {
+        size_class_stats s;
+        s.mapped_bytes = mapped_bytes_.load(std::memory_order_relaxed);
+        s.touched_bytes = touched_bytes_.load(std::memory_order_relaxed);
+        s.peak_touched_bytes = peak_touched_bytes_.load(std::memory_order_relaxed);
+        s.spans = spans_.load(std::memory_order_relaxed);
+        s.large_allocations = large_allocations_.load(std::memory_order_relaxed);
+        s.large_bytes = large_bytes_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    size_class_bin_stats class_stats(std::size_t cls) const
+    {
+        std::lock_guard<std::mutex> lock(bins_[cls].mutex);
+        size_class_bin_stats s;
+        s.spans = bins_[cls].spans;
+        s.in_use = bins_[cls].in_use;
+        return s;
+    }
+
+    void reset_peak()
+    {
+        peak_touched_bytes_.store(touched_bytes_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    // Writes one EventLog line per class with spans and one for the totals. EventLog is not
+    // thread-safe, so call it from one thread, between workloads.
+    void publish_stats() const
+    {
+        for (std::size_t cls = 0; cls < detail::kSizeClasses; ++cls)
+        {
+            size_class_bin_stats bin = class_stats(cls);
+            if (bin.spans != 0)
+            {
+                std::ostringstream oss;
+                oss << "SizeClassAllocator::class size=" << detail::class_size(cls) << " spans=" << bin.spans
+                    << " in_use=" << bin.in_use;
+                EventLog::instance().record(oss.str());
+            }
+        }
+        size_class_stats s = stats();
+        std::ostringstream oss;
+        oss << "SizeClassAllocator::totals mapped_bytes=" << s.mapped_bytes << " touched_bytes=" << s.touched_bytes
+            << " peak_touched_bytes=" << s.peak_touched_bytes << " spans=" << s.spans
+            << " large_allocations=" << s.large_allocations << " large_bytes=" << s.large_bytes;
+        EventLog::instance().record(oss.str());
+    }
+
+private:
+    struct alignas(64) bin
+    {
+        mutable std::mutex mutex;
+        detail::span* partial = nullptr; // spans with a free object, most recently used first
+        std::size_t spans = 0;
+        std::size_t in_use = 0;
+    };
+
+    struct thread_cache
+    {
+        std::array<detail::magazine, detail::kSizeClasses> bins;
+
+        ~thread_cache()
+        {
+            flush(instance());
+        }
+
+        void flush(size_class_allocator& allocator)
+        {
+            for (std::size_t cls = 0; cls < bins.size(); ++cls)
+            {
+                if (bins[cls].count != 0)
+                {
+                    allocator.drain(cls, bins[cls]);
+                    bins[cls] = detail::magazine();
+                }
+            }
+        }
+    };
+
+    size_class_allocator() = default;
+
+    static thread_cache* local_cache()
+    {
+        return detail::thread_cache_slot<thread_cache>::get();
+    }
+
+    detail::magazine fill(std::size_t cls, std::uint32_t wanted)
+    {
+        bin& b = bins_[cls];
+        std::lock_guard<std::mutex> lock(b.mutex);
+        detail::magazine out;
+        while (out.count < wanted)
+        {
+            detail::span* s = b.partial;
+            if (s == nullptr)
+            {
+                s = open_span(cls);
+                link(b, s);
+            }
+            if (s->free != nullptr)
+            {
+                detail::free_block* block = s->free;
+                s->free = block->next;
+                out.push(block);
+            }
+            else
+            {
+                // Carving lazily keeps a span's untouched tail out of the resident set.
+                out.push(reinterpret_cast<detail::free_block*>(s->bump));
+                s->bump += detail::class_size(cls);
+                note_touched(detail::class_size(cls));
+            }
+            if (++s->in_use == s->capacity)
+            {
+                unlink(b, s);
+            }
+        }
+        b.in_use += out.count;
+        return out;
+    }
+
+    void drain(std::size_t cls, detail::magazine blocks)
+    {
+        bin& b = bins_[cls];
+        std::lock_guard<std::mutex> lock(b.mutex);
+        b.in_use -= blocks.count;
+        while (blocks.count != 0)
+        {
+            detail::free_block* block = blocks.pop();
+            detail::span* s = detail::span_of(block);
+            if (s->in_use-- == s->capacity)
+            {
+                link(b, s);
+            }
+            block->next = s->free;
+            s->free = block;
+            if (s->in_use == 0 && (s->prev != nullptr || s->next != nullptr))
+            {
+                unlink(b, s);
+                close_span(b, s);
+            }
+        }
+    }
+
+    detail::span* open_span(std::size_t cls)
+    {
+        void* base = detail::map_pages(detail::kSpanBytes, detail::kSpanBytes);
+        detail::span* s = static_cast<detail::span*>(base);
+        s->size_class = static_cast<std::uint32_t>(cls);
+        s->capacity = static_cast<std::uint32_t>((detail::kSpanBytes - detail::kSpanHeader) / detail::class_size(cls));
+        s->in_use = 0;
+        s->mapped_bytes = detail::kSpanBytes;
+        s->free = nullptr;
+        s->bump = static_cast<char*>(base) + detail::kSpanHeader;
+        s->prev = s->next = nullptr;
+        ++bins_[cls].spans;
+        spans_.fetch_add(1, std::memory_order_relaxed);
+        mapped_bytes_.fetch_add(detail::kSpanBytes, std::memory_order_relaxed);
+        note_touched(detail::kSpanHeader);
+        return s;
+    }
+
+    void close_span(bin& b, detail::span* s)
+    {
+        std::size_t touched = static_cast<std::size_t>(s->bump - reinterpret_cast<char*>(s));
+        --b.spans;
+        spans_.fetch_sub(1, std::memory_order_relaxed);
+        touched_bytes_.fetch_sub(touched, std::memory_order_relaxed);
+        mapped_bytes_.fetch_sub(detail::kSpanBytes, std::memory_order_relaxed);
+        detail::unmap_pages(s, detail::kSpanBytes, detail::kSpanBytes);
+    }
+
+    static void link(bin& b, detail::span* s)
+    {
+        s->prev = nullptr;
+        s->next = b.partial;
+        if (b.partial != nullptr)
+        {
+            b.partial->prev = s;
+        }
+        b.partial = s;
+    }
+
+    static void unlink(bin& b, detail::span* s)
+    {
+        if (s->prev != nullptr)
+        {
+            s->prev->next = s->next;
+        }
+        else
+        {
+            b.partial = s->next;
+        }
+        if (s->next != nullptr)
+        {
+            s->next->prev = s->prev;
+        }
+        s->prev = s->next = nullptr;
+    }
+
+    void* allocate_large(std::size_t bytes)
+    {
+        std::size_t mapped = detail::round_up(detail::kSpanHeader + bytes, 4096);
+        void* base = detail::map_pages(mapped, detail::kSpanBytes);
+        detail::span* s = static_cast<detail::span*>(base);
+        s->size_class = detail::kLargeClass;
+        s->mapped_bytes = mapped;
+        large_allocations_.fetch_add(1, std::memory_order_relaxed);
+        large_bytes_.fetch_add(mapped, std::memory_order_relaxed);
+        mapped_bytes_.fetch_add(mapped, std::memory_order_relaxed);
+        note_touched(mapped);
+        return static_cast<char*>(base) + detail::kSpanHeader;
+    }
+
+    void deallocate_large(detail::span* s)
+    {
+        std::size_t mapped = s->mapped_bytes;
+        large_allocations_.fetch_sub(1, std::memory_order_relaxed);
+        large_bytes_.fetch_sub(mapped, std::memory_order_relaxed);
+        touched_bytes_.fetch_sub(mapped, std::memory_order_relaxed);
+        mapped_bytes_.fetch_sub(mapped, std::memory_order_relaxed);
+        detail::unmap_pages(s, mapped, detail::kSpanBytes);
+    }
+
+    void note_touched(std::size_t bytes)
+    {
+        std::size_t now = touched_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        std::size_t peak = peak_touched_bytes_.load(std::memory_order_relaxed);
+        while (now > peak && !peak_touched_bytes_.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::array<bin, detail::kSizeClasses> bins_;
+    std::atomic<std::size_t> mapped_bytes_{0};
+    std::atomic<std::size_t> touched_bytes_{0};
+    std::atomic<std::size_t> peak_touched_bytes_{0};
+    std::atomic<std::size_t> spans_{0};
+    std::atomic<std::size_t> large_allocations_{0};
+    std::atomic<std::size_t> large_bytes_{0};
+};
+
+TEST_F(PoolAllocatorsTest, SizeClassTableBoundsRoundingWaste)
+{
+    for (std::size_t bytes = 1; bytes <= detail::kSmallMax; ++bytes)
+    {
+        std::size_t cls = detail::size_class_of(bytes);
+        ASSERT_GE(detail::class_size(cls), bytes);
+        if (cls > 0)
+        {
+            ASSERT_LT(detail::class_size(cls - 1), bytes);
+        }
+    }
+
+    double worst = 0.0;
+    for (std::size_t cls = 8; cls < detail::kSizeClasses; ++cls)
+    {
+        double gap = static_cast<double>(detail::class_size(cls) - detail::class_size(cls - 1));
+        worst = std::max(worst, gap / static_cast<double>(detail::class_size(cls)));
+    }
+    EXPECT_LE(worst, 0.2);
+
+    // Q: 36 classes cover 1..16384 bytes. What would one class per power of two cost in
+    //    rounding waste, and what would a class every 16 bytes cost instead?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, SizeClassAllocatorServesSmallRequestsFromSpans)
+{
+    size_class_allocator& allocator = size_class_allocator::instance();
+    const std::size_t sizes[] = {1, 16, 17, 100, 129, 1000, 5000, 16384};
+
+    std::vector<void*> blocks;
+    for (std::size_t bytes : sizes)
+    {
+        void* p = allocator.allocate(bytes);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % 16, 0u);
+        EXPECT_EQ(size_class_allocator::usable_size(p), detail::class_size(detail::size_class_of(bytes)));
+        std::fill_n(static_cast<unsigned char*>(p), bytes, static_cast<unsigned char>(bytes));
+        blocks.push_back(p);
+    }
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+    {
+        EXPECT_EQ(static_cast<unsigned char*>(blocks[i])[sizes[i] - 1], static_cast<unsigned char>(sizes[i]));
+    }
+
+    // A freed block sits in this thread's cache for its class and comes straight back.
+    allocator.deallocate(blocks[3]);
+    EXPECT_EQ(allocator.allocate(112), blocks[3]);
+    EXPECT_EQ(detail::span_of(blocks[3])->size_class, detail::size_class_of(100));
+
+    for (void* p : blocks)
+    {
+        allocator.deallocate(p);
+    }
+
+    // Q: deallocate() takes no size. How does the span header answer "which class?", and
+    //    why does that force every span to start on a kSpanBytes boundary?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, SizeClassAllocatorMapsLargeRequestsDirectly)
+{
+    size_class_allocator& allocator = size_class_allocator::instance();
+    size_class_stats before = allocator.stats();
+
+    const std::size_t bytes = 1 << 20;
+    char* p = static_cast<char*>(allocator.allocate(bytes));
+    p[0] = 'a';
+    p[bytes - 1] = 'z';
+    EXPECT_GE(size_class_allocator::usable_size(p), bytes);
+
+    size_class_stats during = allocator.stats();
+    EXPECT_EQ(during.large_allocations, before.large_allocations + 1);
+    EXPECT_GE(during.large_bytes - before.large_bytes, bytes);
+    EXPECT_EQ(during.spans, before.spans);
+
+    allocator.deallocate(p);
+    size_class_stats after = allocator.stats();
+    EXPECT_EQ(after.large_allocations, before.large_allocations);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes);
+}
+
+TEST_F(PoolAllocatorsTest, SizeClassAllocatorReturnsEmptySpansAcrossThreads)
+{
+    size_class_allocator& allocator = size_class_allocator::instance();
+    const std::size_t bytes = 3000;
+    const std::size_t cls = detail::size_class_of(bytes);
+    // The allocator is process-wide, so every check is a delta against what earlier tests
+    // (in whatever order they ran) left behind, taken once this thread's cache is empty.
+    allocator.flush_thread_cache();
+    std::size_t spans_before = allocator.stats().spans;
+    size_class_bin_stats class_before = allocator.class_stats(cls);
+
+    // Worker threads allocate, this thread frees: the blocks travel back to their spans
+    // through this thread's cache, and the worker caches flush on exit.
+    std::vector<void*> blocks(400);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < 2; ++w)
+    {
+        workers.emplace_back([&, w]() {
+            for (std::size_t i = static_cast<std::size_t>(w); i < blocks.size(); i += 2)
+            {
+                blocks[i] = allocator.allocate(bytes);
+                static_cast<char*>(blocks[i])[0] = 1;
+            }
+        });
+    }
+    for (std::thread& t : workers)
+    {
+        t.join();
+    }
+    EXPECT_GE(allocator.stats().spans, spans_before + blocks.size() / 85);
+    size_class_bin_stats class_busy = allocator.class_stats(cls);
+    EXPECT_EQ(class_busy.in_use - class_before.in_use, blocks.size());
+    EXPECT_GE(class_busy.spans - class_before.spans, blocks.size() / 85);
+
+    for (void* p : blocks)
+    {
+        allocator.deallocate(p);
+    }
+    allocator.flush_thread_cache();
+    EXPECT_LE(allocator.stats().spans, spans_before + 1);
+
+    // Every block is back and the emptied spans are gone, bar the one empty span a bin keeps.
+    size_class_bin_stats class_after = allocator.class_stats(cls);
+    EXPECT_EQ(class_after.in_use, class_before.in_use);
+    EXPECT_LE(class_after.spans, std::max<std::size_t>(class_before.spans, 1));
+
+    allocator.publish_stats();
+    EXPECT_EQ(EventLog::instance().count_events("SizeClassAllocator::class size=3072 "), 1u);
+    EXPECT_EQ(EventLog::instance().count_events("SizeClassAllocator::totals"), 1u);
+
+    // Q: The bin keeps its last empty span instead of unmapping it. What allocation pattern
+    //    would map and unmap a span on every call without that rule?
+    // A:
+    // R:
+}
+
+// ============================================================================
+// Size-Class Allocator Benchmark: Replaying a Recorded Trace
+// ============================================================================
+
+struct trace_event
+{
+    std::uint32_t id;
+    std::uint32_t bytes;
+    bool is_free;
+};
+
+// Every allocation and free that went through a recording_allocator, with pointers replaced
+// by dense ids so a replay can keep its live blocks in a plain vector.
+class allocation_trace
+{
+public:
+    void on_allocate(void* p, std::size_t bytes)
+    {
+        ids_[p] = static_cast<std::uint32_t>(sizes_.size());
+        events_.push_back(trace_event{static_cast<std::uint32_t>(sizes_.size()), static_cast<std::uint32_t>(bytes), false});
+        sizes_.push_back(static_cast<std::uint32_t>(bytes));
+    }
+
+    void on_deallocate(void* p)
+    {
+        auto it = ids_.find(p);
+        events_.push_back(trace_event{it->second, sizes_[it->second], true});
+        ids_.erase(it);
+    }
+
+    const std::vector<trace_event>& events() const
+    {
+        return events_;
+    }
+
+    std::size_t objects() const
+    {
+        return sizes_.size();
+    }
+
+    // Requested bytes live at the worst point of the trace, raw and rounded to size classes.
+    std::pair<std::size_t, std::size_t> peak_live_bytes() const
+    {
+        std::size_t live = 0;
+        std::size_t rounded = 0;
+        std::size_t peak = 0;
+        std::size_t peak_rounded = 0;
+        for (const trace_event& e : events_)
+        {
+            std::size_t size = e.bytes;
+            std::size_t size_rounded = size > detail::kSmallMax ? size : detail::class_size(detail::size_class_of(size));
+            live = e.is_free ? live - size : live + size;
+            rounded = e.is_free ? rounded - size_rounded : rounded + size_rounded;
+            if (live > peak)
+            {
+                peak = live;
+                peak_rounded = rounded;
+            }
+        }
+        return {peak, peak_rounded};
+    }
+
+private:
+    std::unordered_map<void*, std::uint32_t> ids_;
+    std::vector<std::uint32_t> sizes_;
+    std::vector<trace_event> events_;
+};
+
+template<typename T>
+class recording_allocator
+{
+public:
+    using value_type = T;
+
+    explicit recording_allocator(allocation_trace* trace) noexcept
+    : trace_(trace)
+    {
+    }
+
+    template<typename U>
+    recording_allocator(const recording_allocator<U>& other) noexcept
+    : trace_(other.trace())
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        void* p = ::operator new(n * sizeof(T));
+        trace_->on_allocate(p, n * sizeof(T));
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        trace_->on_deallocate(p);
+        ::operator delete(p);
+    }
+
+    allocation_trace* trace() const noexcept
+    {
+        return trace_;
+    }
+
+private:
+    allocation_trace* trace_;
+};
+
+template<typename T, typename U>
+bool operator==(const recording_allocator<T>& a, const recording_allocator<U>& b) noexcept
+{
+    return a.trace() == b.trace();
+}
+
+template<typename T, typename U>
+bool operator!=(const recording_allocator<T>& a, const recording_allocator<U>& b) noexcept
+{
+    return !(a == b);
+}
+
+// The shape of the shared_ptr suites' workloads: each session allocate_shared's Tracked
+// objects, indexes them by id through weak_ptrs, builds a few request payloads, creates
+// short-lived temporaries, and then drops a random half of what it kept.
+allocation_trace record_tracked_workload(int sessions, int objects_per_session)
+{
+    allocation_trace trace;
+    {
+        recording_allocator<char> alloc(&trace);
+        using handle = std::shared_ptr<Tracked>;
+        std::vector<handle, recording_allocator<handle>> handles(alloc);
+        std::map<int, std::weak_ptr<Tracked>, std::less<int>,
+                 recording_allocator<std::pair<const int, std::weak_ptr<Tracked>>>>
+            index(alloc);
+        std::vector<std::vector<char, recording_allocator<char>>> payloads;
+        std::mt19937 rng(42);
+        int next_id = 0;
+
+        for (int s = 0; s < sessions; ++s)
+        {
+            for (int i = 0; i < objects_per_session; ++i)
+            {
+                handles.push_back(std::allocate_shared<Tracked>(alloc, "Trace"));
+                index.emplace(next_id++, handles.back());
+                if (rng() % 3 == 0)
+                {
+                    handle temporary = std::allocate_shared<Tracked>(alloc, "Temp");
+                }
+                if (rng() % 50 == 0)
+                {
+                    std::size_t payload = rng() % 8 == 0 ? 64 * 1024 + rng() % (256 * 1024) : 64 + rng() % 8192;
+                    payloads.emplace_back(payload, 'p', alloc);
+                }
+            }
+
+            std::shuffle(handles.begin(), handles.end(), rng);
+            handles.resize(handles.size() / 2);
+            for (auto it = index.begin(); it != index.end();)
+            {
+                it = it->second.expired() ? index.erase(it) : std::next(it);
+            }
+            if (payloads.size() > 16)
+            {
+                payloads.erase(payloads.begin(), payloads.begin() + static_cast<std::ptrdiff_t>(payloads.size() / 2));
+            }
+        }
+    }
+    EventLog::instance().clear();
+    return trace;
+}
+
+struct malloc_sized_source
+{
+    static void* allocate(std::size_t bytes)
+    {
+        return std::malloc(bytes);
+    }
+
+    static void deallocate(void* p)
+    {
+        std::free(p);
+    }
+};
+
+struct size_class_source
+{
+    static void* allocate(std::size_t bytes)
+    {
+        return size_class_allocator::instance().allocate(bytes);
+    }
+
+    static void deallocate(void* p)
+    {
+        size_class_allocator::instance().deallocate(p);
+    }
+};
+
+// ns per trace event; each allocation writes its first byte so the block is really touched.
+template<typename Source>
+double replay_ns(const allocation_trace& trace, int rounds, std::uint64_t& checksum)
+{
+    std::vector<void*> blocks(trace.objects());
+    double ms = time_ms([&]() {
+        for (int r = 0; r < rounds; ++r)
+        {
+            for (const trace_event& e : trace.events())
+            {
+                if (e.is_free)
+                {
+                    checksum += static_cast<unsigned char*>(blocks[e.id])[0];
+                    Source::deallocate(blocks[e.id]);
+                }
+                else
+                {
+                    blocks[e.id] = Source::allocate(e.bytes);
+                    static_cast<unsigned char*>(blocks[e.id])[0] = static_cast<unsigned char>(e.id);
+                }
+            }
+        }
+    });
+    return ms * 1e6 / (static_cast<double>(trace.events().size()) * rounds);
+}
+
+void run_size_class_benchmark(int sessions, int objects_per_session, int rounds)
+{
+    allocation_trace trace = record_tracked_workload(sessions, objects_per_session);
+    std::pair<std::size_t, std::size_t> peak = trace.peak_live_bytes();
+
+    size_class_allocator& allocator = size_class_allocator::instance();
+    allocator.flush_thread_cache();
+    std::size_t touched_before = allocator.stats().touched_bytes;
+    allocator.reset_peak();
+
+    std::uint64_t checksum = 0;
+    double malloc_ns = replay_ns<malloc_sized_source>(trace, rounds, checksum);
+    double size_class_ns = replay_ns<size_class_source>(trace, rounds, checksum);
+    std::size_t touched_peak = allocator.stats().peak_touched_bytes - touched_before;
+
+    std::cout << "[ BENCH    ] trace replay (" << trace.events().size() << " events, " << trace.objects()
+              << " allocations) ns/event: malloc=" << malloc_ns << " size_class=" << size_class_ns << "\n";
+    std::cout << "[ BENCH    ] peak live bytes: requested=" << peak.first << " rounded_to_classes=" << peak.second
+              << " size_class_touched=" << touched_peak << " internal_waste="
+              << 1.0 - static_cast<double>(peak.first) / static_cast<double>(peak.second)
+              << " total_overhead=" << static_cast<double>(touched_peak) / static_cast<double>(peak.first) << "x\n";
+
+    allocator.publish_stats();
+    EXPECT_EQ(EventLog::instance().count_events("SizeClassAllocator::totals"), 1u);
+    EXPECT_GT(checksum, 0u);
+    EXPECT_GE(peak.second, peak.first);
+    EXPECT_GT(touched_peak, 0u);
+}
+
+TEST_F(PoolAllocatorsTest, SizeClassAllocatorTraceReplayBenchmark)
+{
+    run_size_class_benchmark(20, 500, 5);
+
+    // Q: total_overhead compares touched bytes with requested bytes at the peak. Which part
+    //    is rounding to classes, and which is spans carved for a class that later went quiet?
+    // A:
+    // R:
+
+    // Q: The replay frees blocks on the thread that allocated them. Which cost from the
+    //    cross-thread fixed_pool benchmark does this trace therefore never pay?
+    // A:
+    // R:
+}
+
+TEST_F(PoolAllocatorsTest, DISABLED_SizeClassAllocatorTraceReplayBenchmarkLarge)
+{
+    run_size_class_benchmark(200, 5000, 5);
+}
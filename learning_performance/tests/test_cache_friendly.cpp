@@ -2,8 +2,629 @@
 // Estimated Time: 4 hours
 // Difficulty: Hard
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
 
-// TODO: Implement test cases for cache-friendly layouts
 // TODO: Implement test cases for data-oriented design
-// TODO: Implement test cases for cache performance measurement
+
+class CacheFriendlyTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// Matrix Transpose and Multiply: Naive, Blocked, Cache-Oblivious
+// ============================================================================
+
+// Row-major rows x cols matrices in flat vectors; dst is cols x rows.
+void naive_transpose(const double* src, double* dst, std::size_t rows, std::size_t cols)
+{
+    for (std::size_t r = 0; r < rows; ++r)
+    {
+        for (std::size_t c = 0; c < cols; ++c)
+        {
+            dst[c * rows + r] = src[r * cols + c];
+        }
+    }
+}
+
+// Either the reads or the writes of the naive loop stride by a whole row. Working in
+// block x block tiles keeps the block lines of both sides resident while a tile is done;
+// 32 doubles = 4 lines per tile row, 2 x 8 KB per tile, comfortably inside L1.
+void blocked_transpose(const double* src, double* dst, std::size_t rows, std::size_t cols, std::size_t block = 32)
+{
+    for (std::size_t r0 = 0; r0 < rows; r0 += block)
+    {
+        std::size_t r1 = std::min(rows, r0 + block);
+        for (std::size_t c0 = 0; c0 < cols; c0 += block)
+        {
+            std::size_t c1 = std::min(cols, c0 + block);
+            for (std::size_t r = r0; r < r1; ++r)
+            {
+                for (std::size_t c = c0; c < c1; ++c)
+                {
+                    dst[c * rows + r] = src[r * cols + c];
+                }
+            }
+        }
+    }
+}
+
+namespace detail
+{
+
+constexpr std::size_t kObliviousLeaf = 16;
+
+void oblivious_transpose(const double* src, double* dst, std::size_t rows, std::size_t cols, std::size_t r0,
+                         std::size_t r1, std::size_t c0, std::size_t c1)
+{
+    std::size_t height = r1 - r0;
+    std::size_t width = c1 - c0;
+    if (height <= kObliviousLeaf && width <= kObliviousLeaf)
+    {
+        for (std::size_t r = r0; r < r1; ++r)
+        {
+            for (std::size_t c = c0; c < c1; ++c)
+            {
+                dst[c * rows + r] = src[r * cols + c];
+            }
+        }
+    }
+    else if (height >= width)
+    {
+        std::size_t mid = r0 + height / 2;
+        oblivious_transpose(src, dst, rows, cols, r0, mid, c0, c1);
+        oblivious_transpose(src, dst, rows, cols, mid, r1, c0, c1);
+    }
+    else
+    {
+        std::size_t mid = c0 + width / 2;
+        oblivious_transpose(src, dst, rows, cols, r0, r1, c0, mid);
+        oblivious_transpose(src, dst, rows, cols, r0, r1, mid, c1);
+    }
+}
+
+} // namespace detail
+
+// Halves the longer side until tiles are tiny. Some level of the recursion fits every
+// cache level at once, so there is no block size to tune per machine.
+void cache_oblivious_transpose(const double* src, double* dst, std::size_t rows, std::size_t cols)
+{
+    detail::oblivious_transpose(src, dst, rows, cols, 0, rows, 0, cols);
+}
+
+// C = A * B for n x n matrices, i-j-k order: the inner loop walks a column of B.
+void naive_multiply(const double* a, const double* b, double* c, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            double sum = 0.0;
+            for (std::size_t k = 0; k < n; ++k)
+            {
+                sum += a[i * n + k] * b[k * n + j];
+            }
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+// Tiles of A, B and C small enough to stay cached together (3 x 64 x 64 doubles = 96 KB
+// targets L2), and i-k-j order inside a tile so the innermost loop streams rows of B
+// and C with unit stride.
+void blocked_multiply(const double* a, const double* b, double* c, std::size_t n, std::size_t block = 64)
+{
+    std::fill(c, c + n * n, 0.0);
+    for (std::size_t i0 = 0; i0 < n; i0 += block)
+    {
+        std::size_t i1 = std::min(n, i0 + block);
+        for (std::size_t k0 = 0; k0 < n; k0 += block)
+        {
+            std::size_t k1 = std::min(n, k0 + block);
+            for (std::size_t j0 = 0; j0 < n; j0 += block)
+            {
+                std::size_t j1 = std::min(n, j0 + block);
+                for (std::size_t i = i0; i < i1; ++i)
+                {
+                    for (std::size_t k = k0; k < k1; ++k)
+                    {
+                        double aik = a[i * n + k];
+                        for (std::size_t j = j0; j < j1; ++j)
+                        {
+                            c[i * n + j] += aik * b[k * n + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+std::vector<double> make_matrix(std::size_t rows, std::size_t cols, std::uint32_t seed)
+{
+    std::vector<double> m(rows * cols);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (auto& v : m)
+    {
+        v = dist(rng);
+    }
+    return m;
+}
+
+TEST_F(CacheFriendlyTest, TransposesAgreeOnRectangularShapes)
+{
+    for (auto shape : {std::make_pair(1, 1), std::make_pair(37, 53), std::make_pair(64, 64), std::make_pair(100, 7),
+                       std::make_pair(3, 300)})
+    {
+        std::size_t rows = static_cast<std::size_t>(shape.first);
+        std::size_t cols = static_cast<std::size_t>(shape.second);
+        std::vector<double> src = make_matrix(rows, cols, 1);
+        std::vector<double> expected(rows * cols);
+        std::vector<double> blocked(rows * cols);
+        std::vector<double> oblivious(rows * cols);
+
+        naive_transpose(src.data(), expected.data(), rows, cols);
+        blocked_transpose(src.data(), blocked.data(), rows, cols, 16);
+        cache_oblivious_transpose(src.data(), oblivious.data(), rows, cols);
+        EXPECT_EQ(blocked, expected) << rows << "x" << cols;
+        EXPECT_EQ(oblivious, expected) << rows << "x" << cols;
+    }
+}
+
+TEST_F(CacheFriendlyTest, BlockedMultiplyMatchesNaive)
+{
+    const std::size_t n = 67;
+    std::vector<double> a = make_matrix(n, n, 2);
+    std::vector<double> b = make_matrix(n, n, 3);
+    std::vector<double> expected(n * n);
+    std::vector<double> blocked(n * n);
+
+    naive_multiply(a.data(), b.data(), expected.data(), n);
+    blocked_multiply(a.data(), b.data(), blocked.data(), n, 16);
+    for (std::size_t i = 0; i < n * n; ++i)
+    {
+        ASSERT_NEAR(blocked[i], expected[i], 1e-9) << "at " << i;
+    }
+}
+
+void run_matrix_benchmarks(std::size_t transpose_n, std::size_t multiply_n)
+{
+    std::vector<double> src = make_matrix(transpose_n, transpose_n, 4);
+    std::vector<double> dst(src.size());
+    double naive_ms = time_ms([&]() { naive_transpose(src.data(), dst.data(), transpose_n, transpose_n); });
+    double blocked_ms = time_ms([&]() { blocked_transpose(src.data(), dst.data(), transpose_n, transpose_n); });
+    double oblivious_ms = time_ms([&]() { cache_oblivious_transpose(src.data(), dst.data(), transpose_n, transpose_n); });
+    std::cout << "[ BENCH    ] transpose n=" << transpose_n << " naive_ms=" << naive_ms << " blocked_ms=" << blocked_ms
+              << " oblivious_ms=" << oblivious_ms << "\n";
+
+    std::vector<double> a = make_matrix(multiply_n, multiply_n, 5);
+    std::vector<double> b = make_matrix(multiply_n, multiply_n, 6);
+    std::vector<double> c(a.size());
+    naive_ms = time_ms([&]() { naive_multiply(a.data(), b.data(), c.data(), multiply_n); });
+    blocked_ms = time_ms([&]() { blocked_multiply(a.data(), b.data(), c.data(), multiply_n); });
+    std::cout << "[ BENCH    ] multiply n=" << multiply_n << " naive_ms=" << naive_ms << " blocked_ms=" << blocked_ms
+              << "\n";
+}
+
+TEST_F(CacheFriendlyTest, MatrixKernelBenchmark)
+{
+    // Q: A 1024 x 1024 double matrix has rows of exactly 8 KB. Why does the naive transpose get much
+    //    slower at this power-of-two size than at 1000 or 1030, and which of the other two cares less?
+    // A:
+    // R:
+
+    run_matrix_benchmarks(512, 128);
+}
+
+TEST_F(CacheFriendlyTest, DISABLED_MatrixKernelBenchmarkLarge)
+{
+    for (std::size_t n : {1000, 1024, 2048, 4096})
+    {
+        run_matrix_benchmarks(n, n / 4);
+    }
+}
+
+// ============================================================================
+// Eytzinger Layout Search
+// ============================================================================
+
+// A sorted array stored in BFS order of the implicit binary search tree (node k has
+// children 2k and 2k+1). The first levels share a handful of lines, and the next
+// children of a node are adjacent, so four levels ahead fit one prefetched line.
+// lower_bound() answers in sorted positions, making it a drop-in for std::lower_bound
+// over an existing lookup table whose payload stays in sorted order.
+template<typename T>
+class eytzinger_array
+{
+public:
+    // [first, last) must be sorted.
+    template<typename It>
+    eytzinger_array(It first, It last)
+    {
+        std::vector<T> sorted(first, last);
+        size_ = sorted.size();
+        keys_.resize(size_ + 1);
+        ranks_.resize(size_ + 1);
+        build(sorted, 0, 1);
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    // Same as std::lower_bound(sorted.begin(), sorted.end(), key) - sorted.begin().
+    std::size_t lower_bound(const T& key) const
+    {
+        std::size_t k = node_lower_bound(key);
+        return k == 0 ? size_ : ranks_[k];
+    }
+
+    bool contains(const T& key) const
+    {
+        std::size_t k = node_lower_bound(key);
+        return k != 0 && !(key < keys_[k]);
+    }
+
+private:
+    // Descend without branching on the comparison, then undo the final run of right
+    // turns: the answer is the last node where we went left.
+    std::size_t node_lower_bound(const T& key) const
+    {
+        std::size_t k = 1;
+        while (k <= size_)
+        {
+#if defined(__GNUC__)
+            // 16 levels-of-4 descendants of k start at 16k; may point past the end, which
+            // is harmless for a prefetch, so compute the address without pointer arithmetic.
+            __builtin_prefetch(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(keys_.data()) +
+                                                             16 * k * sizeof(T)));
+#endif
+            k = 2 * k + static_cast<std::size_t>(keys_[k] < key);
+        }
+        return k >> (count_trailing_ones(k) + 1);
+    }
+
+    static unsigned count_trailing_ones(std::size_t k)
+    {
+        unsigned ones = 0;
+        while (k & 1)
+        {
+            ++ones;
+            k >>= 1;
+        }
+        return ones;
+    }
+
+    std::size_t build(const std::vector<T>& sorted, std::size_t i, std::size_t k)
+    {
+        if (k <= size_)
+        {
+            i = build(sorted, i, 2 * k);
+            keys_[k] = sorted[i];
+            ranks_[k] = i;
+            ++i;
+            i = build(sorted, i, 2 * k + 1);
+        }
+        return i;
+    }
+
+    std::vector<T> keys_; // index 0 unused
+    std::vector<std::size_t> ranks_;
+    std::size_t size_ = 0;
+};
+
+TEST_F(CacheFriendlyTest, EytzingerLowerBoundMatchesStd)
+{
+    for (std::size_t n : {0, 1, 2, 7, 8, 100, 1023, 1024, 5000})
+    {
+        std::vector<std::uint32_t> sorted(n);
+        std::mt19937 rng(static_cast<std::uint32_t>(n));
+        for (auto& v : sorted)
+        {
+            v = rng() % (2 * n + 1); // duplicates on purpose
+        }
+        std::sort(sorted.begin(), sorted.end());
+        eytzinger_array<std::uint32_t> table(sorted.begin(), sorted.end());
+        ASSERT_EQ(table.size(), n);
+
+        for (std::uint32_t key = 0; key <= 2 * n + 2; ++key)
+        {
+            std::size_t expected = static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), key) -
+                                                            sorted.begin());
+            ASSERT_EQ(table.lower_bound(key), expected) << "n=" << n << " key=" << key;
+            ASSERT_EQ(table.contains(key), std::binary_search(sorted.begin(), sorted.end(), key));
+        }
+    }
+
+    // Q: Why does the trailing-ones shift recover the lower bound, and what does k look like when every
+    //    key in the table is smaller than the search key?
+    // A:
+    // R:
+}
+
+void run_search_benchmark(std::size_t n, std::size_t queries)
+{
+    std::vector<std::uint32_t> sorted(n);
+    std::mt19937 rng(8);
+    for (auto& v : sorted)
+    {
+        v = rng();
+    }
+    std::sort(sorted.begin(), sorted.end());
+    eytzinger_array<std::uint32_t> table(sorted.begin(), sorted.end());
+    std::vector<std::uint32_t> keys(queries);
+    for (auto& k : keys)
+    {
+        k = rng();
+    }
+
+    std::size_t std_sum = 0;
+    std::size_t eytzinger_sum = 0;
+    double std_ms = time_ms([&]()
+    {
+        for (std::uint32_t k : keys)
+        {
+            std_sum += static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), k) - sorted.begin());
+        }
+    });
+    double eytzinger_ms = time_ms([&]()
+    {
+        for (std::uint32_t k : keys)
+        {
+            eytzinger_sum += table.lower_bound(k);
+        }
+    });
+    EXPECT_EQ(std_sum, eytzinger_sum);
+    std::cout << "[ BENCH    ] lower_bound n=" << n << " queries=" << queries
+              << " std_ns=" << std_ms * 1e6 / static_cast<double>(queries)
+              << " eytzinger_ns=" << eytzinger_ms * 1e6 / static_cast<double>(queries) << "\n";
+}
+
+TEST_F(CacheFriendlyTest, EytzingerSearchBenchmark)
+{
+    run_search_benchmark(std::size_t(1) << 20, std::size_t(1) << 17);
+}
+
+TEST_F(CacheFriendlyTest, DISABLED_EytzingerSearchBenchmarkSweep)
+{
+    for (std::size_t n = std::size_t(1) << 10; n <= (std::size_t(1) << 28); n <<= 3)
+    {
+        run_search_benchmark(n, std::size_t(1) << 22);
+    }
+}
+
+// ============================================================================
+// Prefetching Linked-List Traversal
+// ============================================================================
+
+// The next address of a list is only known once the current node arrived, so the
+// hardware prefetcher cannot run ahead. A jump pointer `distance` nodes ahead gives
+// software something to prefetch while the current node is processed.
+struct ListNode
+{
+    ListNode* next;
+    ListNode* jump;
+    std::uint64_t payload[6];
+};
+
+static_assert(sizeof(ListNode) == 64, "one node per cache line");
+
+// Links the nodes of `pool` in a random order so successive nodes are far apart in memory.
+ListNode* link_shuffled(std::vector<ListNode>& pool, std::uint32_t seed)
+{
+    std::vector<std::size_t> order(pool.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        ListNode& node = pool[order[i]];
+        node.next = i + 1 < order.size() ? &pool[order[i + 1]] : nullptr;
+        node.jump = nullptr;
+        std::fill(std::begin(node.payload), std::end(node.payload), order[i]);
+    }
+    return order.empty() ? nullptr : &pool[order[0]];
+}
+
+void install_jump_pointers(ListNode* head, std::size_t distance)
+{
+    ListNode* ahead = head;
+    for (std::size_t i = 0; i < distance && ahead != nullptr; ++i)
+    {
+        ahead = ahead->next;
+    }
+    for (ListNode* node = head; node != nullptr; node = node->next)
+    {
+        node->jump = ahead;
+        ahead = ahead != nullptr ? ahead->next : nullptr;
+    }
+}
+
+std::uint64_t sum_list(const ListNode* head)
+{
+    std::uint64_t sum = 0;
+    for (const ListNode* node = head; node != nullptr; node = node->next)
+    {
+        sum += node->payload[0] + node->payload[5];
+    }
+    return sum;
+}
+
+std::uint64_t sum_list_prefetch(const ListNode* head)
+{
+    std::uint64_t sum = 0;
+    for (const ListNode* node = head; node != nullptr; node = node->next)
+    {
+#if defined(__GNUC__)
+        if (node->jump != nullptr)
+        {
+            __builtin_prefetch(node->jump);
+        }
+#endif
+        sum += node->payload[0] + node->payload[5];
+    }
+    return sum;
+}
+
+TEST_F(CacheFriendlyTest, PrefetchingListTraversalVisitsEveryNode)
+{
+    std::vector<ListNode> pool(1000);
+    ListNode* head = link_shuffled(pool, 1);
+    install_jump_pointers(head, 8);
+
+    std::size_t with_jump = 0;
+    for (const ListNode* node = head; node != nullptr; node = node->next)
+    {
+        with_jump += node->jump != nullptr ? 1 : 0;
+    }
+    EXPECT_EQ(with_jump, pool.size() - 8);
+    EXPECT_EQ(sum_list(head), sum_list_prefetch(head));
+    EXPECT_EQ(sum_list(head), 2 * (999u * 1000u / 2));
+}
+
+void run_list_benchmark(std::size_t nodes)
+{
+    std::vector<ListNode> pool(nodes);
+    ListNode* head = link_shuffled(pool, 2);
+    std::uint64_t plain = 0;
+    double plain_ms = time_ms([&]() { plain = sum_list(head); });
+    std::cout << "[ BENCH    ] list nodes=" << nodes << " plain_ns/node=" << plain_ms * 1e6 / static_cast<double>(nodes);
+    for (std::size_t distance : {4, 16, 64})
+    {
+        install_jump_pointers(head, distance);
+        std::uint64_t prefetched = 0;
+        double ms = time_ms([&]() { prefetched = sum_list_prefetch(head); });
+        EXPECT_EQ(prefetched, plain);
+        std::cout << " jump" << distance << "_ns/node=" << ms * 1e6 / static_cast<double>(nodes);
+    }
+    std::cout << "\n";
+}
+
+TEST_F(CacheFriendlyTest, ListTraversalBenchmark)
+{
+    // Q: A prefetch through node->jump still needs node->jump loaded first. Why does it help anyway,
+    //    and why does too small a distance gain nothing while too large one pollutes the cache?
+    // A:
+    // R:
+
+    run_list_benchmark(std::size_t(1) << 16);
+}
+
+TEST_F(CacheFriendlyTest, DISABLED_ListTraversalBenchmarkLarge)
+{
+    run_list_benchmark(std::size_t(1) << 22);
+}
+
+// ============================================================================
+// Working-Set Sweep: Where the Cache Cliffs Are
+// ============================================================================
+
+struct WorkingSetPoint
+{
+    std::size_t bytes;
+    double chase_ns;      // dependent random loads: latency
+    double stream_gb_s;   // sequential reads: bandwidth
+};
+
+// A single random cycle through all lines of the buffer, so every load depends on the
+// previous one and no prefetcher can guess the next line.
+WorkingSetPoint measure_working_set(std::size_t bytes, std::size_t accesses)
+{
+    const std::size_t stride = 64 / sizeof(std::size_t);
+    std::size_t lines = std::max<std::size_t>(2, bytes / 64);
+    std::vector<std::size_t> buffer(lines * stride, 0);
+
+    std::vector<std::size_t> order(lines);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin() + 1, order.end(), std::mt19937(static_cast<std::uint32_t>(lines)));
+    for (std::size_t i = 0; i < lines; ++i)
+    {
+        buffer[order[i] * stride] = order[(i + 1) % lines] * stride;
+    }
+
+    std::size_t index = 0;
+    double chase_ms = time_ms([&]()
+    {
+        for (std::size_t i = 0; i < accesses; ++i)
+        {
+            index = buffer[index];
+        }
+    });
+    EXPECT_LT(index, buffer.size());
+
+    std::size_t passes = std::max<std::size_t>(1, accesses * 8 / buffer.size());
+    std::size_t sum = 0;
+    double stream_ms = time_ms([&]()
+    {
+        for (std::size_t p = 0; p < passes; ++p)
+        {
+            sum += std::accumulate(buffer.begin(), buffer.end(), std::size_t(0));
+        }
+    });
+    EXPECT_GT(sum, 0u);
+
+    WorkingSetPoint point;
+    point.bytes = lines * 64;
+    point.chase_ns = chase_ms * 1e6 / static_cast<double>(accesses);
+    point.stream_gb_s = stream_ms > 0.0 ? static_cast<double>(passes * point.bytes) / (stream_ms * 1e6) : 0.0;
+    return point;
+}
+
+// Prints one line per size and flags every step where latency jumps by more than half:
+// those are the L1 -> L2 -> L3 -> DRAM (and TLB reach) boundaries of this machine.
+std::vector<WorkingSetPoint> sweep_working_sets(std::size_t min_bytes, std::size_t max_bytes, std::size_t accesses)
+{
+    std::vector<WorkingSetPoint> points;
+    for (std::size_t bytes = min_bytes; bytes <= max_bytes; bytes *= 2)
+    {
+        WorkingSetPoint point = measure_working_set(bytes, accesses);
+        bool cliff = !points.empty() && point.chase_ns > 1.5 * points.back().chase_ns;
+        std::cout << "[ BENCH    ] working_set=" << point.bytes / 1024 << "KB chase_ns=" << point.chase_ns
+                  << " stream_GB/s=" << point.stream_gb_s << (cliff ? "   <-- cliff" : "") << "\n";
+        points.push_back(point);
+    }
+    return points;
+}
+
+TEST_F(CacheFriendlyTest, WorkingSetSweep)
+{
+    std::vector<WorkingSetPoint> points = sweep_working_sets(4 * 1024, 4 * 1024 * 1024, 200000);
+    ASSERT_EQ(points.size(), 11u);
+    for (const WorkingSetPoint& p : points)
+    {
+        EXPECT_GT(p.chase_ns, 0.0);
+    }
+
+    // Q: Which sizes mark this machine's L1, L2 and L3 capacities? Compare them with lscpu, and explain
+    //    why the latency cliff at the last-level cache is smeared over two or three sizes.
+    // A:
+    // R:
+}
+
+TEST_F(CacheFriendlyTest, DISABLED_WorkingSetSweepToDram)
+{
+    sweep_working_sets(4 * 1024, std::size_t(512) * 1024 * 1024, 20000000);
+}
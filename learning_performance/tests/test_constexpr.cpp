@@ -2,8 +2,514 @@
 // Estimated Time: 4 hours
 // Difficulty: Moderate
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::literals;
 
 // TODO: Implement test cases for constexpr functions
 // TODO: Implement test cases for constexpr variables
-// TODO: Implement test cases for compile-time computation
+
+class ConstexprTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+// ============================================================================
+// Compile-Time Lookup Tables
+// ============================================================================
+
+// Each table is a constexpr std::array built by an ordinary loop. It is computed by the
+// compiler and lands in .rodata: no static initializer, no first-use guard.
+
+// Reflected CRC-32 (IEEE 802.3, polynomial 0x04C11DB7 reversed).
+constexpr std::array<std::uint32_t, 256> make_crc32_table()
+{
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i)
+    {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<std::uint32_t, 256> kCrc32Table = make_crc32_table();
+
+constexpr std::uint32_t crc32(std::string_view data)
+{
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (char c : data)
+    {
+        crc = kCrc32Table[(crc ^ static_cast<unsigned char>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+constexpr std::array<std::uint8_t, 256> make_popcount_table()
+{
+    std::array<std::uint8_t, 256> table{};
+    for (unsigned i = 1; i < 256; ++i)
+    {
+        table[i] = static_cast<std::uint8_t>(table[i >> 1] + (i & 1));
+    }
+    return table;
+}
+
+constexpr std::array<std::uint8_t, 256> kPopcountTable = make_popcount_table();
+
+constexpr int popcount32(std::uint32_t v)
+{
+    return kPopcountTable[v & 0xFF] + kPopcountTable[(v >> 8) & 0xFF] + kPopcountTable[(v >> 16) & 0xFF] +
+           kPopcountTable[v >> 24];
+}
+
+// Character classes as one byte of flags per character: a parser asks "is this a token
+// character" with one load and one AND instead of a chain of range compares.
+enum CharClass : std::uint8_t
+{
+    kDigit = 1 << 0,
+    kAlpha = 1 << 1,
+    kHexDigit = 1 << 2,
+    kSpace = 1 << 3,   // SP and HTAB, the only whitespace HTTP allows inside a line
+    kToken = 1 << 4,   // RFC 9110 tchar: header names and methods
+    kControl = 1 << 5,
+};
+
+constexpr std::array<std::uint8_t, 256> make_char_class_table()
+{
+    std::array<std::uint8_t, 256> table{};
+    for (unsigned c = 0; c < 256; ++c)
+    {
+        std::uint8_t flags = 0;
+        bool digit = c >= '0' && c <= '9';
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        if (digit)
+        {
+            flags |= kDigit;
+        }
+        if (alpha)
+        {
+            flags |= kAlpha;
+        }
+        if (digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+        {
+            flags |= kHexDigit;
+        }
+        if (c == ' ' || c == '\t')
+        {
+            flags |= kSpace;
+        }
+        if (digit || alpha || std::string_view("!#$%&'*+-.^_`|~").find(static_cast<char>(c)) != std::string_view::npos)
+        {
+            flags |= kToken;
+        }
+        if (c < 0x20 || c == 0x7F)
+        {
+            flags |= kControl;
+        }
+        table[c] = flags;
+    }
+    return table;
+}
+
+constexpr std::array<std::uint8_t, 256> kCharClassTable = make_char_class_table();
+
+constexpr bool has_class(char c, std::uint8_t classes)
+{
+    return (kCharClassTable[static_cast<unsigned char>(c)] & classes) != 0;
+}
+
+// The tables are usable in constant expressions, so their correctness is checked here
+// by the compiler rather than by a test run.
+static_assert(crc32("123456789") == 0xCBF43926u, "CRC-32 check value");
+static_assert(crc32("") == 0u, "CRC-32 of nothing");
+static_assert(popcount32(0xFFFFFFFFu) == 32 && popcount32(0x80000001u) == 2, "popcount table");
+static_assert(has_class('~', kToken) && !has_class(':', kToken) && has_class('\t', kSpace), "char classes");
+
+TEST_F(ConstexprTest, LookupTablesMatchRuntimeDefinitions)
+{
+    for (std::uint32_t v : {0u, 1u, 0xF0F0F0F0u, 0x12345678u, 0xFFFFFFFFu})
+    {
+        EXPECT_EQ(popcount32(v), __builtin_popcount(v));
+    }
+
+    std::string payload = "The quick brown fox jumps over the lazy dog";
+    EXPECT_EQ(crc32(payload), 0x414FA339u);
+
+    int token_chars = 0;
+    for (int c = 0; c < 256; ++c)
+    {
+        token_chars += has_class(static_cast<char>(c), kToken) ? 1 : 0;
+    }
+    EXPECT_EQ(token_chars, 10 + 52 + 15);
+
+    // Q: kCrc32Table is declared constexpr at namespace scope. What does the object file contain for it,
+    //    and what would change if make_crc32_table() were called from a non-constexpr static instead?
+    // A:
+    // R:
+}
+
+// ============================================================================
+// Compile-Time Minimal Perfect Hash
+// ============================================================================
+
+constexpr std::uint64_t mix64(std::uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// One key byte, shifted into its little-endian position.
+constexpr std::uint64_t load_byte(std::string_view key, std::size_t at, unsigned shift)
+{
+    return static_cast<std::uint64_t>(static_cast<unsigned char>(key[at])) << shift;
+}
+
+// Reads the key eight bytes at a time: a little-endian word assembled bytewise so it
+// stays a constant expression.
+// Q: What would a memcpy-based load gain at runtime, and why can't it be used here in C++17?
+// A:
+// R:
+constexpr std::uint64_t load_word(std::string_view key, std::size_t at)
+{
+    return load_byte(key, at, 0) | load_byte(key, at + 1, 8) | load_byte(key, at + 2, 16) |
+           load_byte(key, at + 3, 24) | load_byte(key, at + 4, 32) | load_byte(key, at + 5, 40) |
+           load_byte(key, at + 6, 48) | load_byte(key, at + 7, 56);
+}
+
+constexpr std::uint64_t load_short(std::string_view key)
+{
+    std::uint64_t word = 0;
+    for (std::size_t b = 0; b < key.size(); ++b)
+    {
+        word |= load_byte(key, b, static_cast<unsigned>(8 * b));
+    }
+    return word;
+}
+
+constexpr std::uint64_t key_hash(std::string_view key)
+{
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ key.size();
+    std::size_t i = 0;
+    for (; i + 8 <= key.size(); i += 8)
+    {
+        h = (h ^ load_word(key, i)) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 29;
+    }
+    if (i < key.size())
+    {
+        // Re-read the last eight bytes (overlapping the previous word) rather than loop over
+        // the tail; only keys shorter than a word take the byte loop.
+        std::uint64_t tail = key.size() >= 8 ? load_word(key, key.size() - 8) : load_short(key);
+        h = (h ^ tail) * 0xFF51AFD7ED558CCDull;
+    }
+    return mix64(h);
+}
+
+// Rehashing the key's hash rather than the key keeps lookups to one pass over the bytes.
+constexpr std::uint32_t slot_hash(std::uint64_t base, std::uint32_t seed)
+{
+    return static_cast<std::uint32_t>(((base ^ (seed * 0xD6E8FEB86659FD93ull)) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// Hash-and-displace: a first hash splits the keys into buckets, then each bucket gets the
+// smallest seed that sends all its keys to still-free slots of an N-slot table. Biggest
+// buckets are placed first, while the table is empty. A lookup hashes the key once,
+// remixes that hash with its bucket's seed and does one key compare, which also
+// rejects misses.
+template<std::size_t N>
+struct perfect_hash
+{
+    static constexpr std::size_t kBuckets = N / 2 + 1;
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    std::array<std::string_view, N> keys{};
+    std::array<std::uint32_t, kBuckets> seeds{};
+    std::array<std::size_t, N> slot_to_key{};
+    std::array<std::string_view, N> slot_keys{}; // keys[slot_to_key[s]], so the compare needs no extra hop
+
+    // Index of `key` in the original key array, or npos.
+    constexpr std::size_t find(std::string_view key) const
+    {
+        if constexpr (N == 0)
+        {
+            return npos;
+        }
+        else
+        {
+            std::uint64_t base = key_hash(key);
+            std::uint32_t seed = seeds[static_cast<std::uint32_t>(base) % kBuckets];
+            std::size_t slot = slot_hash(base, seed) % N;
+            return slot_keys[slot] == key ? slot_to_key[slot] : npos;
+        }
+    }
+
+    constexpr bool contains(std::string_view key) const
+    {
+        return find(key) != npos;
+    }
+
+    static constexpr std::size_t size()
+    {
+        return N;
+    }
+};
+
+// Evaluated in a constexpr context a throw becomes a compile error carrying the message,
+// so duplicate keys or an unsolvable bucket stop the build instead of misbehaving later.
+template<std::size_t N>
+constexpr perfect_hash<N> make_perfect_hash(const std::array<std::string_view, N>& keys)
+{
+    using Hash = perfect_hash<N>;
+    constexpr std::size_t kBuckets = Hash::kBuckets;
+    constexpr std::uint32_t kMaxSeed = 1u << 16;
+
+    Hash result{};
+    result.keys = keys;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        for (std::size_t j = i + 1; j < N; ++j)
+        {
+            if (keys[i] == keys[j])
+            {
+                throw std::invalid_argument("make_perfect_hash: duplicate key");
+            }
+        }
+    }
+
+    std::array<std::uint64_t, N> base{};
+    std::array<std::size_t, N> bucket_of{};
+    std::array<std::size_t, kBuckets> bucket_size{};
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        base[i] = key_hash(keys[i]);
+        bucket_of[i] = static_cast<std::uint32_t>(base[i]) % kBuckets;
+        ++bucket_size[bucket_of[i]];
+    }
+
+    std::array<std::size_t, kBuckets> order{};
+    for (std::size_t b = 0; b < kBuckets; ++b)
+    {
+        order[b] = b;
+    }
+    for (std::size_t i = 1; i < kBuckets; ++i)
+    {
+        for (std::size_t j = i; j > 0 && bucket_size[order[j - 1]] < bucket_size[order[j]]; --j)
+        {
+            std::size_t tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+    }
+
+    std::array<bool, N> taken{};
+    std::array<std::size_t, N> key_slot{};
+    for (std::size_t b : order)
+    {
+        if (bucket_size[b] == 0)
+        {
+            break;
+        }
+        bool placed = false;
+        for (std::uint32_t seed = 1; seed < kMaxSeed && !placed; ++seed)
+        {
+            std::array<std::size_t, N> members{};
+            std::size_t count = 0;
+            bool fits = true;
+            for (std::size_t i = 0; i < N && fits; ++i)
+            {
+                if (bucket_of[i] != b)
+                {
+                    continue;
+                }
+                std::size_t slot = slot_hash(base[i], seed) % N;
+                fits = !taken[slot];
+                for (std::size_t m = 0; m < count && fits; ++m)
+                {
+                    fits = key_slot[members[m]] != slot;
+                }
+                key_slot[i] = slot;
+                members[count++] = i;
+            }
+            if (fits)
+            {
+                for (std::size_t m = 0; m < count; ++m)
+                {
+                    taken[key_slot[members[m]]] = true;
+                }
+                result.seeds[b] = seed;
+                placed = true;
+            }
+        }
+        if (!placed)
+        {
+            throw std::logic_error("make_perfect_hash: no seed places this bucket");
+        }
+    }
+
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        result.slot_to_key[key_slot[i]] = i;
+        result.slot_keys[key_slot[i]] = keys[i];
+    }
+    return result;
+}
+
+// The fixed vocabulary of an HTTP-style protocol parser: methods, header fields, cache
+// directives, codings, schemes and versions.
+constexpr std::array kProtocolKeywords = {
+    "GET"sv, "HEAD"sv, "POST"sv, "PUT"sv, "DELETE"sv, "CONNECT"sv, "OPTIONS"sv, "TRACE"sv, "PATCH"sv,
+    "PROPFIND"sv, "PROPPATCH"sv, "MKCOL"sv, "COPY"sv, "MOVE"sv, "LOCK"sv, "UNLOCK"sv, "SEARCH"sv, "REPORT"sv,
+    "MKACTIVITY"sv, "CHECKOUT"sv, "MERGE"sv, "NOTIFY"sv, "SUBSCRIBE"sv, "UNSUBSCRIBE"sv, "PURGE"sv, "LINK"sv,
+    "UNLINK"sv, "BIND"sv, "REBIND"sv, "UNBIND"sv, "ACL"sv, "MKCALENDAR"sv, "ORDERPATCH"sv, "UPDATE"sv, "LABEL"sv,
+    "MKWORKSPACE"sv, "VERSION-CONTROL"sv, "BASELINE-CONTROL"sv, "MKREDIRECTREF"sv, "UPDATEREDIRECTREF"sv,
+    "Accept"sv, "Accept-Charset"sv, "Accept-Encoding"sv, "Accept-Language"sv, "Accept-Ranges"sv, "Accept-CH"sv,
+    "Accept-Patch"sv, "Accept-Post"sv, "Access-Control-Allow-Credentials"sv, "Access-Control-Allow-Headers"sv,
+    "Access-Control-Allow-Methods"sv, "Access-Control-Allow-Origin"sv, "Access-Control-Expose-Headers"sv,
+    "Access-Control-Max-Age"sv, "Access-Control-Request-Headers"sv, "Access-Control-Request-Method"sv, "Age"sv,
+    "Allow"sv, "Alt-Svc"sv, "Authorization"sv, "Cache-Control"sv, "Clear-Site-Data"sv, "Connection"sv,
+    "Content-Digest"sv, "Content-Disposition"sv, "Content-Encoding"sv, "Content-Language"sv, "Content-Length"sv,
+    "Content-Location"sv, "Content-Range"sv, "Content-Security-Policy"sv, "Content-Security-Policy-Report-Only"sv,
+    "Content-Type"sv, "Cookie"sv, "Cross-Origin-Embedder-Policy"sv, "Cross-Origin-Opener-Policy"sv,
+    "Cross-Origin-Resource-Policy"sv, "Date"sv, "Device-Memory"sv, "Digest"sv, "DNT"sv, "Early-Data"sv, "ETag"sv,
+    "Expect"sv, "Expires"sv, "Forwarded"sv, "From"sv, "Host"sv, "Idempotency-Key"sv, "If-Match"sv,
+    "If-Modified-Since"sv, "If-None-Match"sv, "If-Range"sv, "If-Unmodified-Since"sv, "Keep-Alive"sv,
+    "Last-Modified"sv, "Link"sv, "Location"sv, "Max-Forwards"sv, "NEL"sv, "Origin"sv, "Permissions-Policy"sv,
+    "Pragma"sv, "Priority"sv, "Proxy-Authenticate"sv, "Proxy-Authorization"sv, "Range"sv, "Referer"sv,
+    "Referrer-Policy"sv, "Refresh"sv, "Report-To"sv, "Repr-Digest"sv, "Retry-After"sv, "Save-Data"sv,
+    "Sec-Fetch-Dest"sv, "Sec-Fetch-Mode"sv, "Sec-Fetch-Site"sv, "Sec-Fetch-User"sv, "Sec-Purpose"sv,
+    "Sec-WebSocket-Accept"sv, "Sec-WebSocket-Extensions"sv, "Sec-WebSocket-Key"sv, "Sec-WebSocket-Protocol"sv,
+    "Sec-WebSocket-Version"sv, "Server"sv, "Server-Timing"sv, "Service-Worker-Allowed"sv, "Set-Cookie"sv,
+    "SourceMap"sv, "Strict-Transport-Security"sv, "TE"sv, "Timing-Allow-Origin"sv, "Trailer"sv,
+    "Transfer-Encoding"sv, "Upgrade"sv, "Upgrade-Insecure-Requests"sv, "User-Agent"sv, "Vary"sv, "Via"sv,
+    "Want-Digest"sv, "Warning"sv, "WWW-Authenticate"sv, "X-Content-Type-Options"sv, "X-DNS-Prefetch-Control"sv,
+    "X-Forwarded-For"sv, "X-Forwarded-Host"sv, "X-Forwarded-Proto"sv, "X-Frame-Options"sv, "X-Request-ID"sv,
+    "X-XSS-Protection"sv, "no-cache"sv, "no-store"sv, "max-age"sv, "s-maxage"sv, "must-revalidate"sv,
+    "proxy-revalidate"sv, "no-transform"sv, "public"sv, "private"sv, "immutable"sv, "stale-while-revalidate"sv,
+    "stale-if-error"sv, "only-if-cached"sv, "max-stale"sv, "min-fresh"sv, "must-understand"sv, "chunked"sv,
+    "compress"sv, "deflate"sv, "gzip"sv, "br"sv, "zstd"sv, "identity"sv, "trailers"sv, "close"sv, "keep-alive"sv,
+    "upgrade"sv, "websocket"sv, "h2c"sv, "http"sv, "https"sv, "ws"sv, "wss"sv, "HTTP/1.0"sv, "HTTP/1.1"sv,
+    "HTTP/2"sv, "HTTP/3"sv, "charset"sv, "boundary"sv, "q"sv, "filename"sv, "name"sv, "inline"sv, "attachment"sv,
+    "Secure"sv, "HttpOnly"sv, "SameSite"sv, "Domain"sv, "Path"sv, "Max-Age"sv, "Partitioned"sv,
+};
+
+constexpr perfect_hash<kProtocolKeywords.size()> kKeywordHash = make_perfect_hash(kProtocolKeywords);
+
+static_assert(kKeywordHash.find("GET") == 0, "lookups work in constant expressions");
+static_assert(kKeywordHash.find("Content-Length") != decltype(kKeywordHash)::npos, "");
+static_assert(!kKeywordHash.contains("content-length"), "keys are case-sensitive");
+
+TEST_F(ConstexprTest, PerfectHashFindsEveryKeywordAndRejectsOthers)
+{
+    EXPECT_GE(kProtocolKeywords.size(), 200u);
+
+    // Minimal: N keys fill exactly N slots.
+    std::vector<bool> key_seen(kKeywordHash.size(), false);
+    for (std::size_t key : kKeywordHash.slot_to_key)
+    {
+        ASSERT_FALSE(key_seen[key]);
+        key_seen[key] = true;
+    }
+    for (std::size_t i = 0; i < kProtocolKeywords.size(); ++i)
+    {
+        ASSERT_EQ(kKeywordHash.find(kProtocolKeywords[i]), i) << kProtocolKeywords[i];
+    }
+
+    for (std::string_view miss : {"", "GETX", "GE", "Content-Lengths", "X-Unknown", "HTTP/4", "get"})
+    {
+        EXPECT_EQ(kKeywordHash.find(miss), decltype(kKeywordHash)::npos) << miss;
+    }
+
+    // A runtime-built key (not a literal) goes through exactly the same lookup.
+    std::string built = std::string("Transfer-") + "Encoding";
+    EXPECT_EQ(kProtocolKeywords[kKeywordHash.find(built)], "Transfer-Encoding");
+
+    constexpr auto small = make_perfect_hash(std::array{"red"sv, "green"sv, "blue"sv});
+    static_assert(small.find("blue") == 2 && small.find("cyan") == decltype(small)::npos, "");
+
+    constexpr perfect_hash<0> none{};
+    static_assert(none.find("red") == perfect_hash<0>::npos, "");
+
+    // Q: Adding "GET" a second time to kProtocolKeywords fails to compile. Which line reports the error,
+    //    and why is a throw inside a constexpr function the idiomatic C++17 way to get there?
+    // A:
+    // R:
+}
+
+void run_keyword_lookup_benchmark(int rounds)
+{
+    std::vector<std::string> hits;
+    std::vector<std::string> misses;
+    for (std::string_view k : kProtocolKeywords)
+    {
+        hits.emplace_back(k);
+        misses.emplace_back(std::string(k) + "-x"); // misses of realistic length
+    }
+
+    std::unordered_map<std::string_view, std::size_t> map;
+    auto start = std::chrono::steady_clock::now();
+    map.reserve(kProtocolKeywords.size());
+    for (std::size_t i = 0; i < kProtocolKeywords.size(); ++i)
+    {
+        map.emplace(kProtocolKeywords[i], i);
+    }
+    double build_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    auto time_lookups = [rounds](const std::vector<std::string>& input, std::size_t expected_found, auto lookup)
+    {
+        std::size_t found = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+        {
+            for (const std::string& s : input)
+            {
+                found += lookup(std::string_view(s)) ? 1 : 0;
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        EXPECT_EQ(found, expected_found * static_cast<std::size_t>(rounds));
+        return ns / (static_cast<double>(input.size()) * rounds);
+    };
+    auto perfect = [](std::string_view s) { return kKeywordHash.contains(s); };
+    auto hashed = [&map](std::string_view s) { return map.find(s) != map.end(); };
+
+    std::cout << "[ BENCH    ] keywords=" << kProtocolKeywords.size()
+              << " hit_ns: perfect_hash=" << time_lookups(hits, hits.size(), perfect)
+              << " unordered_map=" << time_lookups(hits, hits.size(), hashed)
+              << " miss_ns: perfect_hash=" << time_lookups(misses, 0, perfect)
+              << " unordered_map=" << time_lookups(misses, 0, hashed) << " startup_us: perfect_hash=0"
+              << " unordered_map=" << build_us << "\n";
+}
+
+TEST_F(ConstexprTest, KeywordLookupBenchmark)
+{
+    // Q: The perfect hash always does exactly one string compare. What does unordered_map do on a miss
+    //    whose bucket is non-empty, and what does its startup cost consist of?
+    // A:
+    // R:
+
+    run_keyword_lookup_benchmark(200);
+}
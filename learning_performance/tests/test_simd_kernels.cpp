@@ -0,0 +1,872 @@
+// Test Suite: SIMD Kernels and Runtime Dispatch
+// Estimated Time: 4 hours
+// Difficulty: Hard
+
+#include "instrumentation.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_KERNELS_X86 0
+#endif
+
+// ============================================================================
+// Kernel Interface and Scalar Reference
+// ============================================================================
+
+// The build targets baseline x86-64, so wider paths are compiled per function with
+// __attribute__((target)) and picked once at startup. Nothing outside those functions
+// may assume the instructions exist, which is why the kernels are reached through a
+// table of plain function pointers rather than inlined.
+namespace simd
+{
+
+enum class Isa
+{
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512
+};
+
+inline const char* isa_name(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Scalar: return "scalar";
+    case Isa::Sse2: return "sse2";
+    case Isa::Avx2: return "avx2";
+    case Isa::Avx512: return "avx512";
+    }
+    return "?";
+}
+
+struct MinMax
+{
+    std::int32_t min;
+    std::int32_t max;
+};
+
+struct KernelTable
+{
+    Isa isa;
+    std::int64_t (*sum_i32)(const std::int32_t* data, std::size_t n);
+    MinMax (*min_max_i32)(const std::int32_t* data, std::size_t n);
+    float (*dot_f32)(const float* a, const float* b, std::size_t n);
+    // Index of the first `byte`, or n.
+    std::size_t (*find_byte)(const std::uint8_t* data, std::size_t n, std::uint8_t byte);
+    // Wrapping inclusive prefix sum; out may equal in.
+    void (*inclusive_scan_i32)(const std::int32_t* in, std::int32_t* out, std::size_t n);
+    // Copies elements greater than threshold to out in order and returns how many.
+    // out must hold n elements even when fewer are kept: vector paths store whole
+    // vectors, so slots past the returned count (but before out + n) may be overwritten.
+    std::size_t (*filter_greater_i32)(const std::int32_t* in, std::size_t n, std::int32_t threshold, std::int32_t* out);
+};
+
+// Plain loops: the reference every other path is checked against. The compiler may
+// auto-vectorize some of them at -O2/-O3; the scan and the filter it normally cannot.
+namespace scalar
+{
+
+inline std::int64_t sum_i32(const std::int32_t* data, std::size_t n)
+{
+    std::int64_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        sum += data[i];
+    }
+    return sum;
+}
+
+inline MinMax min_max_i32(const std::int32_t* data, std::size_t n)
+{
+    MinMax result{std::numeric_limits<std::int32_t>::max(), std::numeric_limits<std::int32_t>::min()};
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        result.min = std::min(result.min, data[i]);
+        result.max = std::max(result.max, data[i]);
+    }
+    return result;
+}
+
+inline float dot_f32(const float* a, const float* b, std::size_t n)
+{
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+inline std::size_t find_byte(const std::uint8_t* data, std::size_t n, std::uint8_t byte)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (data[i] == byte)
+        {
+            return i;
+        }
+    }
+    return n;
+}
+
+inline void inclusive_scan_i32(const std::int32_t* in, std::int32_t* out, std::size_t n)
+{
+    std::uint32_t running = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        running += static_cast<std::uint32_t>(in[i]);
+        out[i] = static_cast<std::int32_t>(running);
+    }
+}
+
+inline std::size_t filter_greater_i32(const std::int32_t* in, std::size_t n, std::int32_t threshold, std::int32_t* out)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (in[i] > threshold)
+        {
+            out[count++] = in[i];
+        }
+    }
+    return count;
+}
+
+inline const KernelTable& table()
+{
+    static const KernelTable kernels{Isa::Scalar, sum_i32, min_max_i32, dot_f32, find_byte, inclusive_scan_i32,
+                                     filter_greater_i32};
+    return kernels;
+}
+
+} // namespace scalar
+
+#if SIMD_KERNELS_X86
+
+// ============================================================================
+// SSE2 (every x86-64 CPU)
+// ============================================================================
+
+// SSE2 lacks 32-bit min/max, sign extension and byte shuffles (SSE4.1/SSSE3), so those
+// are emulated with compares and masks - the price of running everywhere.
+namespace sse2
+{
+
+__attribute__((target("sse2"))) inline std::int64_t sum_i32(const std::int32_t* data, std::size_t n)
+{
+    __m128i acc = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i sign = _mm_srai_epi32(v, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+    alignas(16) std::int64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    return lanes[0] + lanes[1] + scalar::sum_i32(data + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline __m128i select_epi32(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("sse2"))) inline MinMax min_max_i32(const std::int32_t* data, std::size_t n)
+{
+    __m128i lo = _mm_set1_epi32(std::numeric_limits<std::int32_t>::max());
+    __m128i hi = _mm_set1_epi32(std::numeric_limits<std::int32_t>::min());
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        lo = select_epi32(_mm_cmplt_epi32(v, lo), v, lo);
+        hi = select_epi32(_mm_cmpgt_epi32(v, hi), v, hi);
+    }
+    alignas(16) std::int32_t lo_lanes[4];
+    alignas(16) std::int32_t hi_lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lo_lanes), lo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(hi_lanes), hi);
+    MinMax result = scalar::min_max_i32(data + i, n - i);
+    for (int k = 0; k < 4; ++k)
+    {
+        result.min = std::min(result.min, lo_lanes[k]);
+        result.max = std::max(result.max, hi_lanes[k]);
+    }
+    return result;
+}
+
+__attribute__((target("sse2"))) inline float dot_f32(const float* a, const float* b, std::size_t n)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + scalar::dot_f32(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline std::size_t find_byte(const std::uint8_t* data, std::size_t n, std::uint8_t byte)
+{
+    __m128i needle = _mm_set1_epi8(static_cast<char>(byte));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask != 0)
+        {
+            return i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+    return i + scalar::find_byte(data + i, n - i, byte);
+}
+
+// Log-step scan inside the register (shift by one lane, then two), plus the carry of
+// everything before it broadcast from the previous block's last lane.
+__attribute__((target("sse2"))) inline void inclusive_scan_i32(const std::int32_t* in, std::int32_t* out, std::size_t n)
+{
+    __m128i carry = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), x);
+        carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    std::uint32_t running = static_cast<std::uint32_t>(_mm_cvtsi128_si32(carry));
+    for (; i < n; ++i)
+    {
+        running += static_cast<std::uint32_t>(in[i]);
+        out[i] = static_cast<std::int32_t>(running);
+    }
+}
+
+// Compare four at a time, then store the survivors lane by lane from the mask bits.
+__attribute__((target("sse2"))) inline std::size_t filter_greater_i32(const std::int32_t* in, std::size_t n,
+                                                                      std::int32_t threshold, std::int32_t* out)
+{
+    __m128i limit = _mm_set1_epi32(threshold);
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, limit))));
+        while (mask != 0)
+        {
+            out[count++] = in[i + static_cast<std::size_t>(__builtin_ctz(mask))];
+            mask &= mask - 1;
+        }
+    }
+    return count + scalar::filter_greater_i32(in + i, n - i, threshold, out + count);
+}
+
+inline const KernelTable& table()
+{
+    static const KernelTable kernels{Isa::Sse2, sum_i32, min_max_i32, dot_f32, find_byte, inclusive_scan_i32,
+                                     filter_greater_i32};
+    return kernels;
+}
+
+} // namespace sse2
+
+// ============================================================================
+// AVX2 + FMA (Haswell and later)
+// ============================================================================
+
+namespace avx2
+{
+
+// For each 8-bit mask, the source lanes of the set bits packed to the front, one byte each.
+constexpr std::array<std::uint64_t, 256> make_compress_table()
+{
+    std::array<std::uint64_t, 256> table{};
+    for (unsigned mask = 0; mask < 256; ++mask)
+    {
+        std::uint64_t packed = 0;
+        unsigned out = 0;
+        for (unsigned lane = 0; lane < 8; ++lane)
+        {
+            if (mask & (1u << lane))
+            {
+                packed |= static_cast<std::uint64_t>(lane) << (8 * out);
+                ++out;
+            }
+        }
+        table[mask] = packed;
+    }
+    return table;
+}
+
+constexpr std::array<std::uint64_t, 256> kCompressTable = make_compress_table();
+
+__attribute__((target("avx2"))) inline std::int64_t sum_i32(const std::int32_t* data, std::size_t n)
+{
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    alignas(32) std::int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar::sum_i32(data + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline MinMax min_max_i32(const std::int32_t* data, std::size_t n)
+{
+    __m256i lo = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::max());
+    __m256i hi = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        lo = _mm256_min_epi32(lo, v);
+        hi = _mm256_max_epi32(hi, v);
+    }
+    alignas(32) std::int32_t lo_lanes[8];
+    alignas(32) std::int32_t hi_lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lo_lanes), lo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(hi_lanes), hi);
+    MinMax result = scalar::min_max_i32(data + i, n - i);
+    for (int k = 0; k < 8; ++k)
+    {
+        result.min = std::min(result.min, lo_lanes[k]);
+        result.max = std::max(result.max, hi_lanes[k]);
+    }
+    return result;
+}
+
+// Two accumulators hide the four-cycle FMA latency behind independent chains.
+__attribute__((target("avx2,fma"))) inline float dot_f32(const float* a, const float* b, std::size_t n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(acc0, acc1));
+    float sum = 0.0f;
+    for (float lane : lanes)
+    {
+        sum += lane;
+    }
+    return sum + scalar::dot_f32(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline std::size_t find_byte(const std::uint8_t* data, std::size_t n, std::uint8_t byte)
+{
+    __m256i needle = _mm256_set1_epi8(static_cast<char>(byte));
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (mask != 0)
+        {
+            return i + static_cast<std::size_t>(__builtin_ctz(mask));
+        }
+    }
+    return i + scalar::find_byte(data + i, n - i, byte);
+}
+
+// Byte shifts only move within each 128-bit half, so the halves are scanned separately
+// and the low half's total is then added to the high half.
+__attribute__((target("avx2"))) inline void inclusive_scan_i32(const std::int32_t* in, std::int32_t* out, std::size_t n)
+{
+    const __m256i last_lane = _mm256_set1_epi32(7);
+    const __m256i low_total = _mm256_set1_epi32(3);
+    __m256i carry = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        __m256i spill = _mm256_permutevar8x32_epi32(x, low_total);
+        x = _mm256_add_epi32(x, _mm256_blend_epi32(_mm256_setzero_si256(), spill, 0xF0));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, last_lane);
+    }
+    std::uint32_t running = static_cast<std::uint32_t>(_mm256_cvtsi256_si32(carry));
+    for (; i < n; ++i)
+    {
+        running += static_cast<std::uint32_t>(in[i]);
+        out[i] = static_cast<std::int32_t>(running);
+    }
+}
+
+// Left-pack: a table lookup turns the compare mask into a lane permutation, the whole
+// vector is stored and the output advances by the popcount. The store may write up to
+// seven lanes past the kept ones, but never past out + i + 8 <= out + n.
+__attribute__((target("avx2,popcnt"))) inline std::size_t filter_greater_i32(const std::int32_t* in, std::size_t n,
+                                                                              std::int32_t threshold, std::int32_t* out)
+{
+    __m256i limit = _mm256_set1_epi32(threshold);
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, limit))));
+        // movq load rather than _mm_cvtsi64_si128, which only exists on x86-64.
+        __m256i permutation =
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&kCompressTable[mask])));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + count), _mm256_permutevar8x32_epi32(v, permutation));
+        count += static_cast<std::size_t>(_mm_popcnt_u32(mask));
+    }
+    return count + scalar::filter_greater_i32(in + i, n - i, threshold, out + count);
+}
+
+inline const KernelTable& table()
+{
+    static const KernelTable kernels{Isa::Avx2, sum_i32, min_max_i32, dot_f32, find_byte, inclusive_scan_i32,
+                                     filter_greater_i32};
+    return kernels;
+}
+
+} // namespace avx2
+
+// ============================================================================
+// AVX-512 F + BW (Skylake-SP and later)
+// ============================================================================
+
+// Mask registers remove the scalar tails: the last partial vector is loaded with a
+// lane mask, and compress-store does the left-pack in one instruction.
+//
+// GCC's avx512fintrin.h seeds the masked loads, casts, extracts and _mm512_reduce_*
+// helpers with _mm*_undefined_*() placeholders (`__Y`), and once they are inlined at -O2
+// -Wuninitialized / -Wmaybe-uninitialized report those placeholders. No lane that is read
+// comes from them, so the warning is a false positive; it is silenced for this namespace only.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+namespace avx512
+{
+
+inline __mmask16 tail_mask16(std::size_t remaining)
+{
+    return remaining >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << remaining) - 1);
+}
+
+__attribute__((target("avx512f"))) inline std::int64_t sum_i32(const std::int32_t* data, std::size_t n)
+{
+    __m512i acc = _mm512_setzero_si512();
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        __m512i v = _mm512_maskz_loadu_epi32(tail_mask16(n - i), data + i);
+        acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+        acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+    }
+    return _mm512_reduce_add_epi64(acc);
+}
+
+__attribute__((target("avx512f"))) inline MinMax min_max_i32(const std::int32_t* data, std::size_t n)
+{
+    const __m512i max_value = _mm512_set1_epi32(std::numeric_limits<std::int32_t>::max());
+    const __m512i min_value = _mm512_set1_epi32(std::numeric_limits<std::int32_t>::min());
+    __m512i lo = max_value;
+    __m512i hi = min_value;
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 mask = tail_mask16(n - i);
+        lo = _mm512_min_epi32(lo, _mm512_mask_loadu_epi32(max_value, mask, data + i));
+        hi = _mm512_max_epi32(hi, _mm512_mask_loadu_epi32(min_value, mask, data + i));
+    }
+    return MinMax{_mm512_reduce_min_epi32(lo), _mm512_reduce_max_epi32(hi)};
+}
+
+__attribute__((target("avx512f"))) inline float dot_f32(const float* a, const float* b, std::size_t n)
+{
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i < n; i += 16)
+    {
+        __mmask16 mask = tail_mask16(n - i);
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline std::size_t find_byte(const std::uint8_t* data, std::size_t n,
+                                                                         std::uint8_t byte)
+{
+    __m512i needle = _mm512_set1_epi8(static_cast<char>(byte));
+    for (std::size_t i = 0; i < n; i += 64)
+    {
+        std::size_t remaining = n - i;
+        __mmask64 valid = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1;
+        __m512i v = _mm512_maskz_loadu_epi8(valid, data + i);
+        __mmask64 hits = _mm512_mask_cmpeq_epi8_mask(valid, v, needle);
+        if (hits != 0)
+        {
+            return i + static_cast<std::size_t>(__builtin_ctzll(hits));
+        }
+    }
+    return n;
+}
+
+// alignr against zero shifts whole dword lanes across the 512-bit register, so four
+// log steps scan all sixteen lanes with no per-half fix-up.
+__attribute__((target("avx512f"))) inline void inclusive_scan_i32(const std::int32_t* in, std::int32_t* out,
+                                                                  std::size_t n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i last_lane = _mm512_set1_epi32(15);
+    __m512i carry = zero;
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 mask = tail_mask16(n - i);
+        __m512i x = _mm512_maskz_loadu_epi32(mask, in + i);
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, zero, 15));
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, zero, 14));
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, zero, 12));
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, zero, 8));
+        x = _mm512_add_epi32(x, carry);
+        _mm512_mask_storeu_epi32(out + i, mask, x);
+        carry = _mm512_permutexvar_epi32(last_lane, x);
+    }
+}
+
+__attribute__((target("avx512f,popcnt"))) inline std::size_t filter_greater_i32(const std::int32_t* in, std::size_t n,
+                                                                                std::int32_t threshold, std::int32_t* out)
+{
+    __m512i limit = _mm512_set1_epi32(threshold);
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 valid = tail_mask16(n - i);
+        __m512i v = _mm512_maskz_loadu_epi32(valid, in + i);
+        __mmask16 keep = _mm512_mask_cmpgt_epi32_mask(valid, v, limit);
+        _mm512_mask_compressstoreu_epi32(out + count, keep, v);
+        count += static_cast<std::size_t>(_mm_popcnt_u32(keep));
+    }
+    return count;
+}
+
+inline const KernelTable& table()
+{
+    static const KernelTable kernels{Isa::Avx512, sum_i32, min_max_i32, dot_f32, find_byte, inclusive_scan_i32,
+                                     filter_greater_i32};
+    return kernels;
+}
+
+} // namespace avx512
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // SIMD_KERNELS_X86
+
+// __builtin_cpu_supports also checks that the OS saves the wider registers (XCR0), so a
+// CPU with AVX-512 under a kernel that does not enable it reports false.
+inline bool isa_supported(Isa isa)
+{
+#if SIMD_KERNELS_X86
+    switch (isa)
+    {
+    case Isa::Scalar: return true;
+    case Isa::Sse2: return __builtin_cpu_supports("sse2");
+    case Isa::Avx2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                           __builtin_cpu_supports("popcnt");
+    case Isa::Avx512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                             __builtin_cpu_supports("popcnt");
+    }
+    return false;
+#else
+    return isa == Isa::Scalar;
+#endif
+}
+
+// Requires isa_supported(isa).
+inline const KernelTable& kernels_for(Isa isa)
+{
+#if SIMD_KERNELS_X86
+    switch (isa)
+    {
+    case Isa::Scalar: return scalar::table();
+    case Isa::Sse2: return sse2::table();
+    case Isa::Avx2: return avx2::table();
+    case Isa::Avx512: return avx512::table();
+    }
+#endif
+    return scalar::table();
+}
+
+inline std::vector<Isa> supported_isas()
+{
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2, Isa::Avx512})
+    {
+        if (isa_supported(isa))
+        {
+            isas.push_back(isa);
+        }
+    }
+    return isas;
+}
+
+// The widest supported table, chosen on first use and fixed for the process.
+inline const KernelTable& kernels()
+{
+    static const KernelTable& best = kernels_for(supported_isas().back());
+    return best;
+}
+
+} // namespace simd
+
+class SimdKernelsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+// Sizes around every vector width so each path's main loop and tail are both exercised.
+const std::vector<std::size_t>& kernel_test_sizes()
+{
+    static const std::vector<std::size_t> sizes = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1000, 4099};
+    return sizes;
+}
+
+std::vector<std::int32_t> make_ints(std::size_t n, std::uint32_t seed)
+{
+    std::vector<std::int32_t> values(n);
+    std::mt19937 rng(seed);
+    for (auto& v : values)
+    {
+        v = static_cast<std::int32_t>(rng());
+    }
+    return values;
+}
+
+TEST_F(SimdKernelsTest, DispatchPicksWidestSupportedIsa)
+{
+    std::vector<simd::Isa> isas = simd::supported_isas();
+    ASSERT_FALSE(isas.empty());
+    EXPECT_EQ(isas.front(), simd::Isa::Scalar);
+    EXPECT_EQ(simd::kernels().isa, isas.back());
+
+    for (simd::Isa isa : isas)
+    {
+        EXPECT_EQ(simd::kernels_for(isa).isa, isa);
+        std::cout << "[ INFO     ] supported: " << simd::isa_name(isa) << "\n";
+    }
+
+    // Q: kernels() is chosen once through a function-local static. Why must the AVX2 functions never
+    //    be inlined into code that runs before that check, and what stops the compiler doing so?
+    // A:
+    // R:
+}
+
+TEST_F(SimdKernelsTest, ReductionsMatchScalar)
+{
+    const simd::KernelTable& reference = simd::scalar::table();
+    for (simd::Isa isa : simd::supported_isas())
+    {
+        const simd::KernelTable& k = simd::kernels_for(isa);
+        for (std::size_t n : kernel_test_sizes())
+        {
+            std::vector<std::int32_t> values = make_ints(n, static_cast<std::uint32_t>(n));
+            EXPECT_EQ(k.sum_i32(values.data(), n), reference.sum_i32(values.data(), n))
+                << simd::isa_name(isa) << " n=" << n;
+
+            simd::MinMax got = k.min_max_i32(values.data(), n);
+            simd::MinMax expected = reference.min_max_i32(values.data(), n);
+            EXPECT_EQ(got.min, expected.min) << simd::isa_name(isa) << " n=" << n;
+            EXPECT_EQ(got.max, expected.max) << simd::isa_name(isa) << " n=" << n;
+
+            std::vector<float> a(n);
+            std::vector<float> b(n);
+            double exact = 0.0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                a[i] = static_cast<float>(values[i] % 1000) / 100.0f;
+                b[i] = static_cast<float>((values[i] >> 12) % 1000) / 100.0f;
+                exact += static_cast<double>(a[i]) * b[i];
+            }
+            // Different summation order: compare against the exact sum with a relative bound.
+            double tolerance = 1e-4 * std::max(1.0, std::fabs(exact)) + 1e-3 * static_cast<double>(n) / 1000.0;
+            EXPECT_NEAR(k.dot_f32(a.data(), b.data(), n), exact, tolerance) << simd::isa_name(isa) << " n=" << n;
+        }
+    }
+
+    // Q: The SIMD dot product does not return the same float as the scalar loop. Which one is closer
+    //    to the exact result for long vectors, and why?
+    // A:
+    // R:
+}
+
+TEST_F(SimdKernelsTest, ByteSearchMatchesScalar)
+{
+    for (simd::Isa isa : simd::supported_isas())
+    {
+        const simd::KernelTable& k = simd::kernels_for(isa);
+        for (std::size_t n : kernel_test_sizes())
+        {
+            std::vector<std::uint8_t> bytes(n, 'a');
+            EXPECT_EQ(k.find_byte(bytes.data(), n, 'x'), n) << simd::isa_name(isa);
+            for (std::size_t at : {std::size_t(0), n / 2, n == 0 ? 0 : n - 1})
+            {
+                if (at >= n)
+                {
+                    continue;
+                }
+                bytes[at] = 'x';
+                EXPECT_EQ(k.find_byte(bytes.data(), n, 'x'), simd::scalar::find_byte(bytes.data(), n, 'x'))
+                    << simd::isa_name(isa) << " n=" << n << " at=" << at;
+                bytes[at] = 'a';
+            }
+        }
+        std::vector<std::uint8_t> high(100, 0xFF);
+        high[77] = 0x80;
+        EXPECT_EQ(k.find_byte(high.data(), high.size(), 0x80), 77u) << simd::isa_name(isa);
+    }
+}
+
+TEST_F(SimdKernelsTest, PrefixSumAndFilterMatchScalar)
+{
+    for (simd::Isa isa : simd::supported_isas())
+    {
+        const simd::KernelTable& k = simd::kernels_for(isa);
+        for (std::size_t n : kernel_test_sizes())
+        {
+            std::vector<std::int32_t> values = make_ints(n, static_cast<std::uint32_t>(n) + 99);
+
+            std::vector<std::int32_t> expected(n);
+            simd::scalar::inclusive_scan_i32(values.data(), expected.data(), n);
+            std::vector<std::int32_t> scanned(n);
+            k.inclusive_scan_i32(values.data(), scanned.data(), n);
+            EXPECT_EQ(scanned, expected) << simd::isa_name(isa) << " n=" << n;
+
+            std::vector<std::int32_t> in_place = values;
+            k.inclusive_scan_i32(in_place.data(), in_place.data(), n);
+            EXPECT_EQ(in_place, expected) << simd::isa_name(isa) << " in place n=" << n;
+
+            std::vector<std::int32_t> kept_expected(n);
+            kept_expected.resize(simd::scalar::filter_greater_i32(values.data(), n, 0, kept_expected.data()));
+            // Guard lanes after the n-element output catch a store past the documented bound.
+            const std::size_t guard = 16;
+            std::vector<std::int32_t> kept(n + guard, -7);
+            std::size_t kept_count = k.filter_greater_i32(values.data(), n, 0, kept.data());
+            ASSERT_LE(kept_count, n);
+            EXPECT_TRUE(std::all_of(kept.begin() + static_cast<std::ptrdiff_t>(n), kept.end(),
+                                    [](std::int32_t v) { return v == -7; }))
+                << simd::isa_name(isa) << " wrote past out + n, n=" << n;
+            kept.resize(kept_count);
+            EXPECT_EQ(kept, kept_expected) << simd::isa_name(isa) << " n=" << n;
+        }
+    }
+
+    // Q: The AVX2 filter stores a full vector even when only two lanes survive. Why is that cheaper
+    //    than two scalar stores, and what does it require of the output buffer?
+    // A:
+    // R:
+}
+
+template<typename F>
+double time_ns_per_element(std::size_t n, int repetitions, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; ++r)
+    {
+        f();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (static_cast<double>(n) * repetitions);
+}
+
+void run_simd_benchmarks(std::size_t n, int repetitions)
+{
+    std::vector<std::int32_t> values = make_ints(n, 1);
+    // Sized for n: filter_greater_i32 needs room for every input, not just the kept ones.
+    std::vector<std::int32_t> out(n);
+    std::vector<float> a(n, 1.5f);
+    std::vector<float> b(n, 0.5f);
+    std::vector<std::uint8_t> bytes(n, 'a');
+    bytes[n - 1] = 'x';
+    volatile std::int64_t sink = 0;
+
+    for (simd::Isa isa : simd::supported_isas())
+    {
+        const simd::KernelTable& k = simd::kernels_for(isa);
+        double sum = time_ns_per_element(n, repetitions, [&]() { sink = sink + k.sum_i32(values.data(), n); });
+        double minmax = time_ns_per_element(n, repetitions, [&]() { sink = sink + k.min_max_i32(values.data(), n).max; });
+        double dot = time_ns_per_element(n, repetitions, [&]()
+        {
+            sink = sink + static_cast<std::int64_t>(k.dot_f32(a.data(), b.data(), n));
+        });
+        double find = time_ns_per_element(n, repetitions, [&]()
+        {
+            sink = sink + static_cast<std::int64_t>(k.find_byte(bytes.data(), n, 'x'));
+        });
+        double scan = time_ns_per_element(n, repetitions, [&]() { k.inclusive_scan_i32(values.data(), out.data(), n); });
+        double filter = time_ns_per_element(n, repetitions, [&]()
+        {
+            sink = sink + static_cast<std::int64_t>(k.filter_greater_i32(values.data(), n, 0, out.data()));
+        });
+        std::cout << "[ BENCH    ] n=" << n << " " << simd::isa_name(isa) << " ns/elem: sum=" << sum
+                  << " min_max=" << minmax << " dot=" << dot << " find_byte=" << find << " scan=" << scan
+                  << " filter=" << filter << "\n";
+    }
+}
+
+TEST_F(SimdKernelsTest, KernelBenchmark)
+{
+    // Q: find_byte processes bytes while the other kernels process four-byte lanes. Which kernels stop
+    //    scaling with vector width once n exceeds the L2 cache, and what limits them there?
+    // A:
+    // R:
+
+    run_simd_benchmarks(std::size_t(1) << 14, 20);
+}
+
+TEST_F(SimdKernelsTest, DISABLED_KernelBenchmarkSweep)
+{
+    for (std::size_t n = std::size_t(1) << 10; n <= (std::size_t(1) << 26); n <<= 4)
+    {
+        run_simd_benchmarks(n, static_cast<int>(std::max<std::size_t>(1, (std::size_t(1) << 28) / n)));
+    }
+}
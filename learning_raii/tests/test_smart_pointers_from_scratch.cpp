@@ -2,8 +2,1378 @@
 // Estimated Time: 4 hours
 // Difficulty: Moderate
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // TODO: Implement test cases for custom unique_ptr
-// TODO: Implement test cases for custom shared_ptr
-// TODO: Implement test cases for reference counting implementation
+
+class SmartPointersFromScratchTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// intrusive_ptr<T>: The Count Lives in the Object
+// ============================================================================
+
+// std::shared_ptr keeps its counts in a control block: a second allocation (unless
+// make_shared), a second pointer in every shared_ptr, and a second cache line to touch on
+// every copy. An intrusive count sits inside the object. The pointer is one word, copying
+// touches only the object, and a raw T* can be turned back into an owner at any time.
+//
+// The policy decides what a count is: an atomic for objects shared between threads, a
+// plain integer when they never leave one thread.
+
+struct thread_safe_count
+{
+    using counter = std::atomic<std::uint32_t>;
+
+    static std::uint32_t load(const counter& c) noexcept { return c.load(std::memory_order_acquire); }
+
+    // A new reference can only come from an existing one, which already keeps the object
+    // alive, so the increment needs no ordering.
+    static void increment(counter& c) noexcept { c.fetch_add(1, std::memory_order_relaxed); }
+
+    // true for the last reference. Release publishes this owner's writes; acquire makes the
+    // thread that destroys the object see every owner's writes.
+    static bool decrement(counter& c) noexcept { return c.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+    static bool increment_if_nonzero(counter& c) noexcept
+    {
+        std::uint32_t seen = c.load(std::memory_order_relaxed);
+        while (seen != 0)
+        {
+            if (c.compare_exchange_weak(seen, seen + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+struct single_thread_count
+{
+    using counter = std::uint32_t;
+
+    static std::uint32_t load(const counter& c) noexcept { return c; }
+    static void increment(counter& c) noexcept { ++c; }
+
+    // GCC 12+ inlines a copy's release next to the original's and, not knowing the copy
+    // kept the count above zero, reports this decrement as a use after the other's delete.
+    // Only the release that reaches zero deletes, and nothing touches the count after it.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuse-after-free"
+#endif
+    static bool decrement(counter& c) noexcept { return --c == 0; }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic pop
+#endif
+
+    static bool increment_if_nonzero(counter& c) noexcept
+    {
+        if (c == 0)
+        {
+            return false;
+        }
+        ++c;
+        return true;
+    }
+};
+
+// Base for intrusively counted types: class Node : public ref_counted<Node> { ... }.
+// intrusive_ptr finds the hooks below by argument-dependent lookup, as with boost::intrusive_ptr.
+template<typename Derived, typename CountPolicy = thread_safe_count>
+class ref_counted
+{
+public:
+    using count_policy = CountPolicy;
+
+    std::uint32_t use_count() const noexcept { return CountPolicy::load(refs_); }
+
+protected:
+    ref_counted() noexcept
+    : refs_(0)
+    {
+    }
+
+    // A copy of the object is a new object: it starts with no owners.
+    ref_counted(const ref_counted&) noexcept
+    : refs_(0)
+    {
+    }
+
+    ref_counted& operator=(const ref_counted&) noexcept { return *this; }
+
+    ~ref_counted() = default;
+
+private:
+    friend void intrusive_ptr_add_ref(const ref_counted* p) noexcept { CountPolicy::increment(p->refs_); }
+
+    friend void intrusive_ptr_release(const ref_counted* p) noexcept
+    {
+        if (CountPolicy::decrement(p->refs_))
+        {
+            delete static_cast<const Derived*>(p);
+        }
+    }
+
+    mutable typename CountPolicy::counter refs_;
+};
+
+template<typename T>
+class intrusive_ptr
+{
+public:
+    using element_type = T;
+
+    intrusive_ptr() noexcept
+    : p_(nullptr)
+    {
+    }
+
+    // add_ref = false adopts a reference the caller already owns (see detach()).
+    explicit intrusive_ptr(T* p, bool add_ref = true) noexcept
+    : p_(p)
+    {
+        if (p_ != nullptr && add_ref)
+        {
+            intrusive_ptr_add_ref(p_);
+        }
+    }
+
+    intrusive_ptr(const intrusive_ptr& other) noexcept
+    : intrusive_ptr(other.p_)
+    {
+    }
+
+    intrusive_ptr(intrusive_ptr&& other) noexcept
+    : p_(std::exchange(other.p_, nullptr))
+    {
+    }
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    intrusive_ptr(const intrusive_ptr<U>& other) noexcept
+    : intrusive_ptr(other.get())
+    {
+    }
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    intrusive_ptr(intrusive_ptr<U>&& other) noexcept
+    : p_(other.detach())
+    {
+    }
+
+    ~intrusive_ptr()
+    {
+        if (p_ != nullptr)
+        {
+            intrusive_ptr_release(p_);
+        }
+    }
+
+    intrusive_ptr& operator=(intrusive_ptr other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void reset() noexcept { intrusive_ptr().swap(*this); }
+    void swap(intrusive_ptr& other) noexcept { std::swap(p_, other.p_); }
+
+    // Gives up ownership without releasing; the caller now owns one reference.
+    T* detach() noexcept { return std::exchange(p_, nullptr); }
+
+    T* get() const noexcept { return p_; }
+    T& operator*() const noexcept { return *p_; }
+    T* operator->() const noexcept { return p_; }
+    explicit operator bool() const noexcept { return p_ != nullptr; }
+
+    friend bool operator==(const intrusive_ptr& a, const intrusive_ptr& b) { return a.p_ == b.p_; }
+    friend bool operator!=(const intrusive_ptr& a, const intrusive_ptr& b) { return a.p_ != b.p_; }
+
+private:
+    T* p_;
+};
+
+// ----------------------------------------------------------------------------
+// Optional intrusive weak references
+// ----------------------------------------------------------------------------
+
+// A weak reference must be able to ask "is it still alive?" after the object is gone, so
+// the counts cannot die with it. weak_ref_counted types are therefore only created by
+// make_intrusive, which puts the counts in the same allocation just before the object:
+//
+//     [ strong | weak | padding ][ Derived ... ]
+//
+// Still one allocation and no pointer to a control block: the counts are found from the
+// object's address. The last strong reference destroys the object; the memory goes when
+// the last weak reference does (the strong owners together hold one weak reference).
+template<typename CountPolicy>
+struct weak_counts
+{
+    typename CountPolicy::counter strong{0};
+    typename CountPolicy::counter weak{1};
+};
+
+template<typename Derived, typename CountPolicy = thread_safe_count>
+class weak_ref_counted
+{
+public:
+    using count_policy = CountPolicy;
+    using weak_base = weak_ref_counted;
+    using counts = weak_counts<CountPolicy>;
+
+    std::uint32_t use_count() const noexcept { return CountPolicy::load(counts_of(derived())->strong); }
+
+    // `new Derived` would have nowhere to put the counts.
+    static void* operator new(std::size_t) = delete;
+
+    template<typename... Args>
+    static Derived* create(Args&&... args)
+    {
+        static_assert(alignof(Derived) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned types need aligned new");
+        void* block = ::operator new(header_bytes() + sizeof(Derived));
+        counts* c = ::new (block) counts();
+        try
+        {
+            return ::new (static_cast<void*>(object_storage(c))) Derived(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            c->~counts();
+            ::operator delete(block);
+            throw;
+        }
+    }
+
+    static counts* counts_of(const Derived* object) noexcept
+    {
+        auto* bytes = reinterpret_cast<unsigned char*>(const_cast<Derived*>(object));
+        return std::launder(reinterpret_cast<counts*>(bytes - header_bytes()));
+    }
+
+    // Only for a live object: the caller holds or has just acquired a strong reference.
+    static Derived* object_of(counts* c) noexcept
+    {
+        return std::launder(reinterpret_cast<Derived*>(object_storage(c)));
+    }
+
+    static Derived* try_lock(counts* c) noexcept
+    {
+        return CountPolicy::increment_if_nonzero(c->strong) ? object_of(c) : nullptr;
+    }
+
+    static void add_weak(counts* c) noexcept { CountPolicy::increment(c->weak); }
+
+    static void release_weak(counts* c) noexcept
+    {
+        if (CountPolicy::decrement(c->weak))
+        {
+            c->~counts();
+            ::operator delete(static_cast<void*>(c));
+        }
+    }
+
+protected:
+    weak_ref_counted() noexcept = default;
+    weak_ref_counted(const weak_ref_counted&) noexcept = default;
+    weak_ref_counted& operator=(const weak_ref_counted&) noexcept = default;
+    ~weak_ref_counted() = default;
+
+private:
+    static constexpr std::size_t header_bytes()
+    {
+        return (sizeof(counts) + alignof(Derived) - 1) / alignof(Derived) * alignof(Derived);
+    }
+
+    static unsigned char* object_storage(counts* c) noexcept
+    {
+        return reinterpret_cast<unsigned char*>(c) + header_bytes();
+    }
+
+    const Derived* derived() const noexcept { return static_cast<const Derived*>(this); }
+
+    friend void intrusive_ptr_add_ref(const weak_ref_counted* p) noexcept
+    {
+        CountPolicy::increment(counts_of(p->derived())->strong);
+    }
+
+    friend void intrusive_ptr_release(const weak_ref_counted* p) noexcept
+    {
+        counts* c = counts_of(p->derived());
+        if (CountPolicy::decrement(c->strong))
+        {
+            p->derived()->~Derived();
+            release_weak(c);
+        }
+    }
+};
+
+template<typename T, typename = void>
+struct has_weak_base : std::false_type
+{
+};
+
+template<typename T>
+struct has_weak_base<T, std::void_t<typename T::weak_base>> : std::true_type
+{
+};
+
+template<typename T, typename... Args>
+intrusive_ptr<T> make_intrusive(Args&&... args)
+{
+    if constexpr (has_weak_base<T>::value)
+    {
+        return intrusive_ptr<T>(T::create(std::forward<Args>(args)...));
+    }
+    else
+    {
+        return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+}
+
+template<typename T>
+class intrusive_weak_ptr
+{
+    using base = typename T::weak_base;
+    using counts = typename base::counts;
+
+public:
+    intrusive_weak_ptr() noexcept
+    : c_(nullptr)
+    {
+    }
+
+    intrusive_weak_ptr(const intrusive_ptr<T>& strong) noexcept
+    : c_(strong ? base::counts_of(strong.get()) : nullptr)
+    {
+        if (c_ != nullptr)
+        {
+            base::add_weak(c_);
+        }
+    }
+
+    intrusive_weak_ptr(const intrusive_weak_ptr& other) noexcept
+    : c_(other.c_)
+    {
+        if (c_ != nullptr)
+        {
+            base::add_weak(c_);
+        }
+    }
+
+    intrusive_weak_ptr(intrusive_weak_ptr&& other) noexcept
+    : c_(std::exchange(other.c_, nullptr))
+    {
+    }
+
+    ~intrusive_weak_ptr()
+    {
+        if (c_ != nullptr)
+        {
+            base::release_weak(c_);
+        }
+    }
+
+    intrusive_weak_ptr& operator=(intrusive_weak_ptr other) noexcept
+    {
+        std::swap(c_, other.c_);
+        return *this;
+    }
+
+    intrusive_ptr<T> lock() const noexcept
+    {
+        return intrusive_ptr<T>(c_ != nullptr ? base::try_lock(c_) : nullptr, false);
+    }
+
+    bool expired() const noexcept
+    {
+        return c_ == nullptr || T::count_policy::load(c_->strong) == 0;
+    }
+
+private:
+    counts* c_;
+};
+
+// ----------------------------------------------------------------------------
+// Test types
+// ----------------------------------------------------------------------------
+
+class SharedNode : public ref_counted<SharedNode>
+{
+public:
+    explicit SharedNode(const std::string& name)
+    : tracked(name)
+    {
+    }
+
+    Tracked tracked;
+    std::uint64_t payload = 0;
+};
+
+class LocalNode : public ref_counted<LocalNode, single_thread_count>
+{
+public:
+    explicit LocalNode(const std::string& name)
+    : tracked(name)
+    {
+    }
+
+    Tracked tracked;
+};
+
+class TreeNode : public weak_ref_counted<TreeNode>
+{
+public:
+    explicit TreeNode(const std::string& name)
+    : tracked(name)
+    {
+    }
+
+    Tracked tracked;
+    intrusive_weak_ptr<TreeNode> parent;
+    std::vector<intrusive_ptr<TreeNode>> children;
+};
+
+static_assert(sizeof(intrusive_ptr<SharedNode>) == sizeof(void*), "one word, no control block pointer");
+static_assert(sizeof(std::shared_ptr<SharedNode>) == 2 * sizeof(void*), "");
+static_assert(std::is_same<LocalNode::count_policy::counter, std::uint32_t>::value, "plain increments");
+
+TEST_F(SmartPointersFromScratchTest, IntrusivePtrSharesTheCountInsideTheObject)
+{
+    {
+        intrusive_ptr<SharedNode> a = make_intrusive<SharedNode>("node");
+        EXPECT_EQ(a->use_count(), 1u);
+        {
+            intrusive_ptr<SharedNode> b = a;
+            intrusive_ptr<SharedNode> c;
+            c = b;
+            EXPECT_EQ(a->use_count(), 3u);
+
+            // Unlike `std::shared_ptr<T> another(raw)` in the anti-pattern lessons, wrapping
+            // the raw pointer again just joins the existing count.
+            SharedNode* raw = a.get();
+            intrusive_ptr<SharedNode> rewrapped(raw);
+            EXPECT_EQ(a->use_count(), 4u);
+        }
+        EXPECT_EQ(a->use_count(), 1u);
+
+        intrusive_ptr<SharedNode> moved = std::move(a);
+        EXPECT_FALSE(a);
+        EXPECT_EQ(moved->use_count(), 1u);
+
+        SharedNode* detached = moved.detach();
+        intrusive_ptr<SharedNode> adopted(detached, false);
+        EXPECT_EQ(adopted->use_count(), 1u);
+        EXPECT_EQ(EventLog::instance().count_events("::dtor"), 0u);
+    }
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(node)::dtor"), 1u);
+
+    {
+        intrusive_ptr<LocalNode> local = make_intrusive<LocalNode>("local");
+        intrusive_ptr<LocalNode> copy = local;
+        EXPECT_EQ(copy->use_count(), 2u);
+    }
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(local)::dtor"), 1u);
+
+    // Q: Rewrapping a raw pointer is safe here and a double delete with shared_ptr. Which
+    //    standard facility gives shared_ptr the same ability, and what does it cost?
+    // A:
+    // R:
+}
+
+TEST_F(SmartPointersFromScratchTest, IntrusiveWeakReferencesOutliveTheObject)
+{
+    intrusive_weak_ptr<TreeNode> watch_child;
+    {
+        intrusive_ptr<TreeNode> root = make_intrusive<TreeNode>("root");
+        intrusive_ptr<TreeNode> child = make_intrusive<TreeNode>("child");
+        child->parent = root;
+        root->children.push_back(child);
+        watch_child = child;
+        EXPECT_EQ(child->use_count(), 2u);
+
+        intrusive_ptr<TreeNode> parent = child->parent.lock();
+        ASSERT_TRUE(parent);
+        EXPECT_EQ(parent->tracked.name(), "root");
+        EXPECT_EQ(root->use_count(), 2u) << "lock() produced a strong reference";
+    }
+
+    // The parent link was weak, so there was no cycle: both nodes are gone.
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(root)::dtor"), 1u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(child)::dtor"), 1u);
+    EXPECT_TRUE(watch_child.expired());
+    EXPECT_FALSE(watch_child.lock());
+
+    // Q: The object is destroyed here but its memory is not freed until watch_child goes
+    //    away. Which make_shared trade-off is this, and when does it matter?
+    // A:
+    // R:
+}
+
+TEST_F(SmartPointersFromScratchTest, IntrusivePtrCountsStayExactAcrossThreads)
+{
+    intrusive_ptr<SharedNode> source = make_intrusive<SharedNode>("source");
+    intrusive_weak_ptr<TreeNode> weak_tree;
+    intrusive_ptr<TreeNode> tree = make_intrusive<TreeNode>("tree");
+    weak_tree = tree;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&source, &weak_tree] {
+            for (int i = 0; i < 10000; ++i)
+            {
+                intrusive_ptr<SharedNode> copy = source;
+                intrusive_ptr<SharedNode> moved = std::move(copy);
+                intrusive_ptr<TreeNode> locked = weak_tree.lock();
+                EXPECT_TRUE(locked);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(source->use_count(), 1u);
+    EXPECT_EQ(tree->use_count(), 1u);
+    EXPECT_EQ(EventLog::instance().count_events("::dtor"), 0u);
+}
+
+// ----------------------------------------------------------------------------
+// Benchmark: copy/destroy churn and the extra cache miss of a control block
+// ----------------------------------------------------------------------------
+
+// Copies and drops `copies` references to one object: the uncontended RMW cost per copy.
+template<typename Ptr>
+double copy_destroy_ns(const Ptr& source, int copies)
+{
+    double ms = time_ms([&] {
+        for (int i = 0; i < copies; ++i)
+        {
+            Ptr copy = source;
+            Ptr again = copy;
+        }
+    });
+    return ms * 1e6 / copies;
+}
+
+// Copies a pointer to each of many objects in random order and reads the payload: every
+// copy touches the count, every read touches the object. With a separate control block
+// those are two cache misses; make_shared and intrusive counts put them on the same line.
+template<typename Ptr>
+double scattered_copy_ns(const std::vector<Ptr>& objects, const std::vector<std::size_t>& order,
+                         std::uint64_t& sink)
+{
+    double ms = time_ms([&] {
+        for (std::size_t index : order)
+        {
+            Ptr copy = objects[index];
+            sink += copy->payload;
+        }
+    });
+    return ms * 1e6 / static_cast<double>(order.size());
+}
+
+struct PlainPayload
+{
+    std::uint64_t payload = 1;
+    char padding[120] = {};
+};
+
+struct IntrusivePayload : ref_counted<IntrusivePayload>
+{
+    std::uint64_t payload = 1;
+    char padding[120] = {};
+};
+
+// libstdc++'s shared_ptr skips the atomic instructions until the process has started a
+// second thread; the servers this models always have.
+void ensure_multithreaded()
+{
+    std::thread([] {}).join();
+}
+
+void run_refcount_benchmark(int copies, std::size_t objects)
+{
+    EventLog::instance().clear();
+    ensure_multithreaded();
+    auto shared = std::make_shared<SharedNode>("bench");
+    auto intrusive = make_intrusive<SharedNode>("bench");
+    auto local = make_intrusive<LocalNode>("bench");
+    std::cout << "[ BENCH    ] copy+destroy ns/copy: shared_ptr=" << copy_destroy_ns(shared, copies) / 2
+              << " intrusive_ptr(atomic)=" << copy_destroy_ns(intrusive, copies) / 2
+              << " intrusive_ptr(single_thread)=" << copy_destroy_ns(local, copies) / 2 << "\n";
+
+    // Allocations interleaved with padding so objects (and control blocks) scatter.
+    std::vector<std::shared_ptr<PlainPayload>> separate;
+    std::vector<std::shared_ptr<PlainPayload>> combined;
+    std::vector<intrusive_ptr<IntrusivePayload>> embedded;
+    std::vector<std::unique_ptr<char[]>> spacers;
+    for (std::size_t i = 0; i < objects; ++i)
+    {
+        separate.emplace_back(new PlainPayload);
+        spacers.emplace_back(new char[200]);
+        combined.push_back(std::make_shared<PlainPayload>());
+        embedded.push_back(make_intrusive<IntrusivePayload>());
+    }
+
+    std::vector<std::size_t> order(objects);
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::shuffle(order.begin(), order.end(), std::mt19937(11));
+
+    std::uint64_t sums[3] = {};
+    double separate_ns = scattered_copy_ns(separate, order, sums[0]);
+    double combined_ns = scattered_copy_ns(combined, order, sums[1]);
+    double embedded_ns = scattered_copy_ns(embedded, order, sums[2]);
+    EXPECT_EQ(sums[0], objects);
+    EXPECT_EQ(sums[1], objects);
+    EXPECT_EQ(sums[2], objects);
+    std::cout << "[ BENCH    ] scattered copy+read ns (" << objects << " objects): shared_ptr(new)=" << separate_ns
+              << " make_shared=" << combined_ns << " intrusive_ptr=" << embedded_ns << "\n";
+}
+
+TEST_F(SmartPointersFromScratchTest, RefcountBenchmark)
+{
+    run_refcount_benchmark(1000000, 1 << 16);
+
+    // Q: ParallelCopyAndMoveOperations copies one shared_ptr from four threads. Neither
+    //    policy here helps with that: why does a single hot count stop scaling, whether
+    //    it lives in a control block or in the object?
+    // A:
+    // R:
+}
+
+TEST_F(SmartPointersFromScratchTest, DISABLED_RefcountBenchmarkLarge)
+{
+    run_refcount_benchmark(20000000, 1 << 20);
+}
+
+// ============================================================================
+// biased_shared_ptr<T>: Biased Reference Counting
+// ============================================================================
+
+// Most objects are copied almost only by the thread that created them (an io thread's
+// connection, a request's context). Biased reference counting (Choi et al., PACT 2018)
+// splits the count in two:
+//
+//   biased  - touched only by the owner thread, with plain loads and stores
+//   shared  - every other thread, atomically, plus two flags: MERGED and QUEUED
+//
+// The true count is biased + shared, so shared may go negative when another thread drops
+// a reference the owner handed it. The first time that happens the block is queued to the
+// owner, which folds its biased count into shared at its next release (or whenever
+// process_biased_merges() is called). The owner also merges when its biased count reaches
+// zero. After merging, the block is an ordinary atomic count and anyone may destroy it.
+//
+// The price is latency: a release by another thread is only settled once the owner runs
+// its queue, so destruction can be deferred, and a weak lock() can still succeed in that
+// window - as if it had happened just before the final release.
+
+class biased_control_block;
+
+class biased_merge_queue
+{
+public:
+    void push(biased_control_block* block);
+    void drain();
+    void retire();
+
+    bool has_work() const noexcept { return has_work_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<biased_control_block*> take();
+
+    std::mutex mutex_;
+    std::vector<biased_control_block*> pending_;
+    std::atomic<bool> has_work_{false};
+    bool retired_ = false;
+};
+
+// The queue outlives its thread while blocks still name it as their owner, so a new
+// thread's queue can never be mistaken for it at the same address.
+struct biased_thread_state
+{
+    std::shared_ptr<biased_merge_queue> queue = std::make_shared<biased_merge_queue>();
+
+    ~biased_thread_state()
+    {
+        queue->retire();
+    }
+};
+
+// A plain pointer with a constant initializer: reading it needs no thread_local init guard,
+// which keeps the owner check on the copy path to one TLS load and a compare.
+inline biased_merge_queue*& this_thread_queue_slot()
+{
+    thread_local biased_merge_queue* slot = nullptr;
+    return slot;
+}
+
+inline biased_thread_state& this_thread_biased_state()
+{
+    thread_local biased_thread_state state;
+    this_thread_queue_slot() = state.queue.get();
+    return state;
+}
+
+inline biased_merge_queue* this_thread_merge_queue()
+{
+    biased_merge_queue* queue = this_thread_queue_slot();
+    return queue != nullptr ? queue : this_thread_biased_state().queue.get();
+}
+
+inline void process_biased_merges()
+{
+    this_thread_merge_queue()->drain();
+}
+
+class biased_control_block
+{
+public:
+    biased_control_block()
+    : home_(this_thread_biased_state().queue)
+    , owner_(home_.get())
+    {
+    }
+
+    biased_control_block(const biased_control_block&) = delete;
+    biased_control_block& operator=(const biased_control_block&) = delete;
+
+    void add_ref() noexcept
+    {
+        if (owner_.load(std::memory_order_relaxed) == this_thread_merge_queue())
+        {
+            biased_.store(biased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        else
+        {
+            shared_.fetch_add(kOne, std::memory_order_relaxed);
+        }
+    }
+
+    void release() noexcept
+    {
+        biased_merge_queue* current = this_thread_merge_queue();
+        if (owner_.load(std::memory_order_relaxed) != current)
+        {
+            release_shared();
+            return;
+        }
+        std::uint32_t left = biased_.load(std::memory_order_relaxed) - 1;
+        biased_.store(left, std::memory_order_relaxed);
+        if (left == 0)
+        {
+            merge();
+        }
+        else if (current->has_work())
+        {
+            current->drain();
+        }
+    }
+
+    // weak_ptr::lock. An unmerged block cannot have been disposed, so the shared count may
+    // be bumped unconditionally; once merged it behaves like shared_ptr's increment-if-nonzero.
+    bool try_add_ref() noexcept
+    {
+        biased_merge_queue* current = this_thread_merge_queue();
+        if (owner_.load(std::memory_order_relaxed) == current && current->has_work())
+        {
+            current->drain();
+        }
+        if (owner_.load(std::memory_order_relaxed) == current)
+        {
+            biased_.store(biased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+        std::int64_t seen = shared_.load(std::memory_order_relaxed);
+        do
+        {
+            if ((seen & kMerged) != 0 && count_of(seen) == 0)
+            {
+                return false;
+            }
+        } while (!shared_.compare_exchange_weak(seen, seen + kOne, std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return true;
+    }
+
+    // Like shared_ptr::use_count, only a snapshot; pending cross-thread releases count as done.
+    long use_count() const noexcept
+    {
+        return static_cast<long>(biased_.load(std::memory_order_relaxed)) +
+               static_cast<long>(count_of(shared_.load(std::memory_order_relaxed)));
+    }
+
+    void add_weak() noexcept { thread_safe_count::increment(weak_); }
+
+    void release_weak() noexcept
+    {
+        if (thread_safe_count::decrement(weak_))
+        {
+            destroy();
+        }
+    }
+
+protected:
+    virtual ~biased_control_block() = default;
+
+private:
+    friend class biased_merge_queue;
+
+    static constexpr std::int64_t kMerged = 1;
+    static constexpr std::int64_t kQueued = 2;
+    static constexpr std::int64_t kOne = 4;
+
+    static std::int64_t count_of(std::int64_t word) noexcept { return (word - (word & 3)) / kOne; }
+
+    virtual void dispose() noexcept = 0;  // destroy the object
+    virtual void destroy() noexcept = 0;  // free the block
+
+    void release_shared() noexcept
+    {
+        std::int64_t seen = shared_.load(std::memory_order_relaxed);
+        std::int64_t next = 0;
+        bool enqueue = false;
+        bool pinned = false;
+        do
+        {
+            next = seen - kOne;
+            enqueue = (seen & (kMerged | kQueued)) == 0 && count_of(next) < 0;
+            if (enqueue)
+            {
+                // The queue entry needs a weak reference, and it has to be taken while this
+                // thread's strong reference still keeps the block alive: once QUEUED is
+                // published the owner may merge and free it.
+                if (!pinned)
+                {
+                    add_weak();
+                    pinned = true;
+                }
+                next |= kQueued;
+            }
+        } while (!shared_.compare_exchange_weak(seen, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        if (enqueue)
+        {
+            home_->push(this);
+            return;
+        }
+        if ((next & kMerged) != 0 && count_of(next) == 0)
+        {
+            dispose_and_release();
+        }
+        if (pinned)
+        {
+            release_weak();
+        }
+    }
+
+    // Owner thread only, or any thread once the owner has exited.
+    void merge() noexcept
+    {
+        std::int64_t biased = biased_.load(std::memory_order_relaxed);
+        biased_.store(0, std::memory_order_relaxed);
+        owner_.store(nullptr, std::memory_order_relaxed);
+        std::int64_t seen = shared_.load(std::memory_order_relaxed);
+        std::int64_t next = 0;
+        do
+        {
+            next = ((seen & ~kQueued) + biased * kOne) | kMerged;
+        } while (!shared_.compare_exchange_weak(seen, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        if (count_of(next) == 0)
+        {
+            dispose_and_release();
+        }
+    }
+
+    void dispose_and_release() noexcept
+    {
+        dispose();
+        release_weak();
+    }
+
+    std::shared_ptr<biased_merge_queue> home_;
+    std::atomic<biased_merge_queue*> owner_;  // null once merged
+    std::atomic<std::uint32_t> biased_{1};    // relaxed loads and stores only: no RMW
+    std::atomic<std::int64_t> shared_{0};
+    thread_safe_count::counter weak_{1};  // +1 held by the strong references as a group
+};
+
+inline std::vector<biased_control_block*> biased_merge_queue::take()
+{
+    std::vector<biased_control_block*> taken;
+    taken.swap(pending_);
+    has_work_.store(false, std::memory_order_relaxed);
+    return taken;
+}
+
+inline void biased_merge_queue::push(biased_control_block* block)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!retired_)
+        {
+            pending_.push_back(block);
+            has_work_.store(true, std::memory_order_relaxed);
+            return;
+        }
+    }
+    // The owner thread is gone; nobody else touches the biased count, so merge here.
+    block->merge();
+    block->release_weak();
+}
+
+// Disposing may release more pointers, and queue more work, so blocks are processed
+// outside the lock.
+inline void biased_merge_queue::drain()
+{
+    std::vector<biased_control_block*> taken;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        taken = take();
+    }
+    for (biased_control_block* block : taken)
+    {
+        if (block->owner_.load(std::memory_order_relaxed) == this)
+        {
+            block->merge();
+        }
+        block->release_weak();
+    }
+}
+
+inline void biased_merge_queue::retire()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_ = true;
+    }
+    drain();
+}
+
+template<typename P, typename D>
+class biased_block_with_deleter final : public biased_control_block
+{
+public:
+    biased_block_with_deleter(P p, D deleter)
+    : ptr_(p)
+    , deleter_(std::move(deleter))
+    {
+    }
+
+private:
+    void dispose() noexcept override { deleter_(ptr_); }
+    void destroy() noexcept override { delete this; }
+
+    P ptr_;
+    D deleter_;
+};
+
+template<typename T>
+class biased_block_inplace final : public biased_control_block
+{
+public:
+    template<typename... Args>
+    explicit biased_block_inplace(Args&&... args)
+    {
+        ::new (static_cast<void*>(storage_)) T(std::forward<Args>(args)...);
+    }
+
+    T* object() noexcept { return std::launder(reinterpret_cast<T*>(storage_)); }
+
+private:
+    void dispose() noexcept override { object()->~T(); }
+    void destroy() noexcept override { delete this; }
+
+    alignas(T) unsigned char storage_[sizeof(T)];
+};
+
+template<typename T>
+class biased_weak_ptr;
+
+template<typename T>
+class biased_shared_ptr
+{
+public:
+    using element_type = T;
+
+    biased_shared_ptr() noexcept
+    : ptr_(nullptr)
+    , block_(nullptr)
+    {
+    }
+
+    template<typename U>
+    explicit biased_shared_ptr(U* p)
+    : biased_shared_ptr(p, std::default_delete<U>())
+    {
+    }
+
+    template<typename U, typename D>
+    biased_shared_ptr(U* p, D deleter)
+    : ptr_(p)
+    , block_(nullptr)
+    {
+        try
+        {
+            block_ = new biased_block_with_deleter<U*, D>(p, deleter);
+        }
+        catch (...)
+        {
+            deleter(p);
+            throw;
+        }
+    }
+
+    // Aliasing: shares ownership with owner but points at p (usually a member of it).
+    template<typename U>
+    biased_shared_ptr(const biased_shared_ptr<U>& owner, T* p) noexcept
+    : ptr_(p)
+    , block_(owner.block_)
+    {
+        if (block_ != nullptr)
+        {
+            block_->add_ref();
+        }
+    }
+
+    biased_shared_ptr(const biased_shared_ptr& other) noexcept
+    : biased_shared_ptr(other, other.ptr_)
+    {
+    }
+
+    biased_shared_ptr(biased_shared_ptr&& other) noexcept
+    : ptr_(std::exchange(other.ptr_, nullptr))
+    , block_(std::exchange(other.block_, nullptr))
+    {
+    }
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    biased_shared_ptr(const biased_shared_ptr<U>& other) noexcept
+    : biased_shared_ptr(other, other.ptr_)
+    {
+    }
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    biased_shared_ptr(biased_shared_ptr<U>&& other) noexcept
+    : ptr_(std::exchange(other.ptr_, nullptr))
+    , block_(std::exchange(other.block_, nullptr))
+    {
+    }
+
+    ~biased_shared_ptr()
+    {
+        if (block_ != nullptr)
+        {
+            block_->release();
+        }
+    }
+
+    biased_shared_ptr& operator=(biased_shared_ptr other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    void reset() noexcept { biased_shared_ptr().swap(*this); }
+
+    template<typename U>
+    void reset(U* p)
+    {
+        biased_shared_ptr(p).swap(*this);
+    }
+
+    template<typename U, typename D>
+    void reset(U* p, D deleter)
+    {
+        biased_shared_ptr(p, std::move(deleter)).swap(*this);
+    }
+
+    void swap(biased_shared_ptr& other) noexcept
+    {
+        std::swap(ptr_, other.ptr_);
+        std::swap(block_, other.block_);
+    }
+
+    T* get() const noexcept { return ptr_; }
+    T& operator*() const noexcept { return *ptr_; }
+    T* operator->() const noexcept { return ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+    long use_count() const noexcept { return block_ != nullptr ? block_->use_count() : 0; }
+
+private:
+    template<typename>
+    friend class biased_shared_ptr;
+    template<typename>
+    friend class biased_weak_ptr;
+    template<typename U, typename... Args>
+    friend biased_shared_ptr<U> make_biased_shared(Args&&... args);
+
+    struct adopt_t
+    {
+    };
+
+    // Adopts a reference the caller already holds.
+    biased_shared_ptr(adopt_t, T* p, biased_control_block* block) noexcept
+    : ptr_(p)
+    , block_(block)
+    {
+    }
+
+    T* ptr_;
+    biased_control_block* block_;
+};
+
+template<typename T, typename... Args>
+biased_shared_ptr<T> make_biased_shared(Args&&... args)
+{
+    auto* block = new biased_block_inplace<T>(std::forward<Args>(args)...);
+    return biased_shared_ptr<T>(typename biased_shared_ptr<T>::adopt_t(), block->object(), block);
+}
+
+template<typename T>
+class biased_weak_ptr
+{
+public:
+    biased_weak_ptr() noexcept
+    : ptr_(nullptr)
+    , block_(nullptr)
+    {
+    }
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    biased_weak_ptr(const biased_shared_ptr<U>& strong) noexcept
+    : ptr_(strong.ptr_)
+    , block_(strong.block_)
+    {
+        if (block_ != nullptr)
+        {
+            block_->add_weak();
+        }
+    }
+
+    biased_weak_ptr(const biased_weak_ptr& other) noexcept
+    : ptr_(other.ptr_)
+    , block_(other.block_)
+    {
+        if (block_ != nullptr)
+        {
+            block_->add_weak();
+        }
+    }
+
+    biased_weak_ptr(biased_weak_ptr&& other) noexcept
+    : ptr_(std::exchange(other.ptr_, nullptr))
+    , block_(std::exchange(other.block_, nullptr))
+    {
+    }
+
+    ~biased_weak_ptr()
+    {
+        if (block_ != nullptr)
+        {
+            block_->release_weak();
+        }
+    }
+
+    biased_weak_ptr& operator=(biased_weak_ptr other) noexcept
+    {
+        std::swap(ptr_, other.ptr_);
+        std::swap(block_, other.block_);
+        return *this;
+    }
+
+    biased_shared_ptr<T> lock() const noexcept
+    {
+        if (block_ != nullptr && block_->try_add_ref())
+        {
+            return biased_shared_ptr<T>(typename biased_shared_ptr<T>::adopt_t(), ptr_, block_);
+        }
+        return biased_shared_ptr<T>();
+    }
+
+    bool expired() const noexcept { return use_count() == 0; }
+    long use_count() const noexcept { return block_ != nullptr ? block_->use_count() : 0; }
+
+private:
+    T* ptr_;
+    biased_control_block* block_;
+};
+
+struct Connection
+{
+    explicit Connection(const std::string& name)
+    : tracked(name)
+    {
+    }
+
+    Tracked tracked;
+    std::uint64_t bytes = 0;
+};
+
+TEST_F(SmartPointersFromScratchTest, BiasedSharedPtrMatchesSharedPtrSemantics)
+{
+    {
+        biased_shared_ptr<Connection> conn = make_biased_shared<Connection>("conn");
+        biased_shared_ptr<Connection> copy = conn;
+        EXPECT_EQ(conn.use_count(), 2);
+
+        // Aliasing: points at a member, keeps the whole Connection alive.
+        biased_shared_ptr<std::uint64_t> bytes(conn, &conn->bytes);
+        biased_weak_ptr<Connection> weak = conn;
+        conn.reset();
+        copy.reset();
+        EXPECT_EQ(EventLog::instance().count_events("::dtor"), 0u);
+        EXPECT_FALSE(weak.expired());
+        *bytes = 42;
+        EXPECT_EQ(weak.lock()->bytes, 42u);
+
+        bytes.reset();
+        EXPECT_EQ(EventLog::instance().count_events("Tracked(conn)::dtor"), 1u);
+        EXPECT_TRUE(weak.expired());
+        EXPECT_FALSE(weak.lock());
+    }
+
+    {
+        biased_shared_ptr<Tracked> custom(new Tracked("custom"), LoggingDeleter<Tracked>("BiasedDeleter"));
+        biased_shared_ptr<Tracked> other = custom;
+        custom = std::move(other);
+        EXPECT_EQ(custom.use_count(), 1);
+    }
+    EXPECT_EQ(EventLog::instance().count_events("BiasedDeleter::operator()"), 1u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(custom)::dtor"), 1u);
+}
+
+TEST_F(SmartPointersFromScratchTest, BiasedSharedPtrSettlesCrossThreadReleasesThroughTheOwner)
+{
+    biased_shared_ptr<Connection> conn = make_biased_shared<Connection>("owned");
+    biased_shared_ptr<Connection> handed_off = conn;
+
+    // Another thread drops the copy it was given: its shared count goes to -1 and the block
+    // is queued to this thread. Nothing is destroyed - this thread still holds conn.
+    std::thread([moved = std::move(handed_off)]() mutable { moved.reset(); }).join();
+    EXPECT_EQ(conn.use_count(), 1);
+
+    // The owner's release sees the queued work, merges 1 + (-1) and destroys the object.
+    conn.reset();
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(owned)::dtor"), 1u);
+
+    // The reverse: a block created on a thread that has since exited. Its queue was retired,
+    // so the last release here merges on the spot.
+    biased_shared_ptr<Connection> orphan;
+    std::thread([&orphan] { orphan = make_biased_shared<Connection>("orphan"); }).join();
+    EXPECT_EQ(orphan.use_count(), 1);
+    orphan.reset();
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(orphan)::dtor"), 1u);
+
+    // Q: Between the worker's reset and the owner's next release, use_count() reads 0 but
+    //    the object is alive. Why can't the worker destroy it itself at that point?
+    // A:
+    // R:
+}
+
+TEST_F(SmartPointersFromScratchTest, BiasedSharedPtrCountsStayExactUnderContention)
+{
+    biased_shared_ptr<Connection> conn = make_biased_shared<Connection>("busy");
+    biased_weak_ptr<Connection> weak = conn;
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t)
+    {
+        biased_shared_ptr<Connection> mine = conn;
+        threads.emplace_back([mine, &weak, &go]() mutable {
+            while (!go.load())
+            {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < 5000; ++i)
+            {
+                biased_shared_ptr<Connection> copy = mine;
+                biased_shared_ptr<Connection> locked = weak.lock();
+                EXPECT_TRUE(locked);
+            }
+            mine.reset();
+        });
+    }
+    go.store(true);
+    for (int i = 0; i < 5000; ++i)
+    {
+        biased_shared_ptr<Connection> copy = conn;
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    process_biased_merges();
+    EXPECT_EQ(conn.use_count(), 1);
+    EXPECT_EQ(EventLog::instance().count_events("::dtor"), 0u);
+    conn.reset();
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(busy)::dtor"), 1u);
+    EXPECT_TRUE(weak.expired());
+}
+
+void run_biased_benchmark(int copies)
+{
+    EventLog::instance().clear();
+    ensure_multithreaded();
+    auto shared = std::make_shared<Connection>("bench");
+    auto biased = make_biased_shared<Connection>("bench");
+
+    // A request handler on the owning io thread copies and drops the connection pointer
+    // over and over; the copies from another thread are the rare case.
+    double shared_ns = copy_destroy_ns(shared, copies) / 2;
+    double biased_ns = copy_destroy_ns(biased, copies) / 2;
+
+    double foreign_ns = 0;
+    std::thread([&] { foreign_ns = copy_destroy_ns(biased, copies) / 2; }).join();
+    process_biased_merges();
+    EXPECT_EQ(biased.use_count(), 1);
+
+    std::cout << "[ BENCH    ] copy+destroy ns/copy on owner thread: shared_ptr=" << shared_ns
+              << " biased_shared_ptr=" << biased_ns << " | biased_shared_ptr from another thread=" << foreign_ns
+              << "\n";
+}
+
+TEST_F(SmartPointersFromScratchTest, BiasedRefcountBenchmark)
+{
+    run_biased_benchmark(2000000);
+
+    // Q: The owner-thread copy is a TLS lookup, a compare and a plain store. What does the
+    //    shared_ptr copy do that this avoids, and what does a non-owner pay instead?
+    // A:
+    // R:
+}
@@ -2,6 +2,13 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <cstdio>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
 class AllocationPatternsTest : public ::testing::Test
 {
 protected:
@@ -353,3 +360,309 @@ TEST_F(AllocationPatternsTest, SharedDeleterBetweenPointers)
     EXPECT_EQ(use_count, 2);
     EXPECT_FALSE(deleter_called_early);
 }
+// Per-thread hit/miss counts for every thread_block_cache, so tests can see whether an
+// allocation was recycled without naming the library's control block type.
+struct PooledAllocationStats
+{
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+};
+inline PooledAllocationStats& pooled_allocation_stats()
+{
+    thread_local PooledAllocationStats stats;
+    return stats;
+}
+// Every thread_block_cache the calling thread has used, linked through trivially
+// destructible nodes so the list stays valid however late in thread exit it is walked.
+struct block_cache_drain_link
+{
+    void (*drain)();
+    block_cache_drain_link* next;
+};
+inline block_cache_drain_link*& block_cache_drain_list()
+{
+    thread_local block_cache_drain_link* head = nullptr;
+    return head;
+}
+// Hands every block cached on the calling thread back to operator delete. The caches are
+// thread_local and outlive a single test, so the fixture drains them to keep hit/miss
+// counts independent of test order and of --gtest_repeat.
+inline void drain_thread_block_caches()
+{
+    for (block_cache_drain_link* link = block_cache_drain_list(); link != nullptr; link = link->next)
+    {
+        link->drain();
+    }
+}
+// Recycles blocks of one size on the calling thread: deallocate() pushes onto a free list
+// capped at kCachedBlocks and allocate() pops from it, falling back to operator new.
+// The list state is trivially destructible, so it survives until the very end of the
+// thread; a separate reaper returns the cached blocks at thread exit and closes the list.
+// Blocks freed on another thread join that thread's list.
+template<std::size_t Size, std::size_t Align>
+class thread_block_cache
+{
+public:
+    static constexpr std::size_t kCachedBlocks = 256;
+    static_assert(Size >= sizeof(void*), "a cached block must hold the free-list link");
+    static void* allocate()
+    {
+        cache_state& c = state();
+        if (c.head != nullptr)
+        {
+            node* n = c.head;
+            c.head = n->next;
+            --c.count;
+            ++pooled_allocation_stats().hits;
+            return n;
+        }
+        ++pooled_allocation_stats().misses;
+        return ::operator new(Size, std::align_val_t(Align));
+    }
+    static void deallocate(void* p) noexcept
+    {
+        cache_state& c = state();
+        if (c.closed || c.count == kCachedBlocks)
+        {
+            ::operator delete(p, std::align_val_t(Align));
+            return;
+        }
+        if (!c.armed)
+        {
+            arm_reaper();
+        }
+        node* n = static_cast<node*>(p);
+        n->next = c.head;
+        c.head = n;
+        ++c.count;
+    }
+private:
+    struct node
+    {
+        node* next;
+    };
+    struct cache_state
+    {
+        node* head;
+        std::size_t count;
+        bool armed;
+        bool closed;
+    };
+    struct reaper
+    {
+        ~reaper()
+        {
+            state().closed = true;
+            drain();
+        }
+    };
+    static cache_state& state()
+    {
+        thread_local cache_state c{nullptr, 0, false, false};
+        return c;
+    }
+    static void drain()
+    {
+        cache_state& c = state();
+        while (c.head != nullptr)
+        {
+            node* n = c.head;
+            c.head = n->next;
+            ::operator delete(n, std::align_val_t(Align));
+        }
+        c.count = 0;
+    }
+    static void arm_reaper()
+    {
+        thread_local reaper r;
+        thread_local block_cache_drain_link link{&drain, nullptr};
+        link.next = block_cache_drain_list();
+        block_cache_drain_list() = &link;
+        state().armed = true;
+    }
+};
+// The allocator std::allocate_shared rebinds to its combined control block type, so the
+// cache is keyed by exactly sizeof(control block + T). Arrays pass through to operator new.
+template<typename T>
+class thread_pool_allocator
+{
+public:
+    using value_type = T;
+    thread_pool_allocator() noexcept = default;
+    template<typename U>
+    thread_pool_allocator(const thread_pool_allocator<U>&) noexcept
+    {
+    }
+    T* allocate(std::size_t n)
+    {
+        if (n == 1)
+        {
+            return static_cast<T*>(thread_block_cache<sizeof(T), alignof(T)>::allocate());
+        }
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n == 1)
+        {
+            thread_block_cache<sizeof(T), alignof(T)>::deallocate(p);
+            return;
+        }
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+template<typename T, typename U>
+bool operator==(const thread_pool_allocator<T>&, const thread_pool_allocator<U>&) noexcept
+{
+    return true;
+}
+template<typename T, typename U>
+bool operator!=(const thread_pool_allocator<T>&, const thread_pool_allocator<U>&) noexcept
+{
+    return false;
+}
+// make_shared with the combined block recycled through the calling thread's cache.
+// The block goes back only when the last weak_ptr lets go, exactly as with make_shared.
+template<typename T, typename... Args>
+std::shared_ptr<T> allocate_shared_pooled(Args&&... args)
+{
+    return std::allocate_shared<T>(thread_pool_allocator<T>(), std::forward<Args>(args)...);
+}
+// Starts and ends every test with empty thread caches, so hit/miss counts don't depend on
+// test order or --gtest_repeat.
+class PooledAllocationTest : public AllocationPatternsTest
+{
+protected:
+    void SetUp() override
+    {
+        AllocationPatternsTest::SetUp();
+        drain_thread_block_caches();
+    }
+    void TearDown() override
+    {
+        drain_thread_block_caches();
+        AllocationPatternsTest::TearDown();
+    }
+};
+TEST_F(PooledAllocationTest, PooledAllocateSharedRecyclesTheCombinedBlock)
+{
+    PooledAllocationStats before = pooled_allocation_stats();
+    std::shared_ptr<Tracked> first = allocate_shared_pooled<Tracked>("PooledFirst");
+    Tracked* first_address = first.get();
+    first.reset();
+    std::shared_ptr<Tracked> second = allocate_shared_pooled<Tracked>("PooledSecond");
+    // Q: second.get() equals the address the first object had. What does that say about where
+    //    the control block of `second` lives?
+    // A:
+    // R:
+    EXPECT_EQ(second.get(), first_address);
+    EXPECT_EQ(pooled_allocation_stats().misses - before.misses, 1u);
+    EXPECT_EQ(pooled_allocation_stats().hits - before.hits, 1u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(PooledFirst)::dtor"), 1u);
+}
+TEST_F(PooledAllocationTest, PooledAllocateSharedKeepsWeakPtrSemantics)
+{
+    std::weak_ptr<Tracked> watcher;
+    {
+        std::shared_ptr<Tracked> owner = allocate_shared_pooled<Tracked>("PooledWatched");
+        watcher = owner;
+    }
+    // The object is gone but the weak_ptr still holds the combined block, so it cannot be
+    // recycled yet: the next allocation misses.
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(PooledWatched)::dtor"), 1u);
+    EXPECT_TRUE(watcher.expired());
+    PooledAllocationStats before = pooled_allocation_stats();
+    std::shared_ptr<Tracked> other = allocate_shared_pooled<Tracked>("PooledOther");
+    EXPECT_EQ(pooled_allocation_stats().misses - before.misses, 1u);
+    other.reset();
+    // Dropping the last weak_ptr releases the block, and it is reused straight away.
+    watcher.reset();
+    before = pooled_allocation_stats();
+    std::shared_ptr<Tracked> a = allocate_shared_pooled<Tracked>("PooledA");
+    std::shared_ptr<Tracked> b = allocate_shared_pooled<Tracked>("PooledB");
+    EXPECT_EQ(pooled_allocation_stats().hits - before.hits, 2u);
+    EXPECT_EQ(pooled_allocation_stats().misses - before.misses, 0u);
+    // Q: With make_shared a long-lived weak_ptr pins sizeof(T) bytes after the object dies.
+    //    Does pooling make that better, worse, or the same?
+    // A:
+    // R:
+}
+TEST_F(PooledAllocationTest, PooledAllocateSharedAcceptsCrossThreadRelease)
+{
+    std::vector<std::shared_ptr<Tracked>> made;
+    std::thread maker([&made]() {
+        for (int i = 0; i < 8; ++i)
+        {
+            made.push_back(allocate_shared_pooled<Tracked>("PooledCross"));
+        }
+    });
+    maker.join();
+    // Released here, the blocks join this thread's cache.
+    made.clear();
+    PooledAllocationStats before = pooled_allocation_stats();
+    for (int i = 0; i < 8; ++i)
+    {
+        made.push_back(allocate_shared_pooled<Tracked>("PooledLocal"));
+    }
+    EXPECT_EQ(pooled_allocation_stats().hits - before.hits, 8u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(PooledCross)::dtor"), 8u);
+}
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+struct Payload
+{
+    long id;
+    char bytes[40];
+};
+// Keeps `live` objects per round, then drops them all; ns per create+destroy.
+template<typename Make>
+double churn_ns(int rounds, int live, Make make)
+{
+    std::vector<decltype(make(0))> objects;
+    objects.reserve(static_cast<std::size_t>(live));
+    double ms = time_ms([&]() {
+        for (int r = 0; r < rounds; ++r)
+        {
+            for (int i = 0; i < live; ++i)
+            {
+                objects.push_back(make(i));
+            }
+            objects.clear();
+            EventLog::instance().clear();
+        }
+    });
+    return ms * 1e6 / (static_cast<double>(rounds) * live);
+}
+void run_pooled_shared_benchmark(int rounds, int live)
+{
+    double tracked_new = churn_ns(rounds, live, [](int) { return std::shared_ptr<Tracked>(new Tracked("Churn")); });
+    double tracked_make = churn_ns(rounds, live, [](int) { return std::make_shared<Tracked>("Churn"); });
+    double tracked_pooled = churn_ns(rounds, live, [](int) { return allocate_shared_pooled<Tracked>("Churn"); });
+    std::cout << "[ BENCH    ] shared_ptr<Tracked> create+destroy ns: new=" << tracked_new
+              << " make_shared=" << tracked_make << " allocate_shared_pooled=" << tracked_pooled << "\n";
+    double payload_new = churn_ns(rounds, live, [](int i) { return std::shared_ptr<Payload>(new Payload{i, {}}); });
+    double payload_make = churn_ns(rounds, live, [](int i) { return std::make_shared<Payload>(Payload{i, {}}); });
+    double payload_pooled = churn_ns(rounds, live, [](int i) { return allocate_shared_pooled<Payload>(Payload{i, {}}); });
+    std::cout << "[ BENCH    ] shared_ptr<Payload> create+destroy ns: new=" << payload_new
+              << " make_shared=" << payload_make << " allocate_shared_pooled=" << payload_pooled << "\n";
+    EXPECT_GT(tracked_pooled, 0.0);
+    EXPECT_GT(payload_pooled, 0.0);
+}
+TEST_F(PooledAllocationTest, PooledAllocateSharedChurnBenchmark)
+{
+    run_pooled_shared_benchmark(200, 128);
+    // Q: Tracked's constructor formats a string and appends to EventLog. Why does the pooled
+    //    gain look smaller for Tracked than for Payload, and which number predicts a real
+    //    service better?
+    // A:
+    // R:
+}
+TEST_F(PooledAllocationTest, DISABLED_PooledAllocateSharedChurnBenchmarkLarge)
+{
+    run_pooled_shared_benchmark(20000, 128);
+}
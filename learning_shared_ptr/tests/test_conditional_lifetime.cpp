@@ -2,6 +2,15 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 class ConditionalLifetimeTest : public ::testing::Test
 {
@@ -402,6 +411,464 @@ TEST_F(ConditionalLifetimeTest, ResourcePoolReuse)
     EXPECT_EQ(after_reacquire, 0);
 }
 
+// Complete implementation - study auto-returning pool
+// The handles' deleter puts the object back instead of deleting it, so nobody calls release()
+// and a handle that was copied around still comes back exactly once, when the last copy
+// dies. Idle objects sit in per-thread shards (threads are dealt shards round-robin), so
+// returns on different threads do not contend; an empty shard steals before creating.
+// Every deleter shares the pool's core, so handles may outlive the AutoReturnPool itself.
+template<typename T>
+class AutoReturnPool
+{
+    class Core;
+
+public:
+    struct Options
+    {
+        std::size_t low_watermark = 0;   // created up front, and kept by trim()
+        std::size_t high_watermark = 64; // idle objects beyond this are deleted on return
+        std::size_t shards = 8;
+    };
+
+    struct Stats
+    {
+        std::size_t created;
+        std::size_t reused;
+        std::size_t destroyed;
+        std::size_t idle;
+    };
+
+    class Returner
+    {
+    public:
+        Returner() = default;
+
+        explicit Returner(std::shared_ptr<Core> core)
+        : core_(std::move(core))
+        {
+        }
+
+        void operator()(T* object) const
+        {
+            if (core_)
+            {
+                core_->give_back(object);
+            }
+            else
+            {
+                delete object;
+            }
+        }
+
+    private:
+        std::shared_ptr<Core> core_;
+    };
+
+    using UniqueHandle = std::unique_ptr<T, Returner>;
+
+    AutoReturnPool(std::function<std::unique_ptr<T>()> factory, std::function<void(T&)> reset, Options options)
+    : core_(std::make_shared<Core>(std::move(factory), std::move(reset), options))
+    {
+    }
+
+    // If the control block allocation throws, shared_ptr runs the Returner: nothing leaks.
+    std::shared_ptr<T> acquire_shared()
+    {
+        return std::shared_ptr<T>(core_->take(), Returner(core_));
+    }
+
+    UniqueHandle acquire_unique()
+    {
+        return UniqueHandle(core_->take(), Returner(core_));
+    }
+
+    // Deletes idle objects down to the low watermark and returns how many went.
+    std::size_t trim()
+    {
+        return core_->trim();
+    }
+
+    Stats stats() const
+    {
+        return core_->stats();
+    }
+
+private:
+    class Core
+    {
+    public:
+        Core(std::function<std::unique_ptr<T>()> factory, std::function<void(T&)> reset, Options options)
+        : factory_(std::move(factory))
+        , reset_(std::move(reset))
+        , options_(options)
+        , shards_(std::max<std::size_t>(1, options.shards))
+        {
+            for (std::size_t i = 0; i < options_.low_watermark; ++i)
+            {
+                shards_[i % shards_.size()].idle.push_back(factory_().release());
+            }
+            created_ = idle_ = options_.low_watermark;
+        }
+
+        ~Core()
+        {
+            for (Shard& shard : shards_)
+            {
+                for (T* object : shard.idle)
+                {
+                    delete object;
+                }
+            }
+        }
+
+        T* take()
+        {
+            std::size_t home = local_index();
+            for (std::size_t i = 0; i < shards_.size(); ++i)
+            {
+                Shard& shard = shards_[(home + i) % shards_.size()];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                if (!shard.idle.empty())
+                {
+                    T* object = shard.idle.back();
+                    shard.idle.pop_back();
+                    idle_.fetch_sub(1, std::memory_order_relaxed);
+                    reused_.fetch_add(1, std::memory_order_relaxed);
+                    return object;
+                }
+            }
+            T* object = factory_().release();
+            created_.fetch_add(1, std::memory_order_relaxed);
+            return object;
+        }
+
+        // Runs inside a deleter, so nothing may escape: a throwing reset hook or a failed
+        // push_back costs the object, not the caller. idle_ is only handed back if this call
+        // actually claimed a slot, which a throwing reset hook never reaches.
+        void give_back(T* object) noexcept
+        {
+            bool counted = false;
+            try
+            {
+                if (reset_)
+                {
+                    reset_(*object);
+                }
+                counted = true;
+                if (idle_.fetch_add(1, std::memory_order_relaxed) < options_.high_watermark)
+                {
+                    Shard& shard = shards_[local_index()];
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    shard.idle.push_back(object);
+                    return;
+                }
+            }
+            catch (...)
+            {
+            }
+            if (counted)
+            {
+                idle_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            destroyed_.fetch_add(1, std::memory_order_relaxed);
+            delete object;
+        }
+
+        std::size_t trim()
+        {
+            std::vector<T*> doomed;
+            for (Shard& shard : shards_)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                while (!shard.idle.empty() && idle_.load(std::memory_order_relaxed) > options_.low_watermark)
+                {
+                    doomed.push_back(shard.idle.back());
+                    shard.idle.pop_back();
+                    idle_.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            for (T* object : doomed)
+            {
+                delete object;
+            }
+            destroyed_.fetch_add(doomed.size(), std::memory_order_relaxed);
+            return doomed.size();
+        }
+
+        Stats stats() const
+        {
+            return Stats{created_.load(), reused_.load(), destroyed_.load(), idle_.load()};
+        }
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::mutex mutex;
+            std::vector<T*> idle;
+        };
+
+        std::size_t local_index() const
+        {
+            static std::atomic<std::size_t> next_ticket{0};
+            thread_local std::size_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+            return ticket % shards_.size();
+        }
+
+        std::function<std::unique_ptr<T>()> factory_;
+        std::function<void(T&)> reset_;
+        Options options_;
+        std::vector<Shard> shards_;
+        std::atomic<std::size_t> created_{0};
+        std::atomic<std::size_t> reused_{0};
+        std::atomic<std::size_t> destroyed_{0};
+        std::atomic<std::size_t> idle_{0};
+    };
+
+    std::shared_ptr<Core> core_;
+};
+
+AutoReturnPool<Tracked>::Options tracked_pool_options(std::size_t low, std::size_t high)
+{
+    AutoReturnPool<Tracked>::Options options;
+    options.low_watermark = low;
+    options.high_watermark = high;
+    return options;
+}
+
+std::unique_ptr<Tracked> make_pooled_tracked()
+{
+    return std::make_unique<Tracked>("Pooled");
+}
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolTakesObjectsBackWhenHandlesDie)
+{
+    AutoReturnPool<Tracked> pool(make_pooled_tracked, nullptr, tracked_pool_options(0, 8));
+
+    Tracked* first = nullptr;
+    {
+        std::shared_ptr<Tracked> handle = pool.acquire_shared();
+        first = handle.get();
+        std::shared_ptr<Tracked> copy = handle;
+        handle.reset();
+        // Q: ResourcePool::release() only re-pooled at use_count()==1. What decides when the
+        //    object comes back here, and why can't a copy make it come back twice?
+        // A:
+        // R:
+        EXPECT_EQ(pool.stats().idle, 0u);
+    }
+    EXPECT_EQ(pool.stats().idle, 1u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Pooled)::dtor"), 0u);
+
+    AutoReturnPool<Tracked>::UniqueHandle unique = pool.acquire_unique();
+    EXPECT_EQ(unique.get(), first);
+    unique.reset();
+
+    AutoReturnPool<Tracked>::Stats stats = pool.stats();
+    EXPECT_EQ(stats.created, 1u);
+    EXPECT_EQ(stats.reused, 1u);
+    EXPECT_EQ(stats.idle, 1u);
+}
+
+struct ConnectionBuffer
+{
+    std::vector<char> bytes;
+    int requests_served = 0;
+};
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolResetsObjectsOnReturn)
+{
+    AutoReturnPool<ConnectionBuffer>::Options options;
+    AutoReturnPool<ConnectionBuffer> pool(
+        [] {
+            auto buffer = std::make_unique<ConnectionBuffer>();
+            buffer->bytes.reserve(4096);
+            return buffer;
+        },
+        [](ConnectionBuffer& buffer) { buffer.bytes.clear(); },
+        options);
+
+    {
+        auto buffer = pool.acquire_unique();
+        buffer->bytes.assign(1000, 'x');
+        ++buffer->requests_served;
+    }
+    auto again = pool.acquire_unique();
+    // clear() keeps the capacity: the next request writes into memory it did not allocate.
+    EXPECT_TRUE(again->bytes.empty());
+    EXPECT_GE(again->bytes.capacity(), 4096u);
+    EXPECT_EQ(again->requests_served, 1);
+}
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolHonoursWatermarks)
+{
+    AutoReturnPool<Tracked> pool(make_pooled_tracked, nullptr, tracked_pool_options(2, 4));
+    EXPECT_EQ(pool.stats().created, 2u);
+    EXPECT_EQ(pool.stats().idle, 2u);
+
+    {
+        std::vector<std::shared_ptr<Tracked>> burst;
+        for (int i = 0; i < 6; ++i)
+        {
+            burst.push_back(pool.acquire_shared());
+        }
+        EXPECT_EQ(pool.stats().created, 6u);
+    }
+    // Six came back, the high watermark kept four.
+    EXPECT_EQ(pool.stats().idle, 4u);
+    EXPECT_EQ(pool.stats().destroyed, 2u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Pooled)::dtor"), 2u);
+
+    EXPECT_EQ(pool.trim(), 2u);
+    EXPECT_EQ(pool.stats().idle, 2u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Pooled)::dtor"), 4u);
+
+    // Q: What traffic pattern makes a high watermark of zero equivalent to plain new/delete,
+    //    and what does a too-high watermark cost once the burst is over?
+    // A:
+    // R:
+}
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolDropsObjectsWhoseResetThrows)
+{
+    bool fail_reset = true;
+    AutoReturnPool<Tracked> pool(
+        make_pooled_tracked,
+        [&fail_reset](Tracked&) {
+            if (fail_reset)
+            {
+                throw std::runtime_error("reset failed");
+            }
+        },
+        tracked_pool_options(1, 4));
+    EXPECT_EQ(pool.stats().idle, 1u);
+
+    {
+        auto handle = pool.acquire_unique();
+        EXPECT_EQ(pool.stats().idle, 0u);
+    }
+    // The object went to delete, and the idle count is untouched rather than wrapped.
+    AutoReturnPool<Tracked>::Stats stats = pool.stats();
+    EXPECT_EQ(stats.idle, 0u);
+    EXPECT_EQ(stats.destroyed, 1u);
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Pooled)::dtor"), 1u);
+
+    fail_reset = false;
+    {
+        auto handle = pool.acquire_unique();
+    }
+    EXPECT_EQ(pool.stats().idle, 1u);
+    EXPECT_EQ(pool.stats().created, 2u);
+}
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolHandlesMayOutliveThePool)
+{
+    std::shared_ptr<Tracked> survivor;
+    {
+        AutoReturnPool<Tracked> pool(make_pooled_tracked, nullptr, tracked_pool_options(1, 4));
+        survivor = pool.acquire_shared();
+    }
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Pooled)::dtor"), 0u);
+    survivor.reset();
+    EXPECT_EQ(EventLog::instance().count_events("Tracked(Pooled)::dtor"), 1u);
+}
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolServesManyThreads)
+{
+    AutoReturnPool<ConnectionBuffer>::Options options;
+    options.high_watermark = 16;
+    AutoReturnPool<ConnectionBuffer> pool([] { return std::make_unique<ConnectionBuffer>(); },
+                                          [](ConnectionBuffer& buffer) { buffer.bytes.clear(); }, options);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&pool]() {
+            for (int i = 0; i < 2000; ++i)
+            {
+                std::shared_ptr<ConnectionBuffer> shared = pool.acquire_shared();
+                auto unique = pool.acquire_unique();
+                shared->bytes.push_back('s');
+                unique->bytes.push_back('u');
+                EXPECT_EQ(shared->bytes.size(), 1u);
+                EXPECT_EQ(unique->bytes.size(), 1u);
+            }
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+
+    AutoReturnPool<ConnectionBuffer>::Stats stats = pool.stats();
+    EXPECT_EQ(stats.created + stats.reused, 4u * 2000u * 2u);
+    EXPECT_EQ(stats.created - stats.destroyed, stats.idle);
+    EXPECT_LE(stats.idle, 16u);
+}
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One request: take a buffer, fill it with a payload, drop it. ns per request.
+template<typename Acquire>
+double buffer_request_ns(int requests, Acquire acquire)
+{
+    std::size_t checksum = 0;
+    double ms = time_ms([&]() {
+        for (int r = 0; r < requests; ++r)
+        {
+            auto buffer = acquire();
+            buffer->bytes.resize(2048, static_cast<char>(r));
+            checksum += static_cast<unsigned char>(buffer->bytes[r % 2048]);
+        }
+    });
+    EXPECT_GT(checksum, 0u);
+    return ms * 1e6 / requests;
+}
+
+void run_buffer_pool_benchmark(int requests)
+{
+    double fresh = buffer_request_ns(requests, [] {
+        auto buffer = std::make_unique<ConnectionBuffer>();
+        buffer->bytes.reserve(4096);
+        return buffer;
+    });
+
+    AutoReturnPool<ConnectionBuffer>::Options options;
+    AutoReturnPool<ConnectionBuffer> pool(
+        [] {
+            auto buffer = std::make_unique<ConnectionBuffer>();
+            buffer->bytes.reserve(4096);
+            return buffer;
+        },
+        [](ConnectionBuffer& buffer) { buffer.bytes.clear(); },
+        options);
+    double pooled_unique = buffer_request_ns(requests, [&pool] { return pool.acquire_unique(); });
+    double pooled_shared = buffer_request_ns(requests, [&pool] { return pool.acquire_shared(); });
+
+    std::cout << "[ BENCH    ] connection buffer ns/request: new+delete=" << fresh
+              << " pool.acquire_unique=" << pooled_unique << " pool.acquire_shared=" << pooled_shared << "\n";
+}
+
+TEST_F(ConditionalLifetimeTest, AutoReturnPoolBufferBenchmark)
+{
+    run_buffer_pool_benchmark(100000);
+
+    // Q: acquire_shared() still allocates a control block per request. How would you get
+    //    that allocation out of the loop as well?
+    // A:
+    // R:
+}
+
+TEST_F(ConditionalLifetimeTest, DISABLED_AutoReturnPoolBufferBenchmarkLarge)
+{
+    run_buffer_pool_benchmark(10000000);
+}
+
 // Complete implementation - study optional resource
 class OptionalResource
 {
@@ -2,9 +2,1354 @@
 // Estimated Time: 3 hours
 // Difficulty: Moderate
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // TODO: Implement test cases for algorithm complexity guarantees
-// TODO: Implement test cases for parallel algorithms (C++17)
-// TODO: Implement test cases for custom algorithm implementation
+
+class AlgorithmsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+// ============================================================================
+// Parallel Algorithms on a Work-Stealing Pool
+// ============================================================================
+
+// std::execution::par needs TBB under libstdc++, so the par:: algorithms below run on
+// their own fork-join pool. Each worker owns a deque: it pushes and pops at the back
+// (newest, cache-hot work) while idle threads steal from the front (oldest, largest
+// ranges). Threads that wait on a TaskGroup run queued tasks instead of blocking, so
+// nested parallelism cannot deadlock the pool.
+namespace par
+{
+
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // `workers` background threads; the calling thread is the extra participant.
+    explicit WorkStealingPool(unsigned workers)
+    : queues_(workers + 1)
+    {
+        for (unsigned i = 0; i < workers; ++i)
+        {
+            threads_.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (auto& t : threads_)
+        {
+            t.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    static WorkStealingPool& default_pool()
+    {
+        static WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    unsigned concurrency() const
+    {
+        return static_cast<unsigned>(threads_.size()) + 1;
+    }
+
+    void submit(Task task)
+    {
+        Queue& queue = queues_[own_queue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        queued_.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        sleep_cv_.notify_one();
+    }
+
+    // Runs one queued task: own queue newest-first, otherwise steals oldest-first.
+    bool run_one()
+    {
+        std::size_t self = own_queue();
+        Task task = pop_back(queues_[self]);
+        for (std::size_t k = 1; !task && k < queues_.size(); ++k)
+        {
+            task = steal_front(queues_[(self + k) % queues_.size()]);
+        }
+        if (!task)
+        {
+            return false;
+        }
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        return true;
+    }
+
+private:
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Non-worker threads share the last queue.
+    std::size_t own_queue() const
+    {
+        return current_pool_ == this ? current_index_ : queues_.size() - 1;
+    }
+
+    static Task pop_back(Queue& queue)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            return Task();
+        }
+        Task task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return task;
+    }
+
+    static Task steal_front(Queue& queue)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            return Task();
+        }
+        Task task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return task;
+    }
+
+    void worker_loop(std::size_t index)
+    {
+        current_pool_ = this;
+        current_index_ = index;
+        for (;;)
+        {
+            if (run_one())
+            {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.wait(lock, [this]() { return stop_ || queued_.load(std::memory_order_acquire) > 0; });
+            if (stop_ && queued_.load(std::memory_order_acquire) == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    std::vector<Queue> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> queued_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stop_ = false;
+
+    static inline thread_local WorkStealingPool* current_pool_ = nullptr;
+    static inline thread_local std::size_t current_index_ = 0;
+};
+
+// Fork-join scope: run() spawns, wait() helps execute queued work until every spawned
+// task finished, then rethrows the first exception any of them raised.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(WorkStealingPool& pool)
+    : pool_(pool)
+    {
+    }
+
+    ~TaskGroup()
+    {
+        help_until_done();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template<typename F>
+    void run(F f)
+    {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        pool_.submit([this, f]() mutable
+        {
+            try
+            {
+                f();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                if (!error_)
+                {
+                    error_ = std::current_exception();
+                }
+            }
+            pending_.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void wait()
+    {
+        help_until_done();
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (error_)
+        {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void help_until_done()
+    {
+        while (pending_.load(std::memory_order_acquire) != 0)
+        {
+            if (!pool_.run_one())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    WorkStealingPool& pool_;
+    std::atomic<std::size_t> pending_{0};
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+// Below this many elements per task the deque lock and std::function allocation cost
+// more than the work saved.
+constexpr std::size_t kMinGrain = 4096;
+
+// About eight chunks per participant: enough slack for stealing to even out uneven
+// chunks and preemption, few enough that scheduling overhead stays in the noise.
+inline std::size_t grain_size(std::size_t n, unsigned concurrency)
+{
+    return std::max(kMinGrain, n / (static_cast<std::size_t>(concurrency) * 8) + 1);
+}
+
+struct policy
+{
+    WorkStealingPool* pool;
+    std::size_t grain; // 0: grain_size() heuristic
+
+    std::size_t grain_for(std::size_t n) const
+    {
+        return grain != 0 ? grain : grain_size(n, pool->concurrency());
+    }
+};
+
+inline policy on(WorkStealingPool& pool, std::size_t grain = 0)
+{
+    return policy{&pool, grain};
+}
+
+inline policy default_policy()
+{
+    return on(WorkStealingPool::default_pool());
+}
+
+namespace detail
+{
+
+// Recursive halving: the right half goes to the deque for thieves, the left half is
+// processed here, so a steal always takes the largest remaining piece.
+template<typename Body>
+void split_range(TaskGroup& group, std::size_t lo, std::size_t hi, std::size_t grain, const Body& body)
+{
+    while (hi - lo > grain)
+    {
+        std::size_t mid = lo + (hi - lo) / 2;
+        group.run([&group, mid, hi, grain, &body]() { split_range(group, mid, hi, grain, body); });
+        hi = mid;
+    }
+    body(lo, hi);
+}
+
+// Fixed partition of [0, n) used by the multi-pass algorithms, which need to address
+// the same block again in a later pass.
+struct Blocks
+{
+    std::size_t n;
+    std::size_t grain;
+    std::size_t count;
+
+    std::size_t lo(std::size_t b) const
+    {
+        return b * grain;
+    }
+
+    std::size_t hi(std::size_t b) const
+    {
+        return std::min(n, (b + 1) * grain);
+    }
+};
+
+inline Blocks make_blocks(const policy& pol, std::size_t n)
+{
+    std::size_t grain = pol.grain_for(n);
+    return Blocks{n, grain, (n + grain - 1) / grain};
+}
+
+} // namespace detail
+
+// body(lo, hi) over [0, n), split down to the policy's grain.
+template<typename Body>
+void parallel_for(const policy& pol, std::size_t n, const Body& body)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    std::size_t grain = pol.grain_for(n);
+    if (n <= grain)
+    {
+        body(0, n);
+        return;
+    }
+    TaskGroup group(*pol.pool);
+    detail::split_range(group, 0, n, grain, body);
+    group.wait();
+}
+
+namespace detail
+{
+
+// body(b) for every block; one block per task.
+template<typename Body>
+void for_each_block(const policy& pol, const Blocks& blocks, const Body& body)
+{
+    parallel_for(on(*pol.pool, 1), blocks.count, [&body](std::size_t first, std::size_t last)
+    {
+        for (std::size_t b = first; b < last; ++b)
+        {
+            body(b);
+        }
+    });
+}
+
+} // namespace detail
+
+template<typename RandomIt, typename F>
+void for_each(const policy& pol, RandomIt first, RandomIt last, F f)
+{
+    parallel_for(pol, static_cast<std::size_t>(last - first), [first, &f](std::size_t lo, std::size_t hi)
+    {
+        std::for_each(first + lo, first + hi, f);
+    });
+}
+
+template<typename RandomIt, typename F>
+void for_each(RandomIt first, RandomIt last, F f)
+{
+    par::for_each(default_policy(), first, last, f);
+}
+
+// Requires `reduce` to be associative; blocks are combined left to right, so the result
+// is deterministic for a given grain even for floating point.
+template<typename RandomIt, typename T, typename Reduce, typename Transform>
+T transform_reduce(const policy& pol, RandomIt first, RandomIt last, T init, Reduce reduce, Transform transform)
+{
+    detail::Blocks blocks = detail::make_blocks(pol, static_cast<std::size_t>(last - first));
+    std::vector<std::optional<T>> partial(blocks.count);
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        std::size_t lo = blocks.lo(b);
+        T acc = transform(first[lo]);
+        for (std::size_t i = lo + 1; i < blocks.hi(b); ++i)
+        {
+            acc = reduce(std::move(acc), transform(first[i]));
+        }
+        partial[b] = std::move(acc);
+    });
+    for (auto& p : partial)
+    {
+        init = reduce(std::move(init), std::move(*p));
+    }
+    return init;
+}
+
+template<typename RandomIt, typename T, typename Reduce, typename Transform>
+T transform_reduce(RandomIt first, RandomIt last, T init, Reduce reduce, Transform transform)
+{
+    return par::transform_reduce(default_policy(), first, last, std::move(init), reduce, transform);
+}
+
+// Two-pass blocked scan: pass one reduces every block, a serial scan over the block
+// totals turns them into carries, pass two rescans each block starting from its carry.
+// Reads the input twice, so it suits memory-resident data; d_first may equal first.
+template<typename RandomIt, typename OutIt, typename Op>
+OutIt inclusive_scan(const policy& pol, RandomIt first, RandomIt last, OutIt d_first, Op op)
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n == 0)
+    {
+        return d_first;
+    }
+    detail::Blocks blocks = detail::make_blocks(pol, n);
+
+    std::vector<std::optional<T>> carry(blocks.count);
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        if (b + 1 == blocks.count)
+        {
+            return; // the last block's total is never a carry
+        }
+        T acc = first[blocks.lo(b)];
+        for (std::size_t i = blocks.lo(b) + 1; i < blocks.hi(b); ++i)
+        {
+            acc = op(std::move(acc), first[i]);
+        }
+        carry[b] = std::move(acc);
+    });
+
+    std::optional<T> running;
+    for (std::size_t b = 0; b < blocks.count; ++b)
+    {
+        std::optional<T> total = std::move(carry[b]);
+        carry[b] = running;
+        if (total)
+        {
+            running = running ? op(std::move(*running), std::move(*total)) : std::move(*total);
+        }
+    }
+
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        std::size_t lo = blocks.lo(b);
+        T acc = carry[b] ? op(*carry[b], first[lo]) : T(first[lo]);
+        d_first[lo] = acc;
+        for (std::size_t i = lo + 1; i < blocks.hi(b); ++i)
+        {
+            acc = op(std::move(acc), first[i]);
+            d_first[i] = acc;
+        }
+    });
+    return d_first + n;
+}
+
+template<typename RandomIt, typename OutIt>
+OutIt inclusive_scan(RandomIt first, RandomIt last, OutIt d_first)
+{
+    return par::inclusive_scan(default_policy(), first, last, d_first, std::plus<>());
+}
+
+// Below this size a parallel sort only adds overhead.
+constexpr std::size_t kSortCutoff = std::size_t(1) << 15;
+
+// Sample sort: oversampled splitters cut the input into buckets, every block counts and
+// scatters its elements into a bucket-major buffer, then buckets sort independently.
+// Needs a default-constructible value type for the scratch buffer. Not stable.
+template<typename RandomIt, typename Compare>
+void sort(const policy& pol, RandomIt first, RandomIt last, Compare comp)
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n < kSortCutoff)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    const std::size_t buckets = std::clamp<std::size_t>(4 * pol.pool->concurrency(), 8, 256);
+    const std::size_t oversample = 32;
+    std::vector<T> samples;
+    samples.reserve(buckets * oversample);
+    std::minstd_rand rng(static_cast<std::minstd_rand::result_type>(n));
+    std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+    for (std::size_t i = 0; i < buckets * oversample; ++i)
+    {
+        samples.push_back(first[pick(rng)]);
+    }
+    std::sort(samples.begin(), samples.end(), comp);
+    std::vector<T> splitters;
+    for (std::size_t k = 1; k < buckets; ++k)
+    {
+        splitters.push_back(samples[k * oversample]);
+    }
+    auto bucket_of = [&splitters, &comp](const T& value)
+    {
+        return static_cast<std::size_t>(std::upper_bound(splitters.begin(), splitters.end(), value, comp) -
+                                        splitters.begin());
+    };
+
+    detail::Blocks blocks = detail::make_blocks(pol, n);
+    std::vector<std::size_t> offsets(blocks.count * buckets, 0);
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        std::size_t* counts = &offsets[b * buckets];
+        for (std::size_t i = blocks.lo(b); i < blocks.hi(b); ++i)
+        {
+            ++counts[bucket_of(first[i])];
+        }
+    });
+
+    // Bucket-major exclusive scan: bucket k of block b lands after bucket k of blocks < b.
+    std::vector<std::size_t> bucket_begin(buckets + 1, 0);
+    std::size_t running = 0;
+    for (std::size_t k = 0; k < buckets; ++k)
+    {
+        bucket_begin[k] = running;
+        for (std::size_t b = 0; b < blocks.count; ++b)
+        {
+            std::size_t count = offsets[b * buckets + k];
+            offsets[b * buckets + k] = running;
+            running += count;
+        }
+    }
+    bucket_begin[buckets] = n;
+
+    std::vector<T> scratch(n);
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        std::size_t* next = &offsets[b * buckets];
+        for (std::size_t i = blocks.lo(b); i < blocks.hi(b); ++i)
+        {
+            scratch[next[bucket_of(first[i])]++] = std::move(first[i]);
+        }
+    });
+
+    parallel_for(on(*pol.pool, 1), buckets, [&](std::size_t k_lo, std::size_t k_hi)
+    {
+        for (std::size_t k = k_lo; k < k_hi; ++k)
+        {
+            auto begin = scratch.begin() + bucket_begin[k];
+            auto end = scratch.begin() + bucket_begin[k + 1];
+            std::sort(begin, end, comp);
+            std::move(begin, end, first + bucket_begin[k]);
+        }
+    });
+}
+
+template<typename RandomIt, typename Compare>
+void sort(RandomIt first, RandomIt last, Compare comp)
+{
+    par::sort(default_policy(), first, last, comp);
+}
+
+template<typename RandomIt>
+void sort(RandomIt first, RandomIt last)
+{
+    par::sort(default_policy(), first, last, std::less<>());
+}
+
+// Three passes: flag and count per block, scan the counts, scatter into a buffer.
+// Unlike std::partition the result is stable, which the buffer gives us for free.
+// pred is evaluated exactly once per element.
+template<typename RandomIt, typename Predicate>
+RandomIt partition(const policy& pol, RandomIt first, RandomIt last, Predicate pred)
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n == 0)
+    {
+        return first;
+    }
+    detail::Blocks blocks = detail::make_blocks(pol, n);
+    std::vector<unsigned char> flags(n);
+    std::vector<std::size_t> true_offset(blocks.count, 0);
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        std::size_t count = 0;
+        for (std::size_t i = blocks.lo(b); i < blocks.hi(b); ++i)
+        {
+            flags[i] = pred(first[i]) ? 1 : 0;
+            count += flags[i];
+        }
+        true_offset[b] = count;
+    });
+
+    std::size_t total_true = 0;
+    for (std::size_t b = 0; b < blocks.count; ++b)
+    {
+        std::size_t count = true_offset[b];
+        true_offset[b] = total_true;
+        total_true += count;
+    }
+
+    std::vector<T> scratch(n);
+    detail::for_each_block(pol, blocks, [&](std::size_t b)
+    {
+        std::size_t to_true = true_offset[b];
+        std::size_t to_false = total_true + (blocks.lo(b) - true_offset[b]);
+        for (std::size_t i = blocks.lo(b); i < blocks.hi(b); ++i)
+        {
+            scratch[flags[i] ? to_true++ : to_false++] = std::move(first[i]);
+        }
+    });
+    parallel_for(pol, n, [&](std::size_t lo, std::size_t hi)
+    {
+        std::move(scratch.begin() + lo, scratch.begin() + hi, first + lo);
+    });
+    return first + total_true;
+}
+
+template<typename RandomIt, typename Predicate>
+RandomIt partition(RandomIt first, RandomIt last, Predicate pred)
+{
+    return par::partition(default_policy(), first, last, pred);
+}
+
+} // namespace par
+
+std::vector<std::uint32_t> make_random_keys(std::size_t n, std::uint32_t seed)
+{
+    std::vector<std::uint32_t> keys(n);
+    std::mt19937 rng(seed);
+    for (auto& k : keys)
+    {
+        k = rng();
+    }
+    return keys;
+}
+
+TEST_F(AlgorithmsTest, ParallelForCoversEveryIndexOnce)
+{
+    par::WorkStealingPool pool(3);
+    std::vector<int> hits(100000, 0);
+    par::parallel_for(par::on(pool, 1000), hits.size(), [&hits](std::size_t lo, std::size_t hi)
+    {
+        for (std::size_t i = lo; i < hi; ++i)
+        {
+            ++hits[i];
+        }
+    });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), static_cast<long>(hits.size()));
+
+    EXPECT_EQ(par::grain_size(10, 4), par::kMinGrain);
+    EXPECT_EQ(par::grain_size(std::size_t(1) << 30, 4), (std::size_t(1) << 25) + 1);
+
+    // Q: split_range() pushes the right half and keeps the left. Why does that make a thief's first
+    //    steal take half of the whole range instead of one grain?
+    // A:
+    // R:
+}
+
+TEST_F(AlgorithmsTest, ParallelForEachAndTransformReduce)
+{
+    par::WorkStealingPool pool(3);
+    std::vector<long> values(50000);
+    std::iota(values.begin(), values.end(), 1);
+
+    par::for_each(par::on(pool, 777), values.begin(), values.end(), [](long& v) { v *= 2; });
+    EXPECT_EQ(values.front(), 2);
+    EXPECT_EQ(values.back(), 100000);
+
+    long sum_of_squares = par::transform_reduce(par::on(pool, 777), values.begin(), values.end(), 0L,
+                                                std::plus<>(), [](long v) { return v * v; });
+    long expected = std::transform_reduce(values.begin(), values.end(), 0L, std::plus<>(), [](long v) { return v * v; });
+    EXPECT_EQ(sum_of_squares, expected);
+
+    std::vector<long> empty;
+    EXPECT_EQ(par::transform_reduce(empty.begin(), empty.end(), 5L, std::plus<>(), [](long v) { return v; }), 5L);
+}
+
+TEST_F(AlgorithmsTest, ParallelInclusiveScanMatchesSerial)
+{
+    par::WorkStealingPool pool(3);
+    std::vector<std::uint64_t> input(100003);
+    std::mt19937 rng(3);
+    for (auto& v : input)
+    {
+        v = rng() % 1000;
+    }
+    std::vector<std::uint64_t> expected(input.size());
+    std::inclusive_scan(input.begin(), input.end(), expected.begin());
+
+    std::vector<std::uint64_t> output(input.size());
+    auto end = par::inclusive_scan(par::on(pool, 1000), input.begin(), input.end(), output.begin(), std::plus<>());
+    EXPECT_EQ(end, output.end());
+    EXPECT_EQ(output, expected);
+
+    // In place, with a non-commutative but associative op.
+    std::vector<std::string> words = {"a", "b", "c", "d", "e", "f", "g"};
+    par::inclusive_scan(par::on(pool, 2), words.begin(), words.end(), words.begin(), std::plus<>());
+    EXPECT_EQ(words.back(), "abcdefg");
+    EXPECT_EQ(words[2], "abc");
+
+    // Q: The blocked scan does about 2n applications of op where the serial scan does n. When is it
+    //    still faster, and why does it need associativity but not commutativity?
+    // A:
+    // R:
+}
+
+TEST_F(AlgorithmsTest, ParallelSampleSortMatchesStdSort)
+{
+    par::WorkStealingPool pool(3);
+    std::vector<std::uint32_t> keys = make_random_keys(200000, 11);
+    std::vector<std::uint32_t> expected = keys;
+    std::sort(expected.begin(), expected.end());
+
+    par::sort(par::on(pool), keys.begin(), keys.end(), std::less<>());
+    EXPECT_EQ(keys, expected);
+
+    // Heavy duplicates and descending input.
+    std::vector<int> few(100000);
+    for (std::size_t i = 0; i < few.size(); ++i)
+    {
+        few[i] = static_cast<int>((few.size() - i) % 3);
+    }
+    par::sort(par::on(pool), few.begin(), few.end(), std::greater<>());
+    EXPECT_TRUE(std::is_sorted(few.begin(), few.end(), std::greater<>()));
+
+    // Q: With only three distinct keys most splitters are equal and one bucket receives a third of the
+    //    input. What would you change so that runs of equal keys spread across threads?
+    // A:
+    // R:
+}
+
+TEST_F(AlgorithmsTest, ParallelPartitionIsStable)
+{
+    par::WorkStealingPool pool(3);
+    std::vector<int> values(60000);
+    std::iota(values.begin(), values.end(), 0);
+    auto is_even = [](int v) { return v % 2 == 0; };
+
+    auto middle = par::partition(par::on(pool, 1000), values.begin(), values.end(), is_even);
+    ASSERT_EQ(middle - values.begin(), 30000);
+    EXPECT_TRUE(std::all_of(values.begin(), middle, is_even));
+    EXPECT_TRUE(std::none_of(middle, values.end(), is_even));
+    EXPECT_TRUE(std::is_sorted(values.begin(), middle));
+    EXPECT_TRUE(std::is_sorted(middle, values.end()));
+}
+
+TEST_F(AlgorithmsTest, NestedParallelismAndExceptions)
+{
+    par::WorkStealingPool pool(2);
+    std::vector<std::vector<std::uint32_t>> batches;
+    for (std::uint32_t s = 0; s < 4; ++s)
+    {
+        batches.push_back(make_random_keys(50000, s));
+    }
+
+    // Each outer task waits on an inner sort; waiting threads execute queued tasks, so this
+    // completes even though there are fewer workers than outer tasks.
+    par::for_each(par::on(pool, 1), batches.begin(), batches.end(), [&pool](std::vector<std::uint32_t>& batch)
+    {
+        par::sort(par::on(pool), batch.begin(), batch.end(), std::less<>());
+    });
+    for (const auto& batch : batches)
+    {
+        EXPECT_TRUE(std::is_sorted(batch.begin(), batch.end()));
+    }
+
+    std::vector<int> values(10000, 1);
+    values[5000] = -1;
+    EXPECT_THROW(par::for_each(par::on(pool, 100), values.begin(), values.end(), [](int v)
+    {
+        if (v < 0)
+        {
+            throw std::runtime_error("negative");
+        }
+    }), std::runtime_error);
+}
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void run_parallel_algorithm_benchmarks(par::WorkStealingPool& pool, std::size_t n)
+{
+    std::vector<std::uint32_t> keys = make_random_keys(n, 42);
+    std::vector<std::uint32_t> copy = keys;
+    std::vector<std::uint32_t> scan(n);
+    auto mix = [](std::uint32_t v) { return static_cast<std::uint64_t>(v) * 2654435761u >> 7; };
+    auto report = [&](const char* name, double serial_ms, double parallel_ms)
+    {
+        std::cout << "[ BENCH    ] n=" << n << " threads=" << pool.concurrency() << " " << name
+                  << " serial_ms=" << serial_ms << " par_ms=" << parallel_ms
+                  << " speedup=" << (parallel_ms > 0.0 ? serial_ms / parallel_ms : 0.0) << "x\n";
+    };
+
+    double serial = time_ms([&]() { std::for_each(keys.begin(), keys.end(), [](std::uint32_t& v) { v ^= 0x5bd1e995u; }); });
+    double parallel = time_ms([&]()
+    {
+        par::for_each(par::on(pool), keys.begin(), keys.end(), [](std::uint32_t& v) { v ^= 0x5bd1e995u; });
+    });
+    report("for_each         ", serial, parallel);
+
+    std::uint64_t serial_sum = 0;
+    std::uint64_t parallel_sum = 0;
+    serial = time_ms([&]() { serial_sum = std::transform_reduce(keys.begin(), keys.end(), std::uint64_t(0), std::plus<>(), mix); });
+    parallel = time_ms([&]()
+    {
+        parallel_sum = par::transform_reduce(par::on(pool), keys.begin(), keys.end(), std::uint64_t(0), std::plus<>(), mix);
+    });
+    EXPECT_EQ(serial_sum, parallel_sum);
+    report("transform_reduce ", serial, parallel);
+
+    serial = time_ms([&]() { std::inclusive_scan(keys.begin(), keys.end(), scan.begin(), std::plus<>()); });
+    std::uint32_t last = scan.back();
+    parallel = time_ms([&]()
+    {
+        par::inclusive_scan(par::on(pool), keys.begin(), keys.end(), scan.begin(), std::plus<>());
+    });
+    EXPECT_EQ(scan.back(), last);
+    report("inclusive_scan   ", serial, parallel);
+
+    auto odd = [](std::uint32_t v) { return (v & 1) != 0; };
+    std::vector<std::uint32_t> partitioned = keys;
+    serial = time_ms([&]() { std::stable_partition(copy.begin(), copy.end(), odd); });
+    parallel = time_ms([&]() { par::partition(par::on(pool), partitioned.begin(), partitioned.end(), odd); });
+    report("partition(stable)", serial, parallel);
+
+    copy = keys;
+    serial = time_ms([&]() { std::sort(copy.begin(), copy.end()); });
+    parallel = time_ms([&]() { par::sort(par::on(pool), keys.begin(), keys.end(), std::less<>()); });
+    EXPECT_EQ(keys, copy);
+    report("sort             ", serial, parallel);
+}
+
+TEST_F(AlgorithmsTest, ParallelAlgorithmBenchmark)
+{
+    // Q: On a machine with fewer cores than pool threads, which of these speedups drop below 1.0 first,
+    //    and which pass of the scan and the sample sort is bandwidth- rather than compute-bound?
+    // A:
+    // R:
+
+    par::WorkStealingPool pool(3);
+    run_parallel_algorithm_benchmarks(pool, std::size_t(1) << 18);
+}
+
+// At 10^9 the five four-byte arrays (keys, copies, scan output, scratch) need about 20 GB.
+TEST_F(AlgorithmsTest, DISABLED_ParallelAlgorithmScaling)
+{
+    for (std::size_t n : {std::size_t(10000000), std::size_t(100000000), std::size_t(1000000000)})
+    {
+        run_parallel_algorithm_benchmarks(par::WorkStealingPool::default_pool(), n);
+    }
+}
+
+// ============================================================================
+// Sorting Kernels: LSD Radix Sort, Branchless Partition, Sorting Networks
+// ============================================================================
+
+// Order-preserving maps to unsigned keys: signed integers flip the sign bit, IEEE floats
+// flip every bit when negative and only the sign bit otherwise (-0.0 sorts before +0.0,
+// NaNs sort by payload at either end).
+inline std::uint32_t radix_key(std::uint32_t v)
+{
+    return v;
+}
+
+inline std::uint64_t radix_key(std::uint64_t v)
+{
+    return v;
+}
+
+inline std::uint32_t radix_key(std::int32_t v)
+{
+    return static_cast<std::uint32_t>(v) ^ 0x80000000u;
+}
+
+inline std::uint64_t radix_key(std::int64_t v)
+{
+    return static_cast<std::uint64_t>(v) ^ 0x8000000000000000ull;
+}
+
+inline std::uint32_t radix_key(float v)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+inline std::uint64_t radix_key(double v)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+}
+
+// How many elements ahead the scatter pass prefetches its destination slot.
+constexpr std::size_t kRadixPrefetchDistance = 16;
+
+// Stable LSD radix sort on key(element), DigitBits per pass (8: 256-entry histograms that
+// stay in L1; 11: one pass fewer for 32-bit keys at 2048 entries). All histograms come
+// from a single read pass, and a digit on which every key agrees is skipped - for
+// timestamps that share their high bits that removes most passes.
+template<unsigned DigitBits = 8, typename T, typename KeyFn>
+void radix_sort(T* first, T* last, KeyFn key)
+{
+    using Key = decltype(key(*first));
+    static_assert(std::is_unsigned<Key>::value, "radix_sort keys must be unsigned integers");
+    static_assert(DigitBits >= 1 && DigitBits <= 16, "radix_sort digit width out of range");
+    constexpr unsigned kPasses = (sizeof(Key) * 8 + DigitBits - 1) / DigitBits;
+    constexpr std::size_t kBuckets = std::size_t(1) << DigitBits;
+    constexpr std::size_t kMask = kBuckets - 1;
+
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (n < 2)
+    {
+        return;
+    }
+
+    std::vector<std::size_t> histograms(kPasses * kBuckets, 0);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        Key k = key(first[i]);
+        for (unsigned p = 0; p < kPasses; ++p)
+        {
+            ++histograms[p * kBuckets + ((k >> (p * DigitBits)) & kMask)];
+        }
+    }
+
+    std::vector<T> scratch(n);
+    T* src = first;
+    T* dst = scratch.data();
+    for (unsigned p = 0; p < kPasses; ++p)
+    {
+        std::size_t* offsets = &histograms[p * kBuckets];
+        const unsigned shift = p * DigitBits;
+        auto digit = [&key, shift](const T& value) { return static_cast<std::size_t>((key(value) >> shift) & kMask); };
+
+        if (offsets[digit(src[0])] == n)
+        {
+            continue; // every key has the same digit: the pass would copy the array unchanged
+        }
+        std::size_t running = 0;
+        for (std::size_t b = 0; b < kBuckets; ++b)
+        {
+            std::size_t count = offsets[b];
+            offsets[b] = running;
+            running += count;
+        }
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+#if defined(__GNUC__)
+            if (i + kRadixPrefetchDistance < n)
+            {
+                __builtin_prefetch(dst + offsets[digit(src[i + kRadixPrefetchDistance])], 1);
+            }
+#endif
+            dst[offsets[digit(src[i])]++] = std::move(src[i]);
+        }
+        std::swap(src, dst);
+    }
+    if (src != first)
+    {
+        std::move(src, src + n, first);
+    }
+}
+
+template<unsigned DigitBits = 8, typename T>
+void radix_sort(T* first, T* last)
+{
+    radix_sort<DigitBits>(first, last, [](const T& v) { return radix_key(v); });
+}
+
+// Key plus payload pointer, the shape of an index over larger records.
+struct KeyPointer
+{
+    std::uint64_t key;
+    const void* record;
+};
+
+// Lomuto without the branch: every element is swapped into the store slot and the slot
+// advances by the comparison result, so a random pivot costs no mispredictions.
+// Returns the split point; [first, mid) satisfies less(x, pivot).
+template<typename T, typename Less>
+T* branchless_lomuto_partition(T* first, T* last, const T& pivot, Less less)
+{
+    T* store = first;
+    for (T* it = first; it != last; ++it)
+    {
+        bool goes_left = less(*it, pivot);
+        std::iter_swap(it, store);
+        store += goes_left;
+    }
+    return store;
+}
+
+// Hoare partition in blocks (BlockQuicksort): each side first records, without branching,
+// the offsets of misplaced elements in a 64-element block, then swaps them pairwise.
+// The comparisons become data dependencies instead of branches; the unscanned middle is
+// finished with the branchless Lomuto pass.
+template<typename T, typename Less>
+T* block_hoare_partition(T* first, T* last, const T& pivot, Less less)
+{
+    constexpr std::ptrdiff_t kBlock = 64;
+    unsigned char left_offsets[kBlock];
+    unsigned char right_offsets[kBlock];
+    std::ptrdiff_t left_count = 0;
+    std::ptrdiff_t right_count = 0;
+    std::ptrdiff_t left_start = 0;
+    std::ptrdiff_t right_start = 0;
+
+    T* l = first;
+    T* r = last;
+    while (r - l > 2 * kBlock)
+    {
+        if (left_count == 0)
+        {
+            left_start = 0;
+            for (std::ptrdiff_t i = 0; i < kBlock; ++i)
+            {
+                left_offsets[left_count] = static_cast<unsigned char>(i);
+                left_count += !less(l[i], pivot);
+            }
+        }
+        if (right_count == 0)
+        {
+            right_start = 0;
+            for (std::ptrdiff_t i = 0; i < kBlock; ++i)
+            {
+                right_offsets[right_count] = static_cast<unsigned char>(i);
+                right_count += less(*(r - 1 - i), pivot);
+            }
+        }
+        std::ptrdiff_t swaps = std::min(left_count, right_count);
+        for (std::ptrdiff_t k = 0; k < swaps; ++k)
+        {
+            std::iter_swap(l + left_offsets[left_start + k], r - 1 - right_offsets[right_start + k]);
+        }
+        left_count -= swaps;
+        right_count -= swaps;
+        left_start += swaps;
+        right_start += swaps;
+        if (left_count == 0)
+        {
+            l += kBlock;
+        }
+        if (right_count == 0)
+        {
+            r -= kBlock;
+        }
+    }
+    // Everything left of l belongs left, everything from r on belongs right; a block with
+    // unmatched offsets is still inside [l, r).
+    return branchless_lomuto_partition(l, r, pivot, less);
+}
+
+template<typename T>
+inline void compare_exchange(T& a, T& b)
+{
+    T lo = std::min(a, b);
+    T hi = std::max(a, b);
+    a = lo;
+    b = hi;
+}
+
+// Size-optimal networks for 2..8 elements (checked exhaustively by the 0-1 principle below).
+constexpr unsigned char kNetwork2[][2] = {{0, 1}};
+constexpr unsigned char kNetwork3[][2] = {{0, 2}, {0, 1}, {1, 2}};
+constexpr unsigned char kNetwork4[][2] = {{0, 2}, {1, 3}, {0, 1}, {2, 3}, {1, 2}};
+constexpr unsigned char kNetwork5[][2] = {{0, 3}, {1, 4}, {0, 2}, {1, 3}, {0, 1}, {2, 4}, {1, 2}, {3, 4}, {2, 3}};
+constexpr unsigned char kNetwork6[][2] = {{0, 5}, {1, 3}, {2, 4}, {1, 2}, {3, 4}, {0, 3},
+                                          {2, 5}, {0, 1}, {2, 3}, {4, 5}, {1, 2}, {3, 4}};
+constexpr unsigned char kNetwork7[][2] = {{0, 6}, {2, 3}, {4, 5}, {0, 2}, {1, 4}, {3, 6}, {0, 1}, {2, 5},
+                                          {3, 4}, {1, 2}, {4, 6}, {2, 3}, {4, 5}, {1, 2}, {3, 4}, {5, 6}};
+constexpr unsigned char kNetwork8[][2] = {{0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6},
+                                          {3, 7}, {0, 1}, {2, 3}, {4, 5}, {6, 7}, {2, 4}, {3, 5},
+                                          {1, 4}, {3, 6}, {1, 2}, {3, 4}, {5, 6}};
+
+template<typename T, std::size_t K>
+inline void apply_network(T* data, const unsigned char (&network)[K][2])
+{
+    for (const auto& pair : network)
+    {
+        compare_exchange(data[pair[0]], data[pair[1]]);
+    }
+}
+
+// Fixed comparator sequence: no data-dependent branches, unlike insertion sort.
+template<typename T>
+void sorting_network_sort(T* data, std::size_t n)
+{
+    switch (n)
+    {
+    case 2: apply_network(data, kNetwork2); break;
+    case 3: apply_network(data, kNetwork3); break;
+    case 4: apply_network(data, kNetwork4); break;
+    case 5: apply_network(data, kNetwork5); break;
+    case 6: apply_network(data, kNetwork6); break;
+    case 7: apply_network(data, kNetwork7); break;
+    case 8: apply_network(data, kNetwork8); break;
+    default:
+        if (n > 8)
+        {
+            throw std::invalid_argument("sorting_network_sort supports at most 8 elements");
+        }
+        break;
+    }
+}
+
+// Introsort built from the kernels above: median-of-three block partition, networks for
+// the leaves, heapsort once the depth budget runs out.
+template<typename T>
+void kernel_sort(T* first, T* last, int depth_budget)
+{
+    auto less = [](const T& a, const T& b) { return a < b; };
+    auto less_equal = [](const T& a, const T& b) { return !(b < a); };
+    while (last - first > 8)
+    {
+        if (depth_budget-- == 0)
+        {
+            std::make_heap(first, last);
+            std::sort_heap(first, last);
+            return;
+        }
+        std::ptrdiff_t n = last - first;
+        T a = first[0];
+        T b = first[n / 2];
+        T c = last[-1];
+        T pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+        T* mid = block_hoare_partition(first, last, pivot, less);
+        if (mid == first)
+        {
+            // The pivot is the minimum: everything <= pivot equals it and is in place.
+            first = block_hoare_partition(first, last, pivot, less_equal);
+            continue;
+        }
+        if (mid - first < last - mid)
+        {
+            kernel_sort(first, mid, depth_budget);
+            first = mid;
+        }
+        else
+        {
+            kernel_sort(mid, last, depth_budget);
+            last = mid;
+        }
+    }
+    sorting_network_sort(first, static_cast<std::size_t>(last - first));
+}
+
+template<typename T>
+void kernel_sort(T* first, T* last)
+{
+    int depth = 0;
+    for (std::ptrdiff_t n = last - first; n > 1; n >>= 1)
+    {
+        depth += 2;
+    }
+    kernel_sort(first, last, depth);
+}
+
+// Nanosecond timestamps as an event log produces them: increasing with local jitter, so
+// the upper bytes barely vary.
+std::vector<std::uint64_t> make_timestamps(std::size_t n, std::uint32_t seed)
+{
+    std::vector<std::uint64_t> stamps(n);
+    std::mt19937_64 rng(seed);
+    std::uint64_t now = 1700000000ull * 1000000000ull;
+    for (auto& t : stamps)
+    {
+        now += rng() % 2000;
+        t = now - rng() % 50000;
+    }
+    return stamps;
+}
+
+TEST_F(AlgorithmsTest, RadixSortIntegersAndFloats)
+{
+    std::vector<std::uint32_t> keys = make_random_keys(100000, 5);
+    std::vector<std::uint32_t> expected = keys;
+    std::sort(expected.begin(), expected.end());
+    std::vector<std::uint32_t> keys11 = keys;
+    radix_sort(keys.data(), keys.data() + keys.size());
+    radix_sort<11>(keys11.data(), keys11.data() + keys11.size());
+    EXPECT_EQ(keys, expected);
+    EXPECT_EQ(keys11, expected);
+
+    std::vector<std::int64_t> signed_values = {5, -3, 0, std::numeric_limits<std::int64_t>::min(), 42, -1,
+                                               std::numeric_limits<std::int64_t>::max(), -3};
+    std::vector<std::int64_t> signed_expected = signed_values;
+    std::sort(signed_expected.begin(), signed_expected.end());
+    radix_sort(signed_values.data(), signed_values.data() + signed_values.size());
+    EXPECT_EQ(signed_values, signed_expected);
+
+    std::vector<float> floats = {3.5f, -0.25f, 1e30f, -1e30f, 0.5f, -7.0f, 2.0f, 1e-30f, -1e-30f};
+    std::vector<float> float_expected = floats;
+    std::sort(float_expected.begin(), float_expected.end());
+    radix_sort<11>(floats.data(), floats.data() + floats.size());
+    EXPECT_EQ(floats, float_expected);
+
+    // Q: Why does flipping all bits of a negative float, but only the sign bit of a positive one,
+    //    turn IEEE-754 ordering into unsigned integer ordering?
+    // A:
+    // R:
+}
+
+TEST_F(AlgorithmsTest, RadixSortKeyPointerPairsIsStable)
+{
+    std::vector<int> records(20000);
+    std::vector<KeyPointer> index;
+    std::mt19937 rng(9);
+    for (auto& r : records)
+    {
+        index.push_back(KeyPointer{rng() % 64, &r});
+    }
+    std::vector<KeyPointer> expected = index;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const KeyPointer& a, const KeyPointer& b) { return a.key < b.key; });
+
+    radix_sort(index.data(), index.data() + index.size(), [](const KeyPointer& kp) { return kp.key; });
+    for (std::size_t i = 0; i < index.size(); ++i)
+    {
+        ASSERT_EQ(index[i].key, expected[i].key);
+        ASSERT_EQ(index[i].record, expected[i].record);
+    }
+
+    // Q: Keys below 64 only use the lowest digit. How many of the eight 8-bit passes actually move
+    //    data, and what does the single histogram pass cost compared with a pass per digit?
+    // A:
+    // R:
+}
+
+TEST_F(AlgorithmsTest, BranchlessPartitionsSplitAroundPivot)
+{
+    std::vector<std::uint32_t> keys = make_random_keys(10000, 17);
+    std::uint32_t pivot = keys[1234];
+    auto less = [](std::uint32_t a, std::uint32_t b) { return a < b; };
+
+    std::vector<std::uint32_t> lomuto = keys;
+    std::uint32_t* mid = branchless_lomuto_partition(lomuto.data(), lomuto.data() + lomuto.size(), pivot, less);
+    std::vector<std::uint32_t> hoare = keys;
+    std::uint32_t* hoare_mid = block_hoare_partition(hoare.data(), hoare.data() + hoare.size(), pivot, less);
+
+    std::size_t expected_left = static_cast<std::size_t>(std::count_if(keys.begin(), keys.end(),
+                                                                       [pivot](std::uint32_t k) { return k < pivot; }));
+    EXPECT_EQ(static_cast<std::size_t>(mid - lomuto.data()), expected_left);
+    EXPECT_EQ(static_cast<std::size_t>(hoare_mid - hoare.data()), expected_left);
+    EXPECT_TRUE(std::all_of(lomuto.data(), mid, [pivot](std::uint32_t k) { return k < pivot; }));
+    EXPECT_TRUE(std::all_of(hoare_mid, hoare.data() + hoare.size(), [pivot](std::uint32_t k) { return k >= pivot; }));
+
+    std::sort(hoare.begin(), hoare.end());
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(hoare, keys);
+}
+
+TEST_F(AlgorithmsTest, SortingNetworksSortAllZeroOneInputs)
+{
+    // 0-1 principle: a comparator network that sorts every 0/1 sequence sorts everything.
+    for (std::size_t n = 2; n <= 8; ++n)
+    {
+        for (unsigned bits = 0; bits < (1u << n); ++bits)
+        {
+            int data[8];
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                data[i] = (bits >> i) & 1;
+            }
+            sorting_network_sort(data, n);
+            ASSERT_TRUE(std::is_sorted(data, data + n)) << "n=" << n << " bits=" << bits;
+        }
+    }
+
+    std::vector<std::uint32_t> keys = make_random_keys(50000, 23);
+    std::vector<std::uint32_t> expected = keys;
+    std::sort(expected.begin(), expected.end());
+    kernel_sort(keys.data(), keys.data() + keys.size());
+    EXPECT_EQ(keys, expected);
+
+    std::vector<int> duplicates(5000);
+    for (std::size_t i = 0; i < duplicates.size(); ++i)
+    {
+        duplicates[i] = static_cast<int>(i % 4);
+    }
+    kernel_sort(duplicates.data(), duplicates.data() + duplicates.size());
+    EXPECT_TRUE(std::is_sorted(duplicates.begin(), duplicates.end()));
+}
+
+void run_sorting_kernel_benchmarks(std::size_t n)
+{
+    const std::vector<std::uint64_t> stamps = make_timestamps(n, 77);
+    auto run = [&](const char* name, auto sort_fn)
+    {
+        std::vector<std::uint64_t> data = stamps;
+        double ms = time_ms([&]() { sort_fn(data); });
+        EXPECT_TRUE(std::is_sorted(data.begin(), data.end())) << name;
+        std::cout << "[ BENCH    ] n=" << n << " timestamps " << name << " ms=" << ms << "\n";
+    };
+    run("std::sort          ", [](std::vector<std::uint64_t>& d) { std::sort(d.begin(), d.end()); });
+    run("std::stable_sort   ", [](std::vector<std::uint64_t>& d) { std::stable_sort(d.begin(), d.end()); });
+    run("radix_sort<8>      ", [](std::vector<std::uint64_t>& d) { radix_sort<8>(d.data(), d.data() + d.size()); });
+    run("radix_sort<11>     ", [](std::vector<std::uint64_t>& d) { radix_sort<11>(d.data(), d.data() + d.size()); });
+    run("kernel_sort        ", [](std::vector<std::uint64_t>& d) { kernel_sort(d.data(), d.data() + d.size()); });
+
+    std::vector<KeyPointer> index(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        index[i] = KeyPointer{stamps[i], &stamps[i]};
+    }
+    std::vector<KeyPointer> by_std = index;
+    auto by_key = [](const KeyPointer& a, const KeyPointer& b) { return a.key < b.key; };
+    double std_ms = time_ms([&]() { std::stable_sort(by_std.begin(), by_std.end(), by_key); });
+    double radix_ms = time_ms([&]()
+    {
+        radix_sort<11>(index.data(), index.data() + index.size(), [](const KeyPointer& kp) { return kp.key; });
+    });
+    EXPECT_TRUE(std::is_sorted(index.begin(), index.end(), by_key));
+    std::cout << "[ BENCH    ] n=" << n << " key+pointer std::stable_sort ms=" << std_ms << " radix_sort<11> ms="
+              << radix_ms << "\n";
+}
+
+TEST_F(AlgorithmsTest, SortingKernelBenchmark)
+{
+    // Q: 64-bit timestamps need eight 8-bit or six 11-bit passes in principle. How many does
+    //    radix_sort run on this data, and why does 11 bits stop paying off once the histogram and
+    //    the 2048 write streams no longer fit in L1 and the TLB?
+    // A:
+    // R:
+
+    run_sorting_kernel_benchmarks(std::size_t(1) << 17);
+}
+
+// The 100M-record run needs about 5 GB (data, scratch and the key+pointer index).
+TEST_F(AlgorithmsTest, DISABLED_SortingKernelBenchmarkLarge)
+{
+    run_sorting_kernel_benchmarks(100000000);
+}
@@ -2,10 +2,700 @@
 // Estimated Time: 2 hours
 // Difficulty: Easy
 
+#include "instrumentation.h"
 #include <gtest/gtest.h>
-#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
 
-// TODO: Implement test cases for vector iterator invalidation
 // TODO: Implement test cases for list iterator invalidation
 // TODO: Implement test cases for map iterator invalidation
+
+class IteratorInvalidationTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        EventLog::instance().clear();
+    }
+};
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ============================================================================
+// stable_vector<T>: Addresses That Never Move
+// ============================================================================
+
+// AntiPatternsTest.HoldingSharedPtrInUnstableContainer keeps shared_ptrs in a std::vector;
+// anything that remembered &cache[i] dangles after the next reallocation. A colony-style
+// container never relocates: elements live in blocks of 16, 32, 64 ... slots (capped at
+// kMaxBlock), a block is never resized, and erase leaves a hole instead of shifting.
+//
+// Holes are tracked by a jump-counting skip field: a live slot stores 0, and the first and
+// last slot of every run of erased slots store the run's length. Iteration jumps a whole
+// run in one step, and erase merges with the runs on either side by reading one neighbour
+// each, so both stay O(1). Each run's start is also on a per-block free list, and new
+// elements are placed at the start of the first free run before fresh slots are used.
+template<typename T>
+class stable_vector
+{
+    using skip_type = std::uint16_t;
+    static constexpr std::size_t kFirstBlock = 16;
+    static constexpr std::size_t kMaxBlock = std::size_t{1} << 15;
+    static constexpr skip_type kNoRun = 0xFFFF;
+
+    struct block
+    {
+        explicit block(std::size_t slot_count)
+        : slots(std::allocator<T>().allocate(slot_count))
+        , skip(new skip_type[slot_count + 1]())
+        , run_prev(new skip_type[slot_count])
+        , run_next(new skip_type[slot_count])
+        , capacity(slot_count)
+        {
+        }
+
+        ~block()
+        {
+            std::allocator<T>().deallocate(slots, capacity);
+        }
+
+        T* slots;
+        std::unique_ptr<skip_type[]> skip;  // one extra slot: skip[capacity] stays 0
+        std::unique_ptr<skip_type[]> run_prev;
+        std::unique_ptr<skip_type[]> run_next;
+        std::size_t capacity;
+        std::size_t used = 0;  // slots [0, used) are live or erased; the rest are untouched
+        std::size_t live = 0;
+        skip_type free_head = kNoRun;
+        bool listed_free = false;
+        block* next = nullptr;
+    };
+
+public:
+    template<bool Const>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const T*, T*>;
+        using reference = std::conditional_t<Const, const T&, T&>;
+
+        basic_iterator() = default;
+
+        template<bool WasConst, typename = std::enable_if_t<Const && !WasConst>>
+        basic_iterator(const basic_iterator<WasConst>& other)
+        : block_(other.block_)
+        , slot_(other.slot_)
+        {
+        }
+
+        reference operator*() const { return block_->slots[slot_]; }
+        pointer operator->() const { return block_->slots + slot_; }
+
+        basic_iterator& operator++()
+        {
+            ++slot_;
+            slot_ += block_->skip[slot_];
+            settle();
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            basic_iterator before = *this;
+            ++*this;
+            return before;
+        }
+
+        friend bool operator==(const basic_iterator& a, const basic_iterator& b)
+        {
+            return a.block_ == b.block_ && a.slot_ == b.slot_;
+        }
+
+        friend bool operator!=(const basic_iterator& a, const basic_iterator& b) { return !(a == b); }
+
+    private:
+        friend class stable_vector;
+        template<bool>
+        friend class basic_iterator;
+
+        basic_iterator(block* b, std::size_t slot)
+        : block_(b)
+        , slot_(slot)
+        {
+        }
+
+        // Past the last used slot of a block: continue at the first live slot of the next
+        // non-empty block, or become end() (null block).
+        void settle()
+        {
+            while (block_ != nullptr && slot_ >= block_->used)
+            {
+                block_ = block_->next;
+                slot_ = block_ != nullptr ? block_->skip[0] : 0;
+            }
+        }
+
+        block* block_ = nullptr;
+        std::size_t slot_ = 0;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+    using value_type = T;
+    using size_type = std::size_t;
+
+    stable_vector() = default;
+    stable_vector(const stable_vector&) = delete;
+    stable_vector& operator=(const stable_vector&) = delete;
+
+    ~stable_vector()
+    {
+        clear();
+    }
+
+    template<typename... Args>
+    iterator emplace(Args&&... args)
+    {
+        if (!with_free_.empty())
+        {
+            return emplace_into_run(with_free_.back(), std::forward<Args>(args)...);
+        }
+        if (tail_ == nullptr || tail_->used == tail_->capacity)
+        {
+            add_block();
+        }
+        block* b = tail_;
+        ::new (static_cast<void*>(b->slots + b->used)) T(std::forward<Args>(args)...);
+        ++b->used;
+        ++b->live;
+        ++size_;
+        return iterator(b, b->used - 1);
+    }
+
+    iterator insert(const T& value) { return emplace(value); }
+    iterator insert(T&& value) { return emplace(std::move(value)); }
+
+    iterator erase(const_iterator pos)
+    {
+        block* b = pos.block_;
+        std::size_t i = pos.slot_;
+        b->slots[i].~T();
+        --b->live;
+        --size_;
+        std::size_t run_after = i + 1 < b->used ? b->skip[i + 1] : 0;
+        mark_erased(b, i);
+
+        iterator next(b, i + 1 + run_after);
+        next.settle();
+        return next;
+    }
+
+    // Colony's get_iterator: O(number of blocks), which is logarithmic in the capacity.
+    iterator iterator_to(const T* element) const
+    {
+        for (block* b = head_; b != nullptr; b = b->next)
+        {
+            if (std::less_equal<const T*>()(b->slots, element) && std::less<const T*>()(element, b->slots + b->used))
+            {
+                return iterator(b, static_cast<std::size_t>(element - b->slots));
+            }
+        }
+        return iterator();
+    }
+
+    void clear() noexcept
+    {
+        for (auto it = begin(); it != end(); ++it)
+        {
+            it->~T();
+        }
+        while (head_ != nullptr)
+        {
+            delete std::exchange(head_, head_->next);
+        }
+        tail_ = nullptr;
+        with_free_.clear();
+        size_ = 0;
+        capacity_ = 0;
+    }
+
+    iterator begin() noexcept
+    {
+        iterator it(head_, head_ != nullptr ? head_->skip[0] : 0);
+        it.settle();
+        return it;
+    }
+
+    iterator end() noexcept { return iterator(); }
+    const_iterator begin() const noexcept { return const_cast<stable_vector*>(this)->begin(); }
+    const_iterator end() const noexcept { return const_iterator(); }
+
+    size_type size() const noexcept { return size_; }
+    size_type capacity() const noexcept { return capacity_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+private:
+    void add_block()
+    {
+        std::size_t slot_count = tail_ == nullptr ? kFirstBlock : std::min(tail_->capacity * 2, kMaxBlock);
+        block* b = new block(slot_count);
+        (tail_ != nullptr ? tail_->next : head_) = b;
+        tail_ = b;
+        capacity_ += slot_count;
+    }
+
+    // --- free-run list, linked through run_prev/run_next at each run's first slot ---
+
+    static void push_run(block* b, std::size_t start)
+    {
+        b->run_prev[start] = kNoRun;
+        b->run_next[start] = b->free_head;
+        if (b->free_head != kNoRun)
+        {
+            b->run_prev[b->free_head] = static_cast<skip_type>(start);
+        }
+        b->free_head = static_cast<skip_type>(start);
+    }
+
+    static void unlink_run(block* b, std::size_t start)
+    {
+        skip_type prev = b->run_prev[start];
+        skip_type next = b->run_next[start];
+        (prev != kNoRun ? b->run_next[prev] : b->free_head) = next;
+        if (next != kNoRun)
+        {
+            b->run_prev[next] = prev;
+        }
+    }
+
+    // The run starting at from now starts at to; its list node moves with it.
+    static void move_run(block* b, std::size_t from, std::size_t to)
+    {
+        skip_type prev = b->run_prev[from];
+        skip_type next = b->run_next[from];
+        b->run_prev[to] = prev;
+        b->run_next[to] = next;
+        (prev != kNoRun ? b->run_next[prev] : b->free_head) = static_cast<skip_type>(to);
+        if (next != kNoRun)
+        {
+            b->run_prev[next] = static_cast<skip_type>(to);
+        }
+    }
+
+    static void set_run(block* b, std::size_t start, std::size_t length)
+    {
+        b->skip[start] = static_cast<skip_type>(length);
+        b->skip[start + length - 1] = static_cast<skip_type>(length);
+    }
+
+    void mark_erased(block* b, std::size_t i)
+    {
+        std::size_t left = i > 0 ? b->skip[i - 1] : 0;
+        std::size_t right = i + 1 < b->used ? b->skip[i + 1] : 0;
+        if (left == 0 && right == 0)
+        {
+            set_run(b, i, 1);
+            push_run(b, i);
+        }
+        else if (right == 0)
+        {
+            set_run(b, i - left, left + 1);
+        }
+        else if (left == 0)
+        {
+            set_run(b, i, right + 1);
+            move_run(b, i + 1, i);
+        }
+        else
+        {
+            unlink_run(b, i + 1);
+            set_run(b, i - left, left + 1 + right);
+        }
+
+        if (!b->listed_free)
+        {
+            b->listed_free = true;
+            with_free_.push_back(b);
+        }
+    }
+
+    template<typename... Args>
+    iterator emplace_into_run(block* b, Args&&... args)
+    {
+        std::size_t start = b->free_head;
+        ::new (static_cast<void*>(b->slots + start)) T(std::forward<Args>(args)...);
+
+        std::size_t length = b->skip[start];
+        b->skip[start] = 0;
+        if (length == 1)
+        {
+            unlink_run(b, start);
+        }
+        else
+        {
+            set_run(b, start + 1, length - 1);
+            move_run(b, start, start + 1);
+        }
+        if (b->free_head == kNoRun)
+        {
+            b->listed_free = false;
+            with_free_.pop_back();
+        }
+        ++b->live;
+        ++size_;
+        return iterator(b, start);
+    }
+
+    block* head_ = nullptr;
+    block* tail_ = nullptr;
+    std::vector<block*> with_free_;  // blocks with at least one free run; the back is reused first
+    size_type size_ = 0;
+    size_type capacity_ = 0;
+};
+
+TEST_F(IteratorInvalidationTest, VectorGrowthMovesElementsStableVectorDoesNot)
+{
+    std::vector<std::shared_ptr<Tracked>> cache;
+    stable_vector<std::shared_ptr<Tracked>> stable;
+    std::vector<const std::shared_ptr<Tracked>*> stable_addresses;
+
+    cache.push_back(std::make_shared<Tracked>("first"));
+    const std::shared_ptr<Tracked>* remembered = &cache[0];
+    stable_addresses.push_back(&*stable.insert(cache[0]));
+
+    std::size_t reallocations = 0;
+    for (int i = 1; i < 1000; ++i)
+    {
+        std::size_t before = cache.capacity();
+        cache.push_back(std::make_shared<Tracked>("item" + std::to_string(i)));
+        reallocations += cache.capacity() != before ? 1 : 0;
+        stable_addresses.push_back(&*stable.insert(cache.back()));
+    }
+
+    // remembered now dangles: comparing the pointer value is fine, dereferencing it is not.
+    EXPECT_NE(remembered, &cache[0]);
+    EXPECT_GT(reallocations, 5u);
+
+    std::size_t index = 0;
+    for (const auto& element : stable)
+    {
+        ASSERT_EQ(&element, stable_addresses[index]);
+        ASSERT_EQ(element.get(), cache[index].get());
+        ++index;
+    }
+    EXPECT_EQ(index, 1000u);
+    EXPECT_EQ(stable.capacity(), 16u + 32 + 64 + 128 + 256 + 512);
+
+    // Q: The container hands out stable addresses, so callers can keep raw pointers or
+    //    weak_ptrs to its elements instead of extra shared_ptr copies. Which operation still
+    //    invalidates such a pointer, and how would a caller find out?
+    // A:
+    // R:
+}
+
+TEST_F(IteratorInvalidationTest, StableVectorEraseSkipsHolesAndReusesThem)
+{
+    stable_vector<int> values;
+    std::vector<stable_vector<int>::iterator> handles;
+    for (int i = 0; i < 100; ++i)
+    {
+        handles.push_back(values.insert(i));
+    }
+
+    // Erase the odd ones, then 2 and 4: each of those joins the runs on both sides of it.
+    for (int i = 1; i < 100; i += 2)
+    {
+        values.erase(handles[static_cast<std::size_t>(i)]);
+    }
+    values.erase(handles[2]);
+    values.erase(handles[4]);
+
+    std::vector<int> seen(values.begin(), values.end());
+    ASSERT_EQ(seen.size(), 48u);
+    EXPECT_EQ(seen[0], 0);
+    EXPECT_EQ(seen[1], 6);
+    EXPECT_EQ(seen.back(), 98);
+    EXPECT_EQ(values.iterator_to(&*handles[50]), handles[50]);
+
+    // Erasing 2 and 4 joined the runs around them, so 1..5 is a single hole; erase hands
+    // back the next live element, past the whole run.
+    EXPECT_EQ(*values.erase(handles[0]), 6);
+
+    // New elements fill the first slot of a free run in the most recently holed block.
+    stable_vector<int> small;
+    std::vector<stable_vector<int>::iterator> small_handles;
+    for (int i = 0; i < 10; ++i)
+    {
+        small_handles.push_back(small.insert(i));
+    }
+    int* first_hole = &*small_handles[1];
+    small.erase(small_handles[1]);
+    small.erase(small_handles[3]);
+    small.erase(small_handles[2]);
+    EXPECT_EQ(&*small.insert(-1), first_hole);
+    EXPECT_EQ(&*small.insert(-2), first_hole + 1);
+    EXPECT_EQ(std::vector<int>(small.begin(), small.end()), (std::vector<int>{0, -1, -2, 4, 5, 6, 7, 8, 9}));
+    EXPECT_EQ(small.capacity(), 16u) << "holes are refilled before fresh slots are used";
+}
+
+TEST_F(IteratorInvalidationTest, StableVectorMatchesReferenceUnderRandomChurn)
+{
+    std::mt19937 rng(7);
+    stable_vector<int> values;
+    std::vector<std::pair<int*, int>> live;  // address and the value stored there
+
+    for (int step = 0; step < 20000; ++step)
+    {
+        bool insert = live.empty() || rng() % 100 < 55;
+        if (insert)
+        {
+            int value = static_cast<int>(rng() % 1000000);
+            live.emplace_back(&*values.insert(value), value);
+        }
+        else
+        {
+            std::size_t victim = rng() % live.size();
+            values.erase(values.iterator_to(live[victim].first));
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+
+    ASSERT_EQ(values.size(), live.size());
+    std::vector<int> expected;
+    for (const auto& entry : live)
+    {
+        ASSERT_EQ(*entry.first, entry.second) << "an element moved";
+        expected.push_back(entry.second);
+    }
+    std::vector<int> actual(values.begin(), values.end());
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(actual, expected);
+}
+
+TEST_F(IteratorInvalidationTest, StableVectorDestroysEveryElementOnce)
+{
+    {
+        stable_vector<Tracked> tracked;
+        std::vector<stable_vector<Tracked>::iterator> handles;
+        for (int i = 0; i < 40; ++i)
+        {
+            handles.push_back(tracked.emplace("t" + std::to_string(i)));
+        }
+        for (int i = 0; i < 40; i += 3)
+        {
+            tracked.erase(handles[static_cast<std::size_t>(i)]);
+        }
+        EXPECT_EQ(EventLog::instance().count_events("::dtor"), 14u);
+    }
+    EXPECT_EQ(EventLog::instance().count_events("::dtor"), 40u);
+}
+
+// ============================================================================
+// Benchmark: Insert, Erase, Iterate
+// ============================================================================
+
+struct Body
+{
+    std::shared_ptr<int> owner;
+    double x;
+    double y;
+};
+
+// The usual hand-rolled alternative: a vector with a liveness flag and a stack of free
+// indices. Fast, but an index is the only stable handle - addresses move on growth.
+class vector_free_list
+{
+public:
+    std::size_t insert(const Body& body)
+    {
+        if (!free_.empty())
+        {
+            std::size_t index = free_.back();
+            free_.pop_back();
+            items_[index] = body;
+            alive_[index] = 1;
+            return index;
+        }
+        items_.push_back(body);
+        alive_.push_back(1);
+        return items_.size() - 1;
+    }
+
+    void erase(std::size_t index)
+    {
+        items_[index].owner.reset();
+        alive_[index] = 0;
+        free_.push_back(index);
+    }
+
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (std::size_t i = 0; i < items_.size(); ++i)
+        {
+            if (alive_[i] != 0)
+            {
+                f(items_[i]);
+            }
+        }
+    }
+
+private:
+    std::vector<Body> items_;
+    std::vector<std::uint8_t> alive_;
+    std::vector<std::size_t> free_;
+};
+
+struct ChurnTimes
+{
+    double insert_ms = 0;
+    double erase_ms = 0;
+    double iterate_ms = 0;
+    double sum = 0;
+};
+
+// Inserts n bodies, erases every other one through the handle insert returned, iterates
+// `passes` times, then inserts n / 2 more into the holes. Per-container glue is in the lambdas.
+template<typename Insert, typename Erase, typename Iterate>
+ChurnTimes run_churn(std::size_t n, int passes, Insert insert, Erase erase, Iterate iterate)
+{
+    auto owner = std::make_shared<int>(1);
+    ChurnTimes times;
+    times.insert_ms = time_ms([&] {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            insert(Body{owner, static_cast<double>(i), 1.0}, i);
+        }
+    });
+    times.erase_ms = time_ms([&] {
+        for (std::size_t i = 0; i < n; i += 2)
+        {
+            erase(i);
+        }
+    });
+    times.insert_ms += time_ms([&] {
+        for (std::size_t i = 0; i < n / 2; ++i)
+        {
+            insert(Body{owner, 0.5, 1.0}, n + i);
+        }
+    });
+    times.iterate_ms = time_ms([&] {
+        for (int p = 0; p < passes; ++p)
+        {
+            times.sum += iterate();
+        }
+    });
+    return times;
+}
+
+void report(const char* name, const ChurnTimes& t)
+{
+    std::cout << "[ BENCH    ] " << name << " insert_ms=" << t.insert_ms << " erase_ms=" << t.erase_ms
+              << " iterate_ms=" << t.iterate_ms << "\n";
+}
+
+void run_stable_container_benchmark(std::size_t n, int passes)
+{
+    stable_vector<Body> stable;
+    std::vector<stable_vector<Body>::iterator> stable_handles(n + n / 2);
+    ChurnTimes stable_times = run_churn(
+        n, passes, [&](const Body& b, std::size_t i) { stable_handles[i] = stable.insert(b); },
+        [&](std::size_t i) { stable.erase(stable_handles[i]); },
+        [&] {
+            double sum = 0;
+            for (const Body& b : stable)
+            {
+                sum += b.x;
+            }
+            return sum;
+        });
+
+    std::list<Body> list;
+    std::vector<std::list<Body>::iterator> list_handles(n + n / 2);
+    ChurnTimes list_times = run_churn(
+        n, passes, [&](const Body& b, std::size_t i) { list_handles[i] = list.insert(list.end(), b); },
+        [&](std::size_t i) { list.erase(list_handles[i]); },
+        [&] {
+            double sum = 0;
+            for (const Body& b : list)
+            {
+                sum += b.x;
+            }
+            return sum;
+        });
+
+    // std::deque keeps addresses on push_back, but erasing in the middle shifts elements,
+    // so erase leaves a tombstone (null owner) and holes are never refilled.
+    std::deque<Body> deque;
+    ChurnTimes deque_times = run_churn(
+        n, passes, [&](const Body& b, std::size_t) { deque.push_back(b); },
+        [&](std::size_t i) { deque[i].owner.reset(); },
+        [&] {
+            double sum = 0;
+            for (const Body& b : deque)
+            {
+                sum += b.owner ? b.x : 0.0;
+            }
+            return sum;
+        });
+
+    vector_free_list free_list;
+    std::vector<std::size_t> index_handles(n + n / 2);
+    ChurnTimes free_list_times = run_churn(
+        n, passes, [&](const Body& b, std::size_t i) { index_handles[i] = free_list.insert(b); },
+        [&](std::size_t i) { free_list.erase(index_handles[i]); },
+        [&] {
+            double sum = 0;
+            free_list.for_each([&sum](const Body& b) { sum += b.x; });
+            return sum;
+        });
+
+    EXPECT_EQ(stable.size(), n);
+    EXPECT_DOUBLE_EQ(stable_times.sum, list_times.sum);
+    EXPECT_DOUBLE_EQ(stable_times.sum, deque_times.sum);
+    EXPECT_DOUBLE_EQ(stable_times.sum, free_list_times.sum);
+
+    std::cout << "[ BENCH    ] n=" << n << " iterate passes=" << passes << "\n";
+    report("stable_vector         ", stable_times);
+    report("std::list             ", list_times);
+    report("std::deque+tombstones ", deque_times);
+    report("vector+free list      ", free_list_times);
+}
+
+TEST_F(IteratorInvalidationTest, StableContainerBenchmark)
+{
+    run_stable_container_benchmark(100000, 10);
+
+    // Q: The deque row iterates over n * 1.5 slots including tombstones, the free list over
+    //    n slots with a flag byte each. What does stable_vector's skip field save compared
+    //    to both, and what happens to its iteration speed once most slots are erased?
+    // A:
+    // R:
+}
+
+TEST_F(IteratorInvalidationTest, DISABLED_StableContainerBenchmarkLarge)
+{
+    run_stable_container_benchmark(2000000, 20);
+}